@@ -0,0 +1,80 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+/* Atomic operations on words, with LDREX/STREX
+ *
+ * Each loads the word exclusively and tries to store the new value, which
+ * fails (and is retried) only if something else - an interrupt handler, a
+ * thread switch, another core - came in between. So they never wait on
+ * anything, and are safe in interrupt handlers
+ *
+ * The word must be in cached memory (mem_alloc_cached()): the quad-core
+ * SoCs have no exclusive monitor for strongly ordered memory, where the
+ * store would never succeed. None of these is a barrier; use dmb() either
+ * side if the order matters against other memory accesses
+ *
+ * For anything longer than one word on core 0, disable IRQs instead
+ * (irq_save()/irq_restore(), in interrupts.h)
+ */
+
+/* Add n to *addr, returning the new value */
+static inline unsigned int atomic_add(volatile unsigned int *addr,
+	unsigned int n)
+{
+	unsigned int value, failed;
+
+	asm volatile("1: ldrex %[value], [%[addr]]\n"
+		"add %[value], %[value], %[n]\n"
+		"strex %[failed], %[value], [%[addr]]\n"
+		"teq %[failed], #0\n"
+		"bne 1b"
+		: [value] "=&r" (value), [failed] "=&r" (failed)
+		: [addr] "r" (addr), [n] "r" (n)
+		: "cc", "memory");
+
+	return value;
+}
+
+/* If *addr is old, set it to new. Returns what *addr was, so it succeeded
+ * if that's old
+ */
+static inline unsigned int atomic_cas(volatile unsigned int *addr,
+	unsigned int old, unsigned int new)
+{
+	unsigned int value, failed;
+
+	asm volatile("1: ldrex %[value], [%[addr]]\n"
+		"teq %[value], %[old]\n"
+		"bne 2f\n"
+		"strex %[failed], %[new], [%[addr]]\n"
+		"teq %[failed], #0\n"
+		"bne 1b\n"
+		"b 3f\n"
+		/* Nothing stored, so drop the exclusive access */
+		"2: clrex\n"
+		"3:"
+		: [value] "=&r" (value), [failed] "=&r" (failed)
+		: [addr] "r" (addr), [old] "r" (old), [new] "r" (new)
+		: "cc", "memory");
+
+	return value;
+}
+
+/* Set *addr to value, returning what it was */
+static inline unsigned int atomic_exchange(volatile unsigned int *addr,
+	unsigned int value)
+{
+	unsigned int old, failed;
+
+	asm volatile("1: ldrex %[old], [%[addr]]\n"
+		"strex %[failed], %[value], [%[addr]]\n"
+		"teq %[failed], #0\n"
+		"bne 1b"
+		: [old] "=&r" (old), [failed] "=&r" (failed)
+		: [addr] "r" (addr), [value] "r" (value)
+		: "cc", "memory");
+
+	return old;
+}
+
+#endif	/* ATOMIC_H */
@@ -1,13 +1,19 @@
 #ifndef BARRIER_H
 #define BARRIER_H
 
+#include "soc.h"
+
 /*
  * Data memory barrier
  * No memory access after the DMB can run until all memory accesses before it
  * have completed
  */
+#ifdef HOST
+#define dmb() asm volatile("" : : : "memory")
+#else
 #define dmb() asm volatile \
 		("mcr p15, #0, %[zero], c7, c10, #5" : : [zero] "r" (0) )
+#endif
 
 
 /*
@@ -15,16 +21,69 @@
  * No instruction after the DSB can run until all instructions before it have
  * completed
  */
+#ifdef HOST
+#define dsb() asm volatile("" : : : "memory")
+#else
 #define dsb() asm volatile \
 		("mcr p15, #0, %[zero], c7, c10, #4" : : [zero] "r" (0) )
+#endif
+
 
+/*
+ * ARMv7 has no single operation for the entire data cache; it has to be
+ * done a line at a time, by set and way, at each level (memory.c)
+ */
+#define CACHE_CLEAN		0
+#define CACHE_CLEAN_INVALIDATE	1
+extern void cache_v7_all(unsigned int op);
+
+/*
+ * ARMv7 can clean a line at a time by address instead (memory.c), which for
+ * a small area is far quicker than cleaning all of L1 and L2 by set and way
+ */
+extern void cache_v7_clean_range(unsigned int address, unsigned int length);
 
 /*
  * Clean and invalidate entire cache
  * Flush pending writes to main memory
  * Remove all data in data cache
  */
-#define flushcache() asm volatile \
-		("mcr p15, #0, %[zero], c7, c14, #0" : : [zero] "r" (0) )
+static inline void flushcache(void)
+{
+#ifndef HOST
+	if(cpu_is_arm11())
+		asm volatile("mcr p15, #0, %[zero], c7, c14, #0"
+			: : [zero] "r" (0));
+	else
+		cache_v7_all(CACHE_CLEAN_INVALIDATE);
+#endif
+}
+
+/*
+ * Clean entire cache
+ * Flush pending writes to main memory, leaving the data in the cache. Needed
+ * before anything other than the CPU (eg. DMA) reads cached memory
+ */
+static inline void cleancache(void)
+{
+#ifndef HOST
+	if(cpu_is_arm11())
+		asm volatile("mcr p15, #0, %[zero], c7, c10, #0"
+			: : [zero] "r" (0));
+	else
+		cache_v7_all(CACHE_CLEAN);
+#endif
+}
+
+/*
+ * Clean length bytes from (virtual) address, ARMv7 only. The ARM1176 has
+ * no need: cleancache() is a single operation there
+ */
+static inline void cleancache_lines(unsigned int address, unsigned int length)
+{
+#ifndef HOST
+	cache_v7_clean_range(address, length);
+#endif
+}
 
 #endif	/* BARRIER_H */
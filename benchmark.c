@@ -0,0 +1,1426 @@
+/* Built-in benchmarks
+ *
+ * "make BENCHMARK=1" builds a kernel which runs these at the end of boot.
+ * Each one times the code under test with the CPU cycle counter, and prints
+ * the result on the console
+ */
+
+#include "benchmark.h"
+
+#include "atomic.h"
+#include "barrier.h"
+#include "dma.h"
+#include "fastdiv.h"
+#include "font.h"
+#include "framebuffer.h"
+#include "gfx.h"
+#include "kprintf.h"
+#include "memory.h"
+#include "interrupts.h"
+#include "memutils.h"
+#include "rgb565.h"
+#include "ring.h"
+#include "smp.h"
+#include "stats.h"
+#include "syscall.h"
+#include "task.h"
+#include "textutils.h"
+#include "thread.h"
+#include "timer.h"
+#include "uart.h"
+
+/* Number of iterations for each timed loop */
+#define BENCH_LOOPS	4096
+/* Number of frames for the present benchmark */
+#define BENCH_FRAMES	32
+
+/* Simple pseudo-random number generator, so each benchmark sees the same
+ * inputs every run (Numerical Recipes LCG)
+ */
+static unsigned int bench_seed;
+
+static unsigned int bench_random(void)
+{
+	bench_seed = bench_seed * 1664525 + 1013904223;
+	return bench_seed;
+}
+
+/* Send a result to the serial port only, as "BENCH value units name", for
+ * "make qemu-bench" (tools/qemu-bench.pl)
+ */
+static void bench_serial(char *name, unsigned int value, char *units)
+{
+	char line[80];
+
+	ksnprintf(line, sizeof(line), "BENCH %u %s %s\n", value, units, name);
+	uart_write(line);
+}
+
+/* Print one result line: name, cycles per iteration */
+static void bench_result(char *name, unsigned int cycles, unsigned int loops)
+{
+	kprintf("  %s: %u cycles\n", name, cycles / loops);
+	bench_serial(name, cycles / loops, "cycles");
+}
+
+/* Divisor for the libgcc benchmarks. volatile, so that the compiler can't
+ * see it's a constant and turn the division into a multiplication
+ */
+static volatile unsigned int bench_ten = 10;
+
+/* todec() as it was originally written: two libgcc calls per digit */
+static char *todec_libgcc(unsigned int value)
+{
+	static char buffer[11];
+	unsigned int offset = 10;
+	unsigned int ten = bench_ten;
+
+	buffer[offset] = 0;
+
+	while(value || (offset == 10))
+	{
+		offset--;
+		buffer[offset] = '0' + (value % ten);
+		value = value / ten;
+	}
+
+	return &buffer[offset];
+}
+
+/* Decimal conversion: reciprocal multiplication and digit pairs (todec)
+ * against a libgcc division per digit. Also checks that both give the
+ * same answer
+ */
+static void bench_todec(void)
+{
+	unsigned int count, start, fast, slow;
+	unsigned int sum = 0;
+	char *a, *b;
+
+	console_write(COLOUR_PUSH FG_CYAN "Decimal conversion" COLOUR_POP "\n");
+
+	/* Check results, with a range of lengths of number */
+	bench_seed = 1;
+	for(count=0; count<BENCH_LOOPS; count++)
+	{
+		unsigned int value = bench_random() >> (count & 31);
+
+		a = todec(value, 0);
+		b = todec_libgcc(value);
+
+		while(*a && *a == *b)
+		{
+			a++;
+			b++;
+		}
+
+		if(*a != *b)
+		{
+			kprintf(FG_RED "  todec() mismatch for %u\n" FG_WHITE,
+				value);
+			return;
+		}
+	}
+
+	bench_seed = 1;
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+		sum += *todec(bench_random() >> (count & 31), 0);
+	fast = cycles_read() - start;
+
+	bench_seed = 1;
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+		sum += *todec_libgcc(bench_random() >> (count & 31));
+	slow = cycles_read() - start;
+
+	bench_result("todec()", fast, BENCH_LOOPS);
+	bench_result("libgcc division", slow, BENCH_LOOPS);
+
+	/* Single division: fastdiv.h against libgcc */
+	bench_seed = 1;
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+		sum += udiv10(bench_random());
+	fast = cycles_read() - start;
+
+	bench_seed = 1;
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+		sum += bench_random() / bench_ten;
+	slow = cycles_read() - start;
+
+	bench_result("udiv10()", fast, BENCH_LOOPS);
+	bench_result("__aeabi_uidiv", slow, BENCH_LOOPS);
+
+	/* Stop the compiler discarding the loops */
+	if(sum == 0)
+		console_write(" ");
+}
+
+/* UART transmit throughput: queue a block of text and time how long it
+ * takes to drain. At 115200 baud 8N1 the line limit is 11520 bytes/s
+ */
+static void bench_uart(void)
+{
+	char line[65];
+	unsigned int count, start, elapsed, queued, queue_time;
+	const struct uart_stats *stats = uart_get_stats();
+
+	kprintf(COLOUR_PUSH FG_CYAN "UART transmit" COLOUR_POP "\n");
+
+	for(count=0; count<63; count++)
+		line[count] = 'A' + (count % 26);
+	line[63] = '\n';
+	line[64] = 0;
+
+	/* Let earlier output finish first */
+	while(!uart_tx_idle());
+
+	queued = stats->tx_bytes;
+	start = timer_read();
+
+	/* 32 lines of 64 characters (plus CRs) - half the transmit ring. Only
+	 * the UART sees this, not the screen
+	 */
+	for(count=0; count<32; count++)
+		uart_write(line);
+
+	queued = stats->tx_bytes - queued;
+	queue_time = timer_read() - start;
+
+	while(!uart_tx_idle());
+	elapsed = timer_read() - start;
+
+	/* queued is at most 2112 bytes, so this doesn't overflow */
+	kprintf("  %u bytes queued in %uus, sent in %uus (%u bytes/s)\n",
+		queued, queue_time, elapsed,
+		elapsed ? queued * 1000000 / elapsed : 0);
+	uart_print_stats();
+}
+
+/* Buffers for the memory copy benchmarks */
+#define BENCH_COPY_SIZE	65536
+
+static unsigned int bench_src[BENCH_COPY_SIZE / 4] __attribute__((aligned (32)));
+static unsigned int bench_dest[BENCH_COPY_SIZE / 4] __attribute__((aligned (32)));
+
+/* Print one transfer result: time taken and bytes per second */
+static void bench_transfer(char *name, unsigned int bytes, unsigned int time)
+{
+	kprintf("  %s: %uus (%uMB/s)\n", name, time,
+		time ? bytes / time : 0);
+	bench_serial(name, time ? bytes / time : 0, "MB/s");
+}
+
+/* Copies and fills by the CPU (memmove/memclr) and by the DMA engine,
+ * first between two buffers in RAM, then a console-scroll sized copy within
+ * the framebuffer. The DMA times include waiting for the transfer to
+ * finish, so are the worst case; the CPU is free to do other things while
+ * the DMA engine works
+ */
+static void bench_dma(void)
+{
+	struct fb_info fb;
+	unsigned int start, length;
+	int ch;
+
+	kprintf(COLOUR_PUSH FG_CYAN "CPU and DMA copies" COLOUR_POP "\n");
+
+	ch = dma_channel_alloc(DMA_CHANNEL_FULL);
+	if(ch < 0)
+	{
+		kprintf("  No DMA channel free\n");
+		return;
+	}
+
+	start = timer_read();
+	memmove(bench_dest, bench_src, BENCH_COPY_SIZE);
+	bench_transfer("CPU copy 64K", BENCH_COPY_SIZE, timer_read() - start);
+
+	start = timer_read();
+	dma_memcpy(ch, bench_dest, bench_src, BENCH_COPY_SIZE);
+	dma_wait(ch);
+	bench_transfer("DMA copy 64K", BENCH_COPY_SIZE, timer_read() - start);
+
+	start = timer_read();
+	memclr(bench_dest, BENCH_COPY_SIZE);
+	bench_transfer("CPU clear 64K", BENCH_COPY_SIZE, timer_read() - start);
+
+	start = timer_read();
+	dma_fill(ch, bench_dest, 0, BENCH_COPY_SIZE);
+	dma_wait(ch);
+	bench_transfer("DMA clear 64K", BENCH_COPY_SIZE, timer_read() - start);
+
+	/* Move the bottom 7/8 of the screen up, and back again. Moving it
+	 * back down with the DMA engine, which works forwards, would smear
+	 * it, so it's only moved up
+	 */
+	fb_get_info(&fb);
+	length = fb.size - (fb.size >> 3);
+	length &= ~3;
+
+	fb_wait();
+
+	start = timer_read();
+	memmove((void *)fb.screen, (void *)(fb.screen + fb.size - length),
+		length);
+	bench_transfer("CPU screen scroll", length, timer_read() - start);
+
+	start = timer_read();
+	dma_memcpy(ch, (void *)fb.screen, (void *)(fb.screen + fb.size - length),
+		length);
+	dma_wait(ch);
+	bench_transfer("DMA screen scroll", length, timer_read() - start);
+
+	dma_channel_free(ch);
+
+	/* Put the screen back as it was */
+	fb_dirty(0, 0, fb.width, fb.height);
+	fb_flush();
+}
+
+/* Reading the framebuffer (strongly ordered/uncached) against reading the
+ * cached back buffer, as a console scroll does, and the cost of pushing the
+ * whole back buffer to the screen. Each area is copied onto itself, so
+ * nothing changes
+ */
+static void bench_backbuffer(void)
+{
+	struct fb_info fb;
+	unsigned int start;
+
+	kprintf(COLOUR_PUSH FG_CYAN "Back buffer" COLOUR_POP "\n");
+
+	fb_get_info(&fb);
+	fb_wait();
+
+	start = timer_read();
+	memmove((void *)fb.screen, (void *)fb.screen, fb.size);
+	bench_transfer("Framebuffer copy", fb.size, timer_read() - start);
+
+	start = timer_read();
+	memmove((void *)fb.base, (void *)fb.base, fb.size);
+	bench_transfer("Back buffer copy", fb.size, timer_read() - start);
+
+	start = timer_read();
+	fb_dirty(0, 0, fb.width, fb.height);
+	fb_flush();
+	fb_wait();
+	bench_transfer("Full screen flush", fb.size, timer_read() - start);
+}
+
+/* Memory bandwidth and latency, over working sets from 1K to 64M (in steps
+ * of 4) of each kind of memory the kernel uses: cached RAM, the same RAM
+ * through the strongly ordered window at 0x80000000, and the framebuffer
+ * (normal, uncached). Read and write are 32 bytes an iteration, copy is
+ * memmove() from one half of the working set to the other, and the latency
+ * is a chase of pointers one per BENCH_CHASE_STRIDE bytes in a random
+ * cycle, so that the next load can't start until the last has finished
+ *
+ * As well as the table, each row is sent to the serial port as
+ * "MEM memory size read write copy chase" (bandwidths in MB/s, chase in
+ * cycles a load), ending with "MEM END"
+ */
+#define BENCH_MEM_MIN		1024
+#define BENCH_MEM_MAX		(64 << 20)
+/* Each bandwidth is timed over at least this many bytes */
+#define BENCH_MEM_BYTES		(4 << 20)
+#define BENCH_CHASE_STRIDE	CACHE_LINE_SIZE
+#define BENCH_CHASE_STEPS	65536
+
+/* Somewhere for the sums to go, so the reads aren't optimised away */
+static volatile unsigned int bench_sink;
+
+static unsigned int bench_mem_read(const unsigned int *p, unsigned int size)
+{
+	const unsigned int *end = p + size / 4;
+	unsigned int sum = 0;
+
+	while(p < end)
+	{
+		sum += p[0] + p[1] + p[2] + p[3] + p[4] + p[5] + p[6] + p[7];
+		p += 8;
+	}
+
+	return sum;
+}
+
+static void bench_mem_write(unsigned int *p, unsigned int size,
+	unsigned int value)
+{
+	unsigned int *end = p + size / 4;
+
+	while(p < end)
+	{
+		p[0] = value;
+		p[1] = value;
+		p[2] = value;
+		p[3] = value;
+		p[4] = value;
+		p[5] = value;
+		p[6] = value;
+		p[7] = value;
+		p += 8;
+	}
+}
+
+/* Link the first word of every BENCH_CHASE_STRIDE bytes into one cycle in
+ * a random order (Sattolo's algorithm, which only makes single cycles)
+ */
+static void bench_chase_build(unsigned int *p, unsigned int size)
+{
+	unsigned int step = BENCH_CHASE_STRIDE / 4;
+	unsigned int nodes = size / BENCH_CHASE_STRIDE;
+	unsigned int node, other, swap;
+
+	for(node=0; node<nodes; node++)
+		p[node * step] = node;
+
+	for(node=nodes-1; node>0; node--)
+	{
+		/* 0 to node - 1, without a division */
+		other = ((unsigned long long)bench_random() * node) >> 32;
+		swap = p[node * step];
+		p[node * step] = p[other * step];
+		p[other * step] = swap;
+	}
+
+	for(node=0; node<nodes; node++)
+		p[node * step] = (unsigned int)&p[p[node * step] * step];
+}
+
+static unsigned int *bench_chase(unsigned int *p, unsigned int steps)
+{
+	while(steps--)
+		p = (unsigned int *)*p;
+
+	return p;
+}
+
+/* Bytes a microsecond is MB/s */
+static unsigned int bench_rate(unsigned int bytes, unsigned int time)
+{
+	return time ? bytes / time : 0;
+}
+
+/* Size as "1K", "64M" */
+static char *bench_size(char *buffer, unsigned int size)
+{
+	if(size >= 1<<20)
+		ksnprintf(buffer, 8, "%uM", size >> 20);
+	else
+		ksnprintf(buffer, 8, "%uK", size >> 10);
+
+	return buffer;
+}
+
+static void bench_memory_row(char *name, unsigned int *p, unsigned int size)
+{
+	unsigned int passes = size < BENCH_MEM_BYTES ?
+		BENCH_MEM_BYTES / size : 1;
+	unsigned int pass, start, read, write, copy, chase;
+	char buffer[8], line[80];
+
+	/* A flush to the screen may still be going on */
+	fb_wait();
+
+	bench_chase_build(p, size);
+	bench_chase(p, BENCH_CHASE_STEPS);
+	start = cycles_read();
+	bench_sink = (unsigned int)bench_chase(p, BENCH_CHASE_STEPS);
+	chase = (cycles_read() - start) / BENCH_CHASE_STEPS;
+
+	bench_sink = bench_mem_read(p, size);
+	start = timer_read();
+	for(pass=0; pass<passes; pass++)
+		bench_sink = bench_mem_read(p, size);
+	read = bench_rate(size * passes, timer_read() - start);
+
+	start = timer_read();
+	for(pass=0; pass<passes; pass++)
+		bench_mem_write(p, size, pass);
+	write = bench_rate(size * passes, timer_read() - start);
+
+	start = timer_read();
+	for(pass=0; pass<passes; pass++)
+		memmove(p + size / 8, p, size / 2);
+	copy = bench_rate(size / 2 * passes, timer_read() - start);
+
+	kprintf("  %-17s %5s %6u %6u %6u %6u\n", name, bench_size(buffer, size),
+		read, write, copy, chase);
+
+	ksnprintf(line, sizeof(line), "MEM %s %u %u %u %u %u\n", name, size,
+		read, write, copy, chase);
+	uart_write(line);
+}
+
+static void bench_memory(void)
+{
+	struct fb_info fb;
+	unsigned int *cached, physical, size, total;
+
+	kprintf(COLOUR_PUSH FG_CYAN "Memory bandwidth (MB/s) and latency "
+		"(cycles)" COLOUR_POP "\n");
+
+	/* As much as there is, up to BENCH_MEM_MAX. Never freed */
+	for(total=BENCH_MEM_MAX; total>=1<<20; total>>=1)
+		if((cached = mem_alloc(total, MEM_CACHED)))
+			break;
+	if(!cached)
+	{
+		kprintf("  Not enough memory\n");
+		return;
+	}
+
+	kprintf("  %-17s %5s %6s %6s %6s %6s\n", "Memory", "Size", "Read",
+		"Write", "Copy", "Chase");
+
+	for(size=BENCH_MEM_MIN; size<=total; size<<=2)
+		bench_memory_row("cached", cached, size);
+
+	/* The same RAM, strongly ordered, if it's inside the window (which
+	 * ends at 0xa0ffffff). Nothing of it may be left in the cache to be
+	 * written back over it later
+	 */
+	physical = mem_v2p((unsigned int)cached);
+	if(physical + total <= 0x21000000)
+	{
+		flushcache();
+		for(size=BENCH_MEM_MIN; size<=total; size<<=2)
+			bench_memory_row("strongly-ordered",
+				(unsigned int *)mem_p2v(physical), size);
+	}
+
+	fb_get_info(&fb);
+	for(size=BENCH_MEM_MIN; size<=fb.size; size<<=2)
+		bench_memory_row("framebuffer", (unsigned int *)fb.screen, size);
+
+	uart_write("MEM END\n");
+
+	/* Put the screen back as it was */
+	fb_dirty(0, 0, fb.width, fb.height);
+	fb_flush();
+}
+
+/* Double buffered presents: each frame is a line of console output, which
+ * scrolls the whole screen, so every frame is a full-screen update
+ */
+static void bench_present(void)
+{
+	unsigned int frame;
+
+	kprintf(COLOUR_PUSH FG_CYAN "Double buffered presents" COLOUR_POP "\n");
+
+	if(!fb_set_double_buffered(1))
+	{
+		kprintf("  Double buffering not available\n");
+		return;
+	}
+
+	fb_reset_present_stats();
+
+	for(frame=0; frame<BENCH_FRAMES; frame++)
+	{
+		kprintf("  Frame %u\n", frame);
+		fb_flush();
+	}
+
+	fb_set_double_buffered(0);
+
+	kprintf("  ");
+	fb_print_present_stats();
+}
+
+/* Size of the off-screen area the pixel kernels draw into */
+#define BENCH_WIDTH	640
+#define BENCH_HEIGHT	480
+
+/* Off-screen drawing area, big enough for 32bpp. Allocated on first use */
+static unsigned int bench_surface;
+
+static unsigned int bench_get_surface(void)
+{
+	if(bench_surface == 0)
+		bench_surface = (unsigned int)mem_alloc(BENCH_WIDTH *
+			BENCH_HEIGHT * 4, MEM_CACHED);
+
+	if(bench_surface == 0)
+		kprintf("  Not enough memory\n");
+
+	return bench_surface;
+}
+
+/* Print a pixel rate in millions of pixels per second, to 1 decimal place
+ * (pixels per microsecond)
+ */
+static void bench_pixels(char *name, unsigned int pixels, unsigned int time)
+{
+	unsigned int rate = time ? pixels * 10 / time : 0;
+
+	kprintf("    %s: %u.%uMpixels/s\n", name, rate / 10, rate % 10);
+	bench_serial(name, rate * 100, "Kpixels/s");
+}
+
+/* Each depth's fill, glyph and blit kernels over a cached off-screen area
+ * the size of a 640x480 screen. Higher depths look better but move more
+ * memory - the frame size is shown for comparison
+ */
+static void bench_depths(void)
+{
+	static const unsigned int depths[] = { 8, 16, 24, 32 };
+	static const unsigned int glyph[10] = {
+		0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11, 0, 0, 0
+	};
+	const struct fb_ops *ops;
+	unsigned int count, x, y, pitch, start, colour;
+
+	kprintf(COLOUR_PUSH FG_CYAN "Pixel kernels by depth (%ux%u)"
+		COLOUR_POP "\n", BENCH_WIDTH, BENCH_HEIGHT);
+
+	if(bench_get_surface() == 0)
+		return;
+
+	for(count=0; count<4; count++)
+	{
+		ops = fb_ops_for_depth(depths[count]);
+		pitch = BENCH_WIDTH * ops->bytes;
+		colour = ops->colour(0x4080c0);
+
+		kprintf("  %ubpp, %uK per frame\n", ops->bpp,
+			pitch * BENCH_HEIGHT >> 10);
+
+		start = timer_read();
+		ops->fill(bench_surface, pitch, BENCH_WIDTH, BENCH_HEIGHT,
+			colour);
+		bench_pixels("Fill", BENCH_WIDTH * BENCH_HEIGHT,
+			timer_read() - start);
+
+		/* A screen full of 6x10 characters */
+		start = timer_read();
+		for(y=0; y<BENCH_HEIGHT; y+=10)
+			for(x=0; x<BENCH_WIDTH-5; x+=6)
+				ops->glyph(bench_surface + y * pitch +
+					x * ops->bytes, pitch, glyph, 6, 10,
+					colour, 0);
+		bench_pixels("Glyphs", (BENCH_WIDTH / 6) * 6 * BENCH_HEIGHT,
+			timer_read() - start);
+
+		/* Top half of the area to the bottom half */
+		start = timer_read();
+		ops->blit(bench_surface + (BENCH_HEIGHT / 2) * pitch, pitch,
+			bench_surface, pitch, BENCH_WIDTH, BENCH_HEIGHT / 2);
+		bench_pixels("Blit", BENCH_WIDTH * BENCH_HEIGHT / 2,
+			timer_read() - start);
+	}
+}
+
+/* A screen full of text in each font, drawn off-screen with the screen's
+ * glyph kernel as console_write() does
+ */
+static void bench_fonts(void)
+{
+	static const struct font *fonts[] = {
+		&font_teletext, &font_teletext2x, &font_8x16
+	};
+	const struct font *font;
+	struct fb_info fb;
+	unsigned int count, x, y, pitch, start, time, chars, fg, bg;
+
+	kprintf(COLOUR_PUSH FG_CYAN "Fonts (%ux%u)" COLOUR_POP "\n",
+		BENCH_WIDTH, BENCH_HEIGHT);
+
+	if(bench_get_surface() == 0)
+		return;
+
+	fb_get_info(&fb);
+	pitch = BENCH_WIDTH * fb.ops->bytes;
+	fg = fb_colour(0xffffff);
+	bg = fb_colour(0x000080);
+
+	for(count=0; count<3; count++)
+	{
+		font = fonts[count];
+		chars = 0;
+
+		start = timer_read();
+		for(y=0; y+font->height<=BENCH_HEIGHT; y+=font->height)
+		{
+			for(x=0; x+font->width<=BENCH_WIDTH; x+=font->width)
+			{
+				fb.ops->glyph(bench_surface + y * pitch +
+					x * fb.ops->bytes, pitch,
+					font_glyph(font, 32 + (chars % 95)),
+					font->width, font->height, fg, bg);
+				chars++;
+			}
+		}
+		time = timer_read() - start;
+
+		kprintf("  %s (%ux%u): %u characters in %uus\n", font->name,
+			font->width, font->height, chars, time);
+		bench_pixels("Glyphs", chars * font->width * font->height,
+			time);
+	}
+}
+
+/* gfx.c primitives, drawing off-screen in the screen's format. Each test
+ * draws BENCH_SHAPES shapes and reports the pixel rate
+ */
+#define BENCH_SHAPES	256
+
+static void bench_gfx(void)
+{
+	struct fb_info fb;
+	unsigned int count, start, pixels, colour, key, pitch;
+	unsigned int sprite;
+	int x, y;
+
+	kprintf(COLOUR_PUSH FG_CYAN "2D primitives" COLOUR_POP "\n");
+
+	if(bench_get_surface() == 0)
+		return;
+
+	fb_get_info(&fb);
+	pitch = BENCH_WIDTH * fb.ops->bytes;
+	gfx_target(bench_surface, pitch, BENCH_WIDTH, BENCH_HEIGHT);
+
+	colour = fb_colour(0xc08040);
+	key = fb_colour(0xff00ff);
+
+	bench_seed = 1;
+	pixels = 0;
+	start = timer_read();
+	for(count=0; count<BENCH_SHAPES; count++)
+	{
+		x = bench_random() % (BENCH_WIDTH - 64);
+		y = bench_random() % (BENCH_HEIGHT - 64);
+		gfx_fill_rect(x, y, 64, 64, colour);
+		pixels += 64 * 64;
+	}
+	bench_pixels("Fill 64x64", pixels, timer_read() - start);
+
+	bench_seed = 1;
+	pixels = 0;
+	start = timer_read();
+	for(count=0; count<BENCH_SHAPES; count++)
+	{
+		y = bench_random() % BENCH_HEIGHT;
+		gfx_hline(0, y, BENCH_WIDTH, colour);
+		pixels += BENCH_WIDTH;
+	}
+	bench_pixels("Horizontal lines", pixels, timer_read() - start);
+
+	bench_seed = 1;
+	pixels = 0;
+	start = timer_read();
+	for(count=0; count<BENCH_SHAPES; count++)
+	{
+		x = bench_random() % BENCH_WIDTH;
+		gfx_vline(x, 0, BENCH_HEIGHT, colour);
+		pixels += BENCH_HEIGHT;
+	}
+	bench_pixels("Vertical lines", pixels, timer_read() - start);
+
+	/* Lines from corner to corner, each with its length in pixels */
+	bench_seed = 1;
+	pixels = 0;
+	start = timer_read();
+	for(count=0; count<BENCH_SHAPES; count++)
+	{
+		x = bench_random() % BENCH_WIDTH;
+		gfx_line(x, 0, BENCH_WIDTH - 1 - x, BENCH_HEIGHT - 1, colour);
+		pixels += BENCH_HEIGHT;
+	}
+	bench_pixels("Diagonal lines", pixels, timer_read() - start);
+
+	/* The sprite is the top left 64x64 of the area, with a key colour
+	 * border
+	 */
+	sprite = bench_surface;
+	gfx_fill_rect(0, 0, 64, 64, key);
+	gfx_fill_rect(8, 8, 48, 48, colour);
+
+	bench_seed = 1;
+	pixels = 0;
+	start = timer_read();
+	for(count=0; count<BENCH_SHAPES; count++)
+	{
+		x = 64 + bench_random() % (BENCH_WIDTH - 128);
+		y = 64 + bench_random() % (BENCH_HEIGHT - 128);
+		gfx_blit(x, y, (void *)sprite, pitch, 64, 64);
+		pixels += 64 * 64;
+	}
+	bench_pixels("Blit 64x64", pixels, timer_read() - start);
+
+	bench_seed = 1;
+	pixels = 0;
+	start = timer_read();
+	for(count=0; count<BENCH_SHAPES; count++)
+	{
+		x = 64 + bench_random() % (BENCH_WIDTH - 128);
+		y = 64 + bench_random() % (BENCH_HEIGHT - 128);
+		gfx_blit_key(x, y, (void *)sprite, pitch, 64, 64, key);
+		pixels += 64 * 64;
+	}
+	bench_pixels("Colour key blit 64x64", pixels, timer_read() - start);
+
+	gfx_init();
+}
+
+/* RGB565 colour operations, the SIMD versions against the plain C ones. The
+ * results are compared as well, and any differences reported
+ */
+#define BENCH_RGB_PIXELS	16384
+
+static void bench_rgb565_run(unsigned int op, unsigned int ref,
+	unsigned short int *dest, const unsigned short int *src,
+	unsigned int *wide)
+{
+	switch(op)
+	{
+		case 0:
+			(ref ? rgb565_dim_ref : rgb565_dim)(dest, src,
+				BENCH_RGB_PIXELS);
+			break;
+		case 1:
+			(ref ? rgb565_blend_ref : rgb565_blend)(dest, src,
+				BENCH_RGB_PIXELS, 12);
+			break;
+		case 2:
+			(ref ? rgb565_blend_ref : rgb565_blend)(dest, src,
+				BENCH_RGB_PIXELS, 16);
+			break;
+		case 3:
+			(ref ? rgb565_add_ref : rgb565_add)(dest, src,
+				BENCH_RGB_PIXELS);
+			break;
+		case 4:
+			(ref ? rgb565_to_rgb888_ref : rgb565_to_rgb888)(wide,
+				src, BENCH_RGB_PIXELS);
+			break;
+		case 5:
+			(ref ? rgb888_to_rgb565_ref : rgb888_to_rgb565)(dest,
+				wide, BENCH_RGB_PIXELS);
+			break;
+	}
+}
+
+static void bench_rgb565(void)
+{
+	static char *names[] = { "Dim", "Blend (alpha 12/32)",
+		"Blend (alpha 16/32)", "Saturating add", "RGB565 to RGB888",
+		"RGB888 to RGB565" };
+	unsigned short int *src, *dest, *ref;
+	unsigned int *wide, *wide_ref;
+	unsigned int op, count, start, errors;
+
+	kprintf(COLOUR_PUSH FG_CYAN "RGB565 operations (C, then SIMD)"
+		COLOUR_POP "\n");
+
+	if(bench_get_surface() == 0)
+		return;
+
+	src = (unsigned short int *)bench_surface;
+	dest = src + BENCH_RGB_PIXELS;
+	ref = dest + BENCH_RGB_PIXELS;
+	wide = (unsigned int *)(ref + BENCH_RGB_PIXELS);
+	wide_ref = wide + BENCH_RGB_PIXELS;
+
+	for(op=0; op<6; op++)
+	{
+		bench_seed = 1;
+		for(count=0; count<BENCH_RGB_PIXELS; count++)
+		{
+			src[count] = bench_random() >> 16;
+			dest[count] = ref[count] = bench_random() >> 16;
+			wide[count] = wide_ref[count] = bench_random() >> 8;
+		}
+
+		kprintf("  %s\n", names[op]);
+
+		start = timer_read();
+		bench_rgb565_run(op, 1, ref, src, wide_ref);
+		bench_pixels("C", BENCH_RGB_PIXELS, timer_read() - start);
+
+		start = timer_read();
+		bench_rgb565_run(op, 0, dest, src, wide);
+		bench_pixels("SIMD", BENCH_RGB_PIXELS, timer_read() - start);
+
+		errors = 0;
+		for(count=0; count<BENCH_RGB_PIXELS; count++)
+			if(dest[count] != ref[count] ||
+				wide[count] != wide_ref[count])
+				errors++;
+
+		if(errors)
+			kprintf(COLOUR_PUSH FG_RED "    %u pixels differ"
+				COLOUR_POP "\n", errors);
+	}
+}
+
+/* Blocking: a thread of higher priority waits in a wait queue and is
+ * woken BENCH_LOOPS times, running straight away each time, so again each
+ * loop is two switches. Then it exits, and this thread sleeps a few times,
+ * which should switch to the idle thread and back each time
+ */
+static struct wait_queue bench_queue = WAIT_QUEUE_INIT;
+static volatile unsigned int bench_waiting, bench_posted, bench_woken;
+
+#define BENCH_SLEEPS	16
+#define BENCH_SLEEP	1000
+
+static void bench_wait_thread(void *arg)
+{
+	unsigned int cpsr;
+
+	while(1)
+	{
+		cpsr = irq_save();
+		while(!bench_posted)
+			thread_wait(&bench_queue);
+		bench_posted = 0;
+		irq_restore(cpsr);
+
+		if(!bench_waiting)
+			break;
+		bench_woken++;
+	}
+}
+
+static void bench_blocking(void)
+{
+	struct thread *t;
+	unsigned int count, start, cycles, switches, took, least = ~0, most = 0;
+
+	bench_waiting = 1;
+	bench_posted = 0;
+	bench_woken = 0;
+	t = thread_create("wait", bench_wait_thread, 0,
+		thread_current()->priority + 1);
+	if(!t)
+	{
+		kprintf("  Couldn't create thread\n");
+		return;
+	}
+
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+	{
+		bench_posted = 1;
+		thread_wake_one(&bench_queue);
+	}
+	cycles = cycles_read() - start;
+
+	/* The last wake-up makes it return, and exit */
+	bench_waiting = 0;
+	bench_posted = 1;
+	thread_wake_one(&bench_queue);
+
+	bench_result("Context switch (wake)", cycles, BENCH_LOOPS * 2);
+	if(bench_woken != BENCH_LOOPS || t->state != THREAD_FREE)
+		kprintf(COLOUR_PUSH FG_RED "    Woken %u times, not %u; "
+			"state %u after exit" COLOUR_POP "\n", bench_woken,
+			BENCH_LOOPS, t->state);
+
+	switches = thread_switches();
+	for(count=0; count<BENCH_SLEEPS; count++)
+	{
+		start = timer_read();
+		thread_sleep(BENCH_SLEEP);
+		took = timer_read() - start;
+
+		if(took < least)
+			least = took;
+		if(took > most)
+			most = took;
+	}
+	switches = thread_switches() - switches;
+
+	kprintf("  Sleep %uus: %u-%uus, %u switches\n", BENCH_SLEEP, least,
+		most, switches);
+	if(least < BENCH_SLEEP || switches < BENCH_SLEEPS * 2)
+		kprintf(COLOUR_PUSH FG_RED "    Woke early, or didn't block"
+			COLOUR_POP "\n");
+}
+
+/* Context switches: this thread and another of the same priority take
+ * turns with thread_yield(), so each loop is two switches
+ */
+static volatile unsigned int bench_yielding;
+
+static void bench_yield_thread(void *arg)
+{
+	while(bench_yielding)
+		thread_yield();
+}
+
+static void bench_threads(void)
+{
+	unsigned int count, start, cycles, switches;
+
+	kprintf(COLOUR_PUSH FG_CYAN "Threads" COLOUR_POP "\n");
+
+	bench_yielding = 1;
+	if(!thread_create("yield", bench_yield_thread, 0,
+		thread_current()->priority))
+	{
+		kprintf("  Couldn't create thread\n");
+		return;
+	}
+
+	switches = thread_switches();
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+		thread_yield();
+	cycles = cycles_read() - start;
+	switches = thread_switches() - switches;
+
+	bench_yielding = 0;
+	thread_yield();
+
+	bench_result("Context switch (yield)", cycles, BENCH_LOOPS * 2);
+	kprintf("  %u switches\n", switches);
+
+	bench_blocking();
+}
+
+/* Tasks: the cost of posting, and of posting and running straight away.
+ * The latencies (post to start) are in the task statistics
+ */
+static void bench_task(void *arg)
+{
+	(*(unsigned int *)arg)++;
+}
+
+/* Latency from idle: another thread posts a task every BENCH_WAKE_DELAY
+ * microseconds while this one waits for tasks as task_run() does, so the
+ * CPU halts in the idle thread in between
+ */
+#define BENCH_WAKES		64
+#define BENCH_WAKE_DELAY	1000
+
+static volatile unsigned int bench_posted_at, bench_wakes;
+static struct stat_histogram bench_wake_latency =
+	STAT_HISTOGRAM_INIT("Task latency from idle", "cycles");
+
+static void bench_wake_task(void *arg)
+{
+	stat_record(&bench_wake_latency, cycles_read() - bench_posted_at);
+	bench_wakes++;
+}
+
+static void bench_post_thread(void *arg)
+{
+	unsigned int count;
+
+	for(count=0; count<BENCH_WAKES; count++)
+	{
+		thread_sleep(BENCH_WAKE_DELAY);
+		bench_posted_at = cycles_read();
+		task_post(bench_wake_task, 0, TASK_PRIORITY_NORMAL);
+	}
+}
+
+static void bench_tasks_idle(void)
+{
+	unsigned int idle;
+
+	stat_histogram_clear(&bench_wake_latency);
+	bench_wakes = 0;
+	idle = thread_idle()->switches;
+
+	if(!thread_create("post", bench_post_thread, 0,
+		thread_current()->priority + 1))
+	{
+		kprintf("  Couldn't create thread\n");
+		return;
+	}
+
+	while(bench_wakes < BENCH_WAKES)
+	{
+		task_wait();
+		task_run_pending();
+	}
+	idle = thread_idle()->switches - idle;
+
+	kprintf("  ");
+	stat_print_histogram(&bench_wake_latency);
+	kprintf("  Idle thread ran %u times\n", idle);
+	if(idle < BENCH_WAKES)
+		kprintf(COLOUR_PUSH FG_RED "    Tasks didn't wait in the "
+			"idle thread" COLOUR_POP "\n");
+}
+
+static void bench_tasks(void)
+{
+	unsigned int count, batch, start, cycles, ran = 0;
+
+	kprintf(COLOUR_PUSH FG_CYAN "Tasks" COLOUR_POP "\n");
+
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+	{
+		task_post(bench_task, &ran, TASK_PRIORITY_NORMAL);
+		task_run_pending();
+	}
+	cycles = cycles_read() - start;
+	bench_result("Post and run", cycles, BENCH_LOOPS);
+
+	/* A queue full at a time */
+	cycles = 0;
+	for(count=0; count<BENCH_LOOPS; count+=TASK_QUEUE_SIZE)
+	{
+		start = cycles_read();
+		for(batch=0; batch<TASK_QUEUE_SIZE; batch++)
+			task_post(bench_task, &ran, TASK_PRIORITY_NORMAL);
+		cycles += cycles_read() - start;
+		task_run_pending();
+	}
+	bench_result("Post", cycles, BENCH_LOOPS);
+
+	if(ran != BENCH_LOOPS * 2)
+		kprintf(COLOUR_PUSH FG_RED "    %u tasks run, not %u"
+			COLOUR_POP "\n", ran, BENCH_LOOPS * 2);
+	kprintf("  ");
+	task_print_stats();
+
+	bench_tasks_idle();
+}
+
+/* Round trip of a system call that does nothing, on the fast path, and
+ * one that gets the full register frame
+ */
+static void bench_syscalls(void)
+{
+	unsigned int count, start, cycles;
+
+	kprintf(COLOUR_PUSH FG_CYAN "System calls" COLOUR_POP "\n");
+
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+		syscall(SYS_NULL, 0);
+	cycles = cycles_read() - start;
+	bench_result("SYS_NULL (fast path)", cycles, BENCH_LOOPS);
+
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+		syscall4(SYS_INFO, 0, 0, 0, 0, 0);
+	cycles = cycles_read() - start;
+	bench_result("SYS_INFO (full frame)", cycles, BENCH_LOOPS);
+}
+
+/* Atomic operations against disabling IRQs, and a put and get on each
+ * kind of ring
+ */
+#define BENCH_RING_SIZE	16
+
+struct bench_rings
+{
+	volatile unsigned int counter;
+	struct spsc_ring spsc;
+	unsigned int spsc_entries[BENCH_RING_SIZE];
+	struct mpsc_ring mpsc;
+	volatile unsigned int mpsc_sequence[BENCH_RING_SIZE];
+};
+
+static void bench_atomics(void)
+{
+	static struct bench_rings *rings;
+	unsigned int count, start, cycles, cpsr, value;
+
+	kprintf(COLOUR_PUSH FG_CYAN "Atomics and rings" COLOUR_POP "\n");
+
+	/* The atomic operations need cached memory */
+	if(!rings)
+		rings = mem_alloc_cached(sizeof(struct bench_rings));
+	if(!rings)
+	{
+		kprintf("  Not enough memory\n");
+		return;
+	}
+
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+		atomic_add(&rings->counter, 1);
+	cycles = cycles_read() - start;
+	bench_result("atomic_add()", cycles, BENCH_LOOPS);
+
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+	{
+		cpsr = irq_save();
+		rings->counter++;
+		irq_restore(cpsr);
+	}
+	cycles = cycles_read() - start;
+	bench_result("Add with IRQs disabled", cycles, BENCH_LOOPS);
+
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+		atomic_cas(&rings->counter, rings->counter, count);
+	cycles = cycles_read() - start;
+	bench_result("atomic_cas()", cycles, BENCH_LOOPS);
+
+	spsc_init(&rings->spsc, rings->spsc_entries, BENCH_RING_SIZE);
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+	{
+		spsc_put(&rings->spsc, count);
+		spsc_get(&rings->spsc, &value);
+	}
+	cycles = cycles_read() - start;
+	bench_result("SPSC put and get", cycles, BENCH_LOOPS);
+
+	mpsc_init(&rings->mpsc, rings->mpsc_sequence, BENCH_RING_SIZE);
+	start = cycles_read();
+	for(count=0; count<BENCH_LOOPS; count++)
+	{
+		if(mpsc_claim(&rings->mpsc, &value))
+			mpsc_publish(&rings->mpsc, value);
+		if(mpsc_peek(&rings->mpsc, &value))
+			mpsc_release(&rings->mpsc);
+	}
+	cycles = cycles_read() - start;
+	bench_result("MPSC put and get", cycles, BENCH_LOOPS);
+}
+
+/* Interrupt latency and jitter. A system timer compare event is set for a
+ * known time. The vector (interrupt_irq_entry()) reads the cycle counter
+ * first thing, into smp_this()->irq_entry; the handler reads it again as
+ * soon as it's called, after the frame has been saved and interrupt_irq()
+ * has dispatched it, and once more when it has cleared the interrupt. So
+ * there are three figures: the time to the vector, the time from there to
+ * the handler, and the time to the handler finishing
+ *
+ * The timer counts microseconds, so each sample waits for it to tick, sets
+ * the event BENCH_IRQ_DELAY microseconds after, and converts that to cycles
+ * at the rate measured at the start. The tick is only seen to within one
+ * read of the timer, so the figures are good to a few tens of cycles; the
+ * spread is the jitter
+ *
+ * Borrows compare channel TIMER_TASKS, as no timer tasks have been started
+ * yet, and puts its handler back afterwards
+ */
+#define BENCH_IRQ_SAMPLES	256
+#define BENCH_IRQ_DELAY		50
+/* A 99th percentile latency to the handler (caches on, no load) above this
+ * many cycles is reported as a regression
+ */
+#define BENCH_IRQ_LIMIT		2000
+
+static volatile unsigned int bench_irq_vector, bench_irq_entry, bench_irq_done;
+static volatile unsigned int bench_irq_fired;
+static unsigned int bench_irq_vectors[BENCH_IRQ_SAMPLES];
+static unsigned int bench_irq_dispatches[BENCH_IRQ_SAMPLES];
+static unsigned int bench_irq_entries[BENCH_IRQ_SAMPLES];
+static unsigned int bench_irq_dones[BENCH_IRQ_SAMPLES];
+static struct stat_histogram bench_irq_histogram =
+	STAT_HISTOGRAM_INIT("  Handler latency", "cycles");
+
+static void bench_irq(void)
+{
+	unsigned int entry = cycles_read();
+
+	timer_compare_clear(TIMER_TASKS);
+	bench_irq_vector = smp_this()->irq_entry;
+	bench_irq_entry = entry;
+	bench_irq_fired = 1;
+	bench_irq_done = cycles_read();
+}
+
+/* Wait for the next tick of the system timer, returning it and the cycle
+ * counter when it was seen
+ */
+static unsigned int bench_tick(unsigned int *cycles)
+{
+	unsigned int start = timer_read(), now;
+
+	while((now = timer_read()) == start);
+	*cycles = cycles_read();
+
+	return now;
+}
+
+/* Turn the caches (and branch prediction) on or off. The ARMv7 cores keep
+ * their data cache, which exclusive access (atomic.h) and coherency between
+ * the cores depend on
+ */
+static char *bench_caches(unsigned int on)
+{
+	unsigned int control, bits = (1<<12) | (1<<11);
+
+	if(cpu_is_arm11())
+		bits |= 1<<2;
+
+	/* Nothing dirty may be left behind when the data cache goes off, and
+	 * nothing stale when it comes back
+	 */
+	flushcache();
+	dsb();
+
+	asm volatile("mrc p15, 0, %[control], c1, c0, 0"
+		: [control] "=r" (control));
+	if(on)
+	{
+		asm volatile("mcr p15, 0, %[zero], c7, c5, 0\n"
+			"mcr p15, 0, %[zero], c7, c5, 6"
+			: : [zero] "r" (0));
+		control |= bits;
+	}
+	else
+		control &= ~bits;
+	asm volatile("mcr p15, 0, %[control], c1, c0, 0\n"
+		"mcr p15, 0, %[zero], c7, c5, 4"
+		: : [control] "r" (control), [zero] "r" (0));
+
+	return cpu_is_arm11() ? "caches off" : "I-cache off";
+}
+
+/* Sort samples, and print their minimum, mean, 99th percentile and maximum.
+ * Returns the 99th percentile
+ */
+static unsigned int bench_latency(char *name, unsigned int *samples)
+{
+	unsigned int count, position, value, total = 0;
+
+	for(count=1; count<BENCH_IRQ_SAMPLES; count++)
+	{
+		value = samples[count];
+		for(position=count; position && samples[position-1] > value;
+			position--)
+			samples[position] = samples[position-1];
+		samples[position] = value;
+	}
+
+	for(count=0; count<BENCH_IRQ_SAMPLES; count++)
+		total += samples[count];
+
+	value = samples[(BENCH_IRQ_SAMPLES * 99 + 99) / 100 - 1];
+	kprintf("    %-10s min %5u, avg %5u, p99 %5u, max %5u\n", name,
+		samples[0], total / BENCH_IRQ_SAMPLES, value,
+		samples[BENCH_IRQ_SAMPLES - 1]);
+
+	return value;
+}
+
+/* Take BENCH_IRQ_SAMPLES samples, logging to the console while waiting for
+ * each if load is set, and print the results. Returns the 99th percentile
+ * latency to the handler
+ */
+static unsigned int bench_irq_run(char *name, unsigned int delay,
+	unsigned int load)
+{
+	unsigned int sample, tick, start, cpsr, p99, lines = 0;
+	int vector, entry, done;
+	char line[48];
+
+	stat_histogram_clear(&bench_irq_histogram);
+
+	for(sample=0; sample<BENCH_IRQ_SAMPLES; sample++)
+	{
+		cpsr = irq_save();
+		tick = bench_tick(&start);
+		bench_irq_fired = 0;
+		timer_compare(TIMER_TASKS, tick + BENCH_IRQ_DELAY);
+		irq_restore(cpsr);
+
+		while(!bench_irq_fired)
+		{
+			if(load)
+			{
+				ksnprintf(line, sizeof(line), "  Logging load, "
+					"line %u\n", lines++);
+				console_write(line);
+			}
+		}
+
+		/* Can come out (just) early, given how the tick was seen */
+		vector = bench_irq_vector - (start + delay);
+		entry = bench_irq_entry - (start + delay);
+		done = bench_irq_done - (start + delay);
+		bench_irq_vectors[sample] = vector < 0 ? 0 : vector;
+		bench_irq_dispatches[sample] = bench_irq_entry -
+			bench_irq_vector;
+		bench_irq_entries[sample] = entry < 0 ? 0 : entry;
+		bench_irq_dones[sample] = done < 0 ? 0 : done;
+		stat_record(&bench_irq_histogram, bench_irq_entries[sample]);
+	}
+
+	kprintf("  %s (cycles):\n", name);
+	ksnprintf(line, sizeof(line), "Interrupt vector p99, %s", name);
+	bench_serial(line, bench_latency("Vector", bench_irq_vectors),
+		"cycles");
+	ksnprintf(line, sizeof(line), "Interrupt dispatch p99, %s", name);
+	bench_serial(line, bench_latency("Dispatch", bench_irq_dispatches),
+		"cycles");
+	p99 = bench_latency("Handler", bench_irq_entries);
+	ksnprintf(line, sizeof(line), "Interrupt handler p99, %s", name);
+	bench_serial(line, p99, "cycles");
+	ksnprintf(line, sizeof(line), "Interrupt completion p99, %s", name);
+	bench_serial(line, bench_latency("Completion", bench_irq_dones),
+		"cycles");
+	stat_print_histogram(&bench_irq_histogram);
+
+	return p99;
+}
+
+static void bench_irq_latency(void)
+{
+	interrupt_handler previous;
+	unsigned int cpsr, tick, start, cycles, delay, p99;
+	char *off;
+
+	kprintf(COLOUR_PUSH FG_CYAN "Interrupt latency" COLOUR_POP "\n");
+
+	/* Cycles in BENCH_IRQ_DELAY microseconds, from 10ms */
+	cpsr = irq_save();
+	tick = bench_tick(&start);
+	while(timer_read() - tick < 10000);
+	cycles = cycles_read() - start;
+	irq_restore(cpsr);
+	delay = cycles / (10000 / BENCH_IRQ_DELAY);
+	kprintf("  %u cycles per microsecond\n", cycles / 10000);
+
+	timer_compare_clear(TIMER_TASKS);
+	previous = interrupt_register(IRQ_SYSTIMER(TIMER_TASKS), bench_irq);
+
+	p99 = bench_irq_run("Idle", delay, 0);
+	bench_irq_run("Console logging", delay, 1);
+
+	off = bench_caches(0);
+	bench_irq_run(off, delay, 0);
+	bench_caches(1);
+
+	timer_compare_clear(TIMER_TASKS);
+	interrupt_register(IRQ_SYSTIMER(TIMER_TASKS), previous);
+
+	if(p99 > BENCH_IRQ_LIMIT)
+		kprintf(COLOUR_PUSH FG_RED "  Idle handler latency (p99) %u "
+			"cycles, over the limit of %u" COLOUR_POP "\n", p99,
+			BENCH_IRQ_LIMIT);
+}
+
+void benchmarks(void)
+{
+	cycles_init();
+
+	console_write(COLOUR_PUSH BG_MAGENTA BG_HALF
+		"\nBenchmarks (cycles per iteration)\n" COLOUR_POP);
+
+	bench_todec();
+	bench_uart();
+	bench_dma();
+	bench_backbuffer();
+	bench_memory();
+	bench_present();
+	bench_depths();
+	bench_fonts();
+	bench_gfx();
+	bench_rgb565();
+	bench_atomics();
+	bench_threads();
+	bench_tasks();
+	bench_syscalls();
+	bench_irq_latency();
+}
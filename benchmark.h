@@ -0,0 +1,9 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/* Run the built-in benchmarks and print the results on the console. Only
+ * called when the kernel is built with "make BENCHMARK=1"
+ */
+extern void benchmarks(void);
+
+#endif	/* BENCHMARK_H */
@@ -0,0 +1,302 @@
+/* BCM2835 DMA controller
+ *
+ * BCM2835 peripherals guide, chapter 4. Channels 0-14 are at 0x20007000,
+ * 0x100 apart. Channels 0-6 are full channels; 7-14 are "lite" channels,
+ * which can't do 2D transfers and are limited to 64K per control block.
+ * VideoCore uses some channels itself, and the firmware says which are
+ * free for the ARM.
+ *
+ * A transfer is described by a chain of control blocks in memory. The
+ * channel is given the bus address of the first, and works through the
+ * chain on its own. An interrupt is raised when the last one finishes.
+ */
+
+#include "dma.h"
+
+#include "barrier.h"
+#include "interrupts.h"
+#include "mailbox.h"
+#include "memory.h"
+#include "soc.h"
+
+static volatile unsigned int *dmaBase = (unsigned int *) mem_p2v(0x20007000);
+static volatile unsigned int *dmaIntStatus = (unsigned int *) mem_p2v(0x20007fe0);
+static volatile unsigned int *dmaEnable = (unsigned int *) mem_p2v(0x20007ff0);
+
+/* Channel registers, as word offsets */
+#define DMA_CS		0
+#define DMA_CONBLK_AD	1
+#define DMA_DEBUG	8
+
+#define DMA_REG(ch, reg)	dmaBase[(ch) * 64 + (reg)]
+
+/* Control/status register bits */
+#define CS_ACTIVE	(1<<0)
+#define CS_END		(1<<1)
+#define CS_INT		(1<<2)
+#define CS_ERROR	(1<<8)
+#define CS_WAIT_WRITES	(1<<28)
+#define CS_ABORT	(1<<30)
+#define CS_RESET	(1<<31)
+/* AXI priority (bits 16-19) and panic priority (bits 20-23) */
+#define CS_PRIORITY	((8<<16) | (8<<20))
+
+/* Transfer information bits */
+#define TI_INTEN	(1<<0)
+#define TI_TDMODE	(1<<1)
+#define TI_WAIT_RESP	(1<<3)
+#define TI_DEST_INC	(1<<4)
+#define TI_DEST_WIDTH	(1<<5)	/* 128 bit writes */
+#define TI_SRC_INC	(1<<8)
+#define TI_SRC_WIDTH	(1<<9)	/* 128 bit reads */
+#define TI_BURST(n)	((n)<<12)
+
+/* Normal copy: both addresses increment, 128 bit accesses in bursts of 8
+ * (as far as alignment allows - the controller sorts that out itself)
+ */
+#define TI_COPY	(TI_SRC_INC | TI_DEST_INC | TI_SRC_WIDTH | TI_DEST_WIDTH | \
+		TI_BURST(8) | TI_WAIT_RESP)
+
+#define DMA_CHANNELS	15
+/* First lite channel */
+#define DMA_LITE	7
+
+/* Used if the firmware doesn't say which channels are free: the mask
+ * Linux uses on the Raspberry Pi
+ */
+#define DMA_DEFAULT_MASK	0x7f35
+
+/* Channels the ARM may use, and channels which have been claimed */
+static unsigned int channel_mask;
+static unsigned int channels_used;
+
+/* Completion callbacks */
+static void (*channel_done[DMA_CHANNELS])(unsigned int channel);
+
+static struct dma_cb channel_cbs[DMA_CHANNELS][DMA_CBS_PER_CHANNEL];
+
+/* Kernel virtual address to DMA bus address. On the BCM2835, bus addresses
+ * for RAM are physical addresses in the 0x40000000 alias, which goes
+ * through the VideoCore L2 cache (as the ARM's accesses do). The BCM2836/7's
+ * ARM cores don't use that cache, so there it's the 0xc0000000 (uncached)
+ * alias
+ */
+static unsigned int dma_bus(const void *address)
+{
+	return (mem_v2p((unsigned int)address) & 0x3fffffff) |
+		(cpu_is_arm11() ? 0x40000000 : 0xc0000000);
+}
+
+/* Completion interrupt for any channel. Each channel has its own IRQ
+ * number, but the global status register says which have finished
+ */
+static void dma_irq(void)
+{
+	unsigned int status = *dmaIntStatus & channel_mask;
+	unsigned int ch;
+
+	dmb();
+
+	while(status)
+	{
+		ch = 31 - __builtin_clz(status);
+		status &= ~(1<<ch);
+
+		/* Clear the interrupt and end flags (write 1 to clear) */
+		DMA_REG(ch, DMA_CS) = CS_INT | CS_END;
+
+		if(channel_done[ch])
+			channel_done[ch](ch);
+	}
+
+	dmb();
+}
+
+/* Ask VideoCore which DMA channels are free (tag 0x60001) */
+static unsigned int dma_free_channels(void)
+{
+	volatile unsigned int mailbuffer[8] __attribute__((aligned (16)));
+
+	mailbuffer[0] = 7 * 4;		// Total size
+	mailbuffer[1] = 0;		// Request
+	mailbuffer[2] = 0x60001;	// Get DMA channels
+	mailbuffer[3] = 4;		// Buffer size
+	mailbuffer[4] = 0;		// Request size
+	mailbuffer[5] = 0;		// Space for mask
+	mailbuffer[6] = 0;		// End tag
+
+	writemailbox(8, mem_v2p((unsigned int)mailbuffer));
+	readmailbox(8);
+
+	if(mailbuffer[1] != 0x80000000 || mailbuffer[5] == 0)
+		return DMA_DEFAULT_MASK;
+
+	return mailbuffer[5];
+}
+
+void dma_init(void)
+{
+	unsigned int ch;
+
+	channel_mask = dma_free_channels() & ((1<<DMA_CHANNELS) - 1);
+	channels_used = 0;
+
+	for(ch=0; ch<DMA_CHANNELS; ch++)
+	{
+		if(!(channel_mask & (1<<ch)))
+			continue;
+
+		*dmaEnable |= 1<<ch;
+		DMA_REG(ch, DMA_CS) = CS_RESET;
+
+		/* Channels 11-14 share an interrupt */
+		interrupt_register(IRQ_DMA(ch < 11 ? ch : 11), dma_irq);
+	}
+}
+
+int dma_channel_alloc(unsigned int flags)
+{
+	unsigned int free = channel_mask & ~channels_used;
+	unsigned int ch;
+
+	if(flags & DMA_CHANNEL_FULL)
+		free &= (1<<DMA_LITE) - 1;
+
+	if(!free)
+		return -1;
+
+	/* Prefer lite channels when a full one isn't needed, leaving the full
+	 * ones for those which do
+	 */
+	ch = 31 - __builtin_clz(free);
+	if(flags & DMA_CHANNEL_FULL)
+		ch = __builtin_ctz(free);
+
+	channels_used |= 1<<ch;
+	channel_done[ch] = 0;
+
+	return ch;
+}
+
+void dma_channel_free(unsigned int channel)
+{
+	if(channel >= DMA_CHANNELS)
+		return;
+
+	dma_wait(channel);
+	channels_used &= ~(1<<channel);
+}
+
+struct dma_cb *dma_channel_cbs(unsigned int channel)
+{
+	return channel_cbs[channel];
+}
+
+void dma_cb_copy(struct dma_cb *cb, void *dest, const void *src,
+	unsigned int length)
+{
+	cb->ti = TI_COPY;
+	cb->source_ad = dma_bus(src);
+	cb->dest_ad = dma_bus(dest);
+	cb->txfr_len = length;
+	cb->stride = 0;
+	cb->nextconbk = 0;
+}
+
+void dma_cb_copy2d(struct dma_cb *cb, void *dest, int dest_pitch,
+	const void *src, int src_pitch, unsigned int width, unsigned int rows)
+{
+	cb->ti = TI_COPY | TI_TDMODE;
+	cb->source_ad = dma_bus(src);
+	cb->dest_ad = dma_bus(dest);
+
+	/* The controller performs YLENGTH + 1 rows. The strides are added
+	 * to the addresses at the end of each row, which have already moved
+	 * on by width
+	 */
+	cb->txfr_len = ((rows - 1) << 16) | width;
+	cb->stride = (((dest_pitch - (int)width) & 0xffff) << 16) |
+		((src_pitch - (int)width) & 0xffff);
+	cb->nextconbk = 0;
+}
+
+void dma_cb_fill(struct dma_cb *cb, void *dest, unsigned int value,
+	unsigned int length)
+{
+	/* The source is the fill word in the control block itself, read
+	 * over and over without incrementing
+	 */
+	cb->fill = value;
+	cb->ti = TI_DEST_INC | TI_BURST(8) | TI_WAIT_RESP;
+	cb->source_ad = dma_bus(&cb->fill);
+	cb->dest_ad = dma_bus(dest);
+	cb->txfr_len = length;
+	cb->stride = 0;
+	cb->nextconbk = 0;
+}
+
+void dma_cb_link(struct dma_cb *cb, struct dma_cb *next)
+{
+	cb->nextconbk = dma_bus(next);
+}
+
+void dma_start(unsigned int channel, struct dma_cb *first,
+	void (*done)(unsigned int channel))
+{
+	struct dma_cb *cb = first;
+
+	dma_wait(channel);
+
+	/* Only the last block in the chain raises an interrupt. The chain
+	 * has to be walked through the kernel's own copy of the addresses,
+	 * as nextconbk is a bus address
+	 */
+	while(cb->nextconbk)
+	{
+		cb->ti &= ~TI_INTEN;
+		cb = (struct dma_cb *) mem_p2v((cb->nextconbk & 0x3fffffff));
+	}
+	cb->ti |= TI_INTEN;
+
+	channel_done[channel] = done;
+
+	/* Make sure the control blocks are in memory before the DMA engine
+	 * reads them
+	 */
+	dsb();
+
+	DMA_REG(channel, DMA_CONBLK_AD) = dma_bus(first);
+	DMA_REG(channel, DMA_CS) = CS_ACTIVE | CS_WAIT_WRITES | CS_PRIORITY;
+}
+
+void dma_memcpy(unsigned int channel, void *dest, const void *src,
+	unsigned int length)
+{
+	struct dma_cb *cb = channel_cbs[channel];
+
+	dma_wait(channel);
+	dma_cb_copy(cb, dest, src, length);
+	dma_start(channel, cb, 0);
+}
+
+void dma_fill(unsigned int channel, void *dest, unsigned int value,
+	unsigned int length)
+{
+	struct dma_cb *cb = channel_cbs[channel];
+
+	dma_wait(channel);
+	dma_cb_fill(cb, dest, value, length);
+	dma_start(channel, cb, 0);
+}
+
+unsigned int dma_busy(unsigned int channel)
+{
+	return DMA_REG(channel, DMA_CS) & CS_ACTIVE;
+}
+
+void dma_wait(unsigned int channel)
+{
+	while(DMA_REG(channel, DMA_CS) & CS_ACTIVE);
+
+	dmb();
+}
@@ -0,0 +1,80 @@
+#ifndef DMA_H
+#define DMA_H
+
+/* DMA control block - BCM2835 peripherals guide, p.40
+ * Must be 32 byte aligned. Addresses are VideoCore bus addresses; the
+ * dma_cb_* functions fill these in from kernel virtual addresses
+ */
+struct dma_cb
+{
+	unsigned int ti;		/* Transfer information */
+	unsigned int source_ad;
+	unsigned int dest_ad;
+	unsigned int txfr_len;
+	unsigned int stride;		/* 2D mode only */
+	unsigned int nextconbk;		/* Next control block, or 0 */
+	unsigned int fill;		/* Fill value for dma_cb_fill */
+	unsigned int reserved;
+} __attribute__ ((aligned (32)));
+
+/* Control blocks available to each channel through dma_channel_cbs() */
+#define DMA_CBS_PER_CHANNEL	4
+
+/* dma_channel_alloc flags */
+#define DMA_CHANNEL_ANY		0
+/* A full channel (0-6) rather than a "lite" one (7-14), for 2D transfers
+ * and transfers longer than 64K
+ */
+#define DMA_CHANNEL_FULL	1
+
+extern void dma_init(void);
+
+/* Claim a free channel. Returns the channel number, or -1 if there isn't
+ * one available
+ */
+extern int dma_channel_alloc(unsigned int flags);
+extern void dma_channel_free(unsigned int channel);
+
+/* The channel's own control blocks, for building chains */
+extern struct dma_cb *dma_channel_cbs(unsigned int channel);
+
+/* Fill in control blocks. Memory areas must be physically contiguous (true
+ * of kernel data and the framebuffer)
+ *
+ * dma_cb_copy - copy length bytes
+ * dma_cb_copy2d - copy rows of width bytes, rows times. After each row, the
+ *	source and destination addresses move on by their pitch
+ * dma_cb_fill - fill length bytes with a repeated 32 bit value. length must
+ *	be a multiple of 4
+ * dma_cb_link - make next follow cb in a chain
+ */
+extern void dma_cb_copy(struct dma_cb *cb, void *dest, const void *src,
+	unsigned int length);
+extern void dma_cb_copy2d(struct dma_cb *cb, void *dest, int dest_pitch,
+	const void *src, int src_pitch, unsigned int width, unsigned int rows);
+extern void dma_cb_fill(struct dma_cb *cb, void *dest, unsigned int value,
+	unsigned int length);
+extern void dma_cb_link(struct dma_cb *cb, struct dma_cb *next);
+
+/* Start a chain of control blocks on channel, waiting for anything already
+ * running on it first. done (which may be 0) is called from the DMA
+ * interrupt once the whole chain has finished
+ */
+extern void dma_start(unsigned int channel, struct dma_cb *first,
+	void (*done)(unsigned int channel));
+
+/* Single asynchronous copy/fill, using the channel's first control block */
+extern void dma_memcpy(unsigned int channel, void *dest, const void *src,
+	unsigned int length);
+extern void dma_fill(unsigned int channel, void *dest, unsigned int value,
+	unsigned int length);
+
+/* Non-zero while a transfer is running on channel */
+extern unsigned int dma_busy(unsigned int channel);
+
+/* Wait for the transfer on channel to finish. Polls the channel, so can be
+ * used with interrupts disabled
+ */
+extern void dma_wait(unsigned int channel);
+
+#endif	/* DMA_H */
@@ -0,0 +1,50 @@
+#ifndef FASTDIV_H
+#define FASTDIV_H
+
+/* Division by constants without a divide instruction
+ *
+ * The ARM1176 has no hardware divide, and a general division is a call to
+ * libgcc's __aeabi_uidiv/__aeabi_uidivmod, which loops over the bits of the
+ * result. When the divisor is fixed, x / d can instead be calculated as
+ * (x * m) >> (32 + s), where m is roughly 2^(32+s) / d. That is a single
+ * UMULL, plus a shift.
+ *
+ * m = floor(2^(32+s) / d) + 1 gives the exact result for every 32 bit x
+ * as long as m * d - 2^(32+s) <= 2^s, and m fits in 32 bits. The divisors
+ * below have been checked against all 2^32 values of x. For anything else,
+ * check before use - not every divisor has a shift which works (7 doesn't,
+ * for instance)
+ *
+ *	d	s		d	s
+ *	3	1		100	6
+ *	5	2		1000	9
+ *	6	2		10000	13
+ *	10	3		1000000	18
+ *	12	3
+ */
+
+/* Magic multiplier for division by d with shift s. d and s must be
+ * constants, so that the compiler works this out, not libgcc
+ */
+#define FASTDIV_MAGIC(d, s) \
+		((unsigned int)((0x100000000ULL << (s)) / (d) + 1))
+
+/* x / d, given a magic number and shift. Compiles to UMULL and a shift of
+ * the high word
+ */
+static inline unsigned int fastdiv(unsigned int x, unsigned int magic,
+	unsigned int shift)
+{
+	return (unsigned int)(((unsigned long long)x * magic) >> 32) >> shift;
+}
+
+/* x / d for a constant d and its shift from the table above */
+#define UDIV_CONST(x, d, s) fastdiv((x), FASTDIV_MAGIC(d, s), (s))
+
+/* Common cases */
+#define udiv10(x)	UDIV_CONST((x), 10, 3)
+#define udiv100(x)	UDIV_CONST((x), 100, 6)
+#define udiv1000(x)	UDIV_CONST((x), 1000, 9)
+#define udiv1000000(x)	UDIV_CONST((x), 1000000, 18)
+
+#endif	/* FASTDIV_H */
@@ -0,0 +1,283 @@
+/* Framebuffer pixel kernels, one set per depth
+ *
+ * Each depth's kernels are generated from the same macros, given the number
+ * of bytes per pixel and how to store one pixel. The depth is chosen once,
+ * when the framebuffer is set up, by picking a table of function pointers -
+ * nothing tests the depth per pixel
+ *
+ * 24 and 32bpp pixels are 0xRRGGBB, little-endian (blue first in memory),
+ * which is what the firmware gives with pixel order 0 ("BGR")
+ */
+
+#include "fbops.h"
+
+#include "memutils.h"
+
+/* Store one pixel */
+#define PUT8(a, c)	(*(unsigned char *)(a) = (c))
+#define PUT16(a, c)	(*(unsigned short int *)(a) = (c))
+#define PUT24(a, c)	(((unsigned char *)(a))[0] = (c), \
+			((unsigned char *)(a))[1] = (c) >> 8, \
+			((unsigned char *)(a))[2] = (c) >> 16)
+#define PUT32(a, c)	(*(unsigned int *)(a) = (c))
+
+/* Read one pixel */
+#define GET8(a)		(*(unsigned char *)(a))
+#define GET16(a)	(*(unsigned short int *)(a))
+#define GET24(a)	(((unsigned char *)(a))[0] | \
+			(((unsigned char *)(a))[1] << 8) | \
+			(((unsigned char *)(a))[2] << 16))
+#define GET32(a)	(*(unsigned int *)(a))
+
+/* A pixel value repeated to fill a word */
+#define REPLICATE8(c)	((c) * 0x01010101)
+#define REPLICATE16(c)	((c) | ((c) << 16))
+#define REPLICATE32(c)	(c)
+
+/* Colour conversion */
+static unsigned int colour8(unsigned int rgb)
+{
+	return ((rgb >> 16) & 0xe0) | ((rgb >> 11) & 0x1c) | ((rgb >> 6) & 3);
+}
+
+static unsigned int colour16(unsigned int rgb)
+{
+	return ((rgb >> 8) & 0xf800) | ((rgb >> 5) & 0x07e0) |
+		((rgb >> 3) & 0x001f);
+}
+
+static unsigned int colour24(unsigned int rgb)
+{
+	return rgb & 0xffffff;
+}
+
+unsigned int fb_rgb332_palette(unsigned int i)
+{
+	unsigned int r = (i >> 5) & 7;
+	unsigned int g = (i >> 2) & 7;
+	unsigned int b = i & 3;
+
+	/* Stretch each component to 8 bits by repeating its bits */
+	r = (r << 5) | (r << 2) | (r >> 1);
+	g = (g << 5) | (g << 2) | (g >> 1);
+	b = b * 0x55;
+
+	return (r << 16) | (g << 8) | b;
+}
+
+/* Spans for depths which divide into a word: single pixels up to a word
+ * boundary, whole words of the repeated colour in bursts, then the last
+ * few pixels
+ */
+#define FB_SPAN_WORDS(name, BYTES, PUT, REPLICATE)			\
+static void name(unsigned int addr, unsigned int width,			\
+	unsigned int colour)						\
+{									\
+	unsigned int words;						\
+									\
+	while((addr & 3) && width)					\
+	{								\
+		PUT(addr, colour);					\
+		addr += BYTES;						\
+		width--;						\
+	}								\
+									\
+	words = (width * BYTES) >> 2;					\
+	memfill32((void *)addr, REPLICATE(colour), words);		\
+	addr += words << 2;						\
+	width -= (words << 2) / BYTES;					\
+									\
+	while(width--)							\
+	{								\
+		PUT(addr, colour);					\
+		addr += BYTES;						\
+	}								\
+}
+
+FB_SPAN_WORDS(span8, 1, PUT8, REPLICATE8)
+FB_SPAN_WORDS(span16, 2, PUT16, REPLICATE16)
+FB_SPAN_WORDS(span32, 4, PUT32, REPLICATE32)
+
+/* 24bpp spans: four pixels fit in three words, once the address is word
+ * aligned (at most three pixels in)
+ */
+static void span24(unsigned int addr, unsigned int width, unsigned int colour)
+{
+	unsigned int w0, w1, w2, groups;
+
+	while((addr & 3) && width)
+	{
+		PUT24(addr, colour);
+		addr += 3;
+		width--;
+	}
+
+	w0 = colour | (colour << 24);
+	w1 = (colour >> 8) | (colour << 16);
+	w2 = (colour >> 16) | (colour << 8);
+
+	for(groups = width >> 2; groups; groups--)
+	{
+		((unsigned int *)addr)[0] = w0;
+		((unsigned int *)addr)[1] = w1;
+		((unsigned int *)addr)[2] = w2;
+		addr += 12;
+	}
+
+	for(width &= 3; width; width--)
+	{
+		PUT24(addr, colour);
+		addr += 3;
+	}
+}
+
+/* Everything else, for one depth */
+#define FB_KERNELS(DEPTH, BYTES, PUT, GET)				\
+static void plot##DEPTH(unsigned int addr, unsigned int colour)		\
+{									\
+	PUT(addr, colour);						\
+}									\
+									\
+static void vspan##DEPTH(unsigned int addr, unsigned int pitch,		\
+	unsigned int height, unsigned int colour)			\
+{									\
+	while(height--)							\
+	{								\
+		PUT(addr, colour);					\
+		addr += pitch;						\
+	}								\
+}									\
+									\
+static void fill##DEPTH(unsigned int addr, unsigned int pitch,		\
+	unsigned int width, unsigned int height, unsigned int colour)	\
+{									\
+	while(height--)							\
+	{								\
+		span##DEPTH(addr, width, colour);			\
+		addr += pitch;						\
+	}								\
+}									\
+									\
+static void line##DEPTH(unsigned int addr, int major_step,		\
+	int minor_step, unsigned int length, unsigned int major_len,	\
+	unsigned int minor_len, unsigned int colour)			\
+{									\
+	int error = major_len >> 1;					\
+									\
+	length++;							\
+	while(length--)							\
+	{								\
+		PUT(addr, colour);					\
+		addr += major_step;					\
+		error -= minor_len;					\
+		if(error < 0)						\
+		{							\
+			addr += minor_step;				\
+			error += major_len;				\
+		}							\
+	}								\
+}									\
+									\
+static void glyph##DEPTH(unsigned int addr, unsigned int pitch,		\
+	const unsigned int *rows, unsigned int width,			\
+	unsigned int height, unsigned int fg, unsigned int bg)		\
+{									\
+	unsigned int pattern, mask, a;					\
+									\
+	while(height--)							\
+	{								\
+		pattern = *rows++;					\
+		a = addr;						\
+									\
+		for(mask = 1 << (width - 1); mask; mask >>= 1)		\
+		{							\
+			PUT(a, (pattern & mask) ? fg : bg);		\
+			a += BYTES;					\
+		}							\
+									\
+		addr += pitch;						\
+	}								\
+}									\
+									\
+/* Work upwards if the destination is lower down in memory than an	\
+ * overlapping source							\
+ */									\
+static void blit##DEPTH(unsigned int dest, unsigned int dest_pitch,	\
+	unsigned int src, unsigned int src_pitch, unsigned int width,	\
+	unsigned int height)						\
+{									\
+	if(dest > src && height)					\
+	{								\
+		dest += (height - 1) * dest_pitch;			\
+		src += (height - 1) * src_pitch;			\
+									\
+		while(height--)						\
+		{							\
+			memmove((void *)dest, (void *)src,		\
+				width * BYTES);				\
+			dest -= dest_pitch;				\
+			src -= src_pitch;				\
+		}							\
+									\
+		return;							\
+	}								\
+									\
+	while(height--)							\
+	{								\
+		memmove((void *)dest, (void *)src, width * BYTES);	\
+		dest += dest_pitch;					\
+		src += src_pitch;					\
+	}								\
+}									\
+									\
+static void blit_key##DEPTH(unsigned int dest, unsigned int dest_pitch,	\
+	unsigned int src, unsigned int src_pitch, unsigned int width,	\
+	unsigned int height, unsigned int key)				\
+{									\
+	unsigned int d, s, x, pixel;					\
+									\
+	while(height--)							\
+	{								\
+		d = dest;						\
+		s = src;						\
+									\
+		for(x=width; x; x--)					\
+		{							\
+			pixel = GET(s);					\
+			if(pixel != key)				\
+				PUT(d, pixel);				\
+			d += BYTES;					\
+			s += BYTES;					\
+		}							\
+									\
+		dest += dest_pitch;					\
+		src += src_pitch;					\
+	}								\
+}									\
+									\
+static const struct fb_ops fb_ops##DEPTH = {				\
+	DEPTH, BYTES, colour##DEPTH, plot##DEPTH, span##DEPTH,		\
+	vspan##DEPTH, fill##DEPTH, line##DEPTH, glyph##DEPTH, blit##DEPTH, \
+	blit_key##DEPTH							\
+};
+
+/* 32bpp uses the same colours as 24bpp */
+#define colour32	colour24
+
+FB_KERNELS(8, 1, PUT8, GET8)
+FB_KERNELS(16, 2, PUT16, GET16)
+FB_KERNELS(24, 3, PUT24, GET24)
+FB_KERNELS(32, 4, PUT32, GET32)
+
+const struct fb_ops *fb_ops_for_depth(unsigned int bpp)
+{
+	switch(bpp)
+	{
+		case 8: return &fb_ops8;
+		case 16: return &fb_ops16;
+		case 24: return &fb_ops24;
+		case 32: return &fb_ops32;
+	}
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef FBOPS_H
+#define FBOPS_H
+
+/* Pixel kernels for one framebuffer depth
+ *
+ * Addresses are of the first (top left) pixel, pitch is bytes per line,
+ * and widths/heights are in pixels. Colours passed to the kernels are pixel
+ * values for the depth, as returned by colour(); convert once when a colour
+ * is chosen, not for every pixel
+ *
+ * plot - set one pixel
+ * span - fill width pixels of one line
+ * vspan - fill height pixels of one column
+ * fill - fill a width x height rectangle
+ * line - Bresenham line of length + 1 pixels. Each pixel moves major_step
+ *	bytes along the major axis, and minor_step along the minor axis when
+ *	the error term (major_len/2 to start with) runs out
+ * glyph - draw a 1 bit per pixel image. Bit (width-1) of each row is the
+ *	leftmost pixel; set bits are fg, clear bits bg. width <= 32
+ * blit - copy a width x height rectangle of pixels
+ * blit_key - as blit, but source pixels equal to key aren't copied
+ */
+struct fb_ops
+{
+	unsigned int bpp;
+	unsigned int bytes;		/* Bytes per pixel */
+
+	/* 0xRRGGBB to a pixel value */
+	unsigned int (*colour)(unsigned int rgb);
+
+	void (*plot)(unsigned int addr, unsigned int colour);
+	void (*span)(unsigned int addr, unsigned int width,
+		unsigned int colour);
+	void (*vspan)(unsigned int addr, unsigned int pitch,
+		unsigned int height, unsigned int colour);
+	void (*fill)(unsigned int addr, unsigned int pitch, unsigned int width,
+		unsigned int height, unsigned int colour);
+	void (*line)(unsigned int addr, int major_step, int minor_step,
+		unsigned int length, unsigned int major_len,
+		unsigned int minor_len, unsigned int colour);
+	void (*glyph)(unsigned int addr, unsigned int pitch,
+		const unsigned int *rows, unsigned int width,
+		unsigned int height, unsigned int fg, unsigned int bg);
+	void (*blit)(unsigned int dest, unsigned int dest_pitch,
+		unsigned int src, unsigned int src_pitch, unsigned int width,
+		unsigned int height);
+	void (*blit_key)(unsigned int dest, unsigned int dest_pitch,
+		unsigned int src, unsigned int src_pitch, unsigned int width,
+		unsigned int height, unsigned int key);
+};
+
+/* Kernels for 8 (RGB332 palette), 16 (RGB565), 24 or 32 bpp. Returns 0 for
+ * any other depth
+ */
+extern const struct fb_ops *fb_ops_for_depth(unsigned int bpp);
+
+/* RGB332 palette colour i as 0xRRGGBB, for setting up 8bpp modes */
+extern unsigned int fb_rgb332_palette(unsigned int i);
+
+#endif	/* FBOPS_H */
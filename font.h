@@ -0,0 +1,47 @@
+#ifndef FONT_H
+#define FONT_H
+
+/* Console fonts
+ *
+ * Each glyph is one word per row of the character cell, with bit (width-1)
+ * the leftmost pixel - the format the fb_ops glyph kernels take, so glyphs
+ * are drawn straight from the table. Any space between characters is part
+ * of the cell
+ *
+ * The tables are generated from BDF fonts in fonts/ by tools/mkfont when
+ * the kernel is built
+ */
+struct font
+{
+	const char *name;
+	unsigned int width, height;	/* Cell size in pixels */
+	unsigned int first, count;	/* Character codes in the table */
+	unsigned int missing;		/* Glyph used for any other code */
+	const unsigned int *glyphs;	/* count glyphs of height rows */
+
+	/* fastdiv() magic numbers and shifts for dividing by the cell
+	 * width and height, exact for any screen coordinate
+	 */
+	unsigned int div_x_magic, div_x_shift;
+	unsigned int div_y_magic, div_y_shift;
+};
+
+/* SAA5050 (teletext) characters in 6x10 cells */
+extern const struct font font_teletext;
+/* The same, doubled to 12x20 with the SAA5050's character rounding */
+extern const struct font font_teletext2x;
+/* 8x16 */
+extern const struct font font_8x16;
+
+/* Rows of the glyph for character ch */
+static inline const unsigned int *font_glyph(const struct font *font,
+	unsigned int ch)
+{
+	ch -= font->first;
+	if(ch >= font->count)
+		ch = font->missing;
+
+	return font->glyphs + ch * font->height;
+}
+
+#endif	/* FONT_H */
@@ -1,13 +1,19 @@
 #include "framebuffer.h"
 #include "barrier.h"
+#include "dma.h"
+#include "fastdiv.h"
+#include "fbops.h"
+#include "font.h"
+#include "kprintf.h"
 #include "led.h"
 #include "mailbox.h"
 #include "memory.h"
 #include "memutils.h"
-#include "textutils.h"
-
-/* SAA5050 (teletext) character definitions */
-#include "teletext.h"
+#include "stats.h"
+#include "thread.h"
+#include "timer.h"
+#include "trace.h"
+#include "uart.h"
 
 /* Framebuffer initialisation failure codes
  * If the FB can't be initialised, one of the following numbers will be
@@ -30,16 +36,77 @@
 #define FBFAIL_INVALID_PITCH_RESPONSE	7
 /* Read FB pitch call returned an invalid pitch value */
 #define FBFAIL_INVALID_PITCH_DATA	8
+/* Framebuffer has a depth there are no pixel kernels for */
+#define FBFAIL_UNSUPPORTED_DEPTH	9
 
-/* Character cells are 6x10 */
-#define CHARSIZE_X	6
-#define CHARSIZE_Y	10
+/* Bits per pixel to ask for: 8 (RGB332 palette), 16 (RGB565), 24 or 32.
+ * Set with "make FB_DEPTH=n"
+ */
+#ifndef FB_DEPTH
+#define FB_DEPTH	16
+#endif
 
 /* Screen parameters set in fb_init() */
 static unsigned int screenbase, screensize;
-static unsigned int fb_x, fb_y, pitch;
-/* Max x/y character cell */
+static unsigned int fb_x, fb_y, pitch, depth;
+/* Pixel kernels for the depth */
+static const struct fb_ops *ops;
+/* Console font, and max x/y character cell */
+static const struct font *font;
 static unsigned int max_x, max_y;
+/* The viewport console_write() writes to */
+static struct viewport console;
+
+/* Everything is drawn into a back buffer in cached RAM, the same size and
+ * layout as the framebuffer. Areas which have changed are recorded as dirty
+ * rectangles, and fb_flush() copies just those to the framebuffer. If there
+ * isn't enough memory for a back buffer, drawbase is the framebuffer itself
+ */
+static unsigned int drawbase;
+
+/* Dirty rectangles, in pixels (x1/y1 exclusive) */
+struct fb_rect
+{
+	unsigned int x0, y0, x1, y1;
+};
+
+/* One DMA control block per rectangle */
+#define FB_DIRTY_MAX	DMA_CBS_PER_CHANNEL
+
+static struct fb_rect dirty[FB_DIRTY_MAX];
+static unsigned int dirty_count = 0;
+
+/* DMA channel used to flush the back buffer, or -1 to use the CPU */
+static int flush_dma = -1;
+
+/* Double buffering. The framebuffer is allocated with a virtual height of
+ * twice the screen, giving two pages. The page being displayed is front;
+ * in double buffered mode, fb_flush() updates the other page and then
+ * flips to it. That page is one frame behind the back buffer, so it gets
+ * the areas which changed in the previous frame as well
+ */
+static unsigned int pages = 1;
+static unsigned int front = 0;
+static unsigned int double_buffered = 0;
+
+static struct fb_rect prev_dirty[FB_DIRTY_MAX];
+static unsigned int prev_dirty_count = 0;
+
+/* Set if the firmware supports waiting for vsync (tag 0x4800e) */
+static unsigned int vsync_supported = 1;
+
+static struct fb_present_stats present_stats;
+/* Time of the previous present, for the frame time */
+static unsigned int last_present;
+
+static struct stat_counter stat_characters =
+	STAT_COUNTER_INIT("Characters drawn");
+static struct stat_counter stat_scrolls = STAT_COUNTER_INIT("Scrolls");
+static struct stat_histogram stat_flush =
+	STAT_HISTOGRAM_INIT("Console flush", "us");
+
+/* Address of page n of the framebuffer */
+#define FB_PAGE(n)	(screenbase + (n) * pitch * fb_y)
 
 /* Framebuffer initialisation failed. Can't display an error, so flashing
  * the OK LED will have to do
@@ -50,6 +117,43 @@ static void fb_fail(unsigned int num)
 		output(num);
 }
 
+/* Set up the palette for 8bpp, as RGB332 (tag 0x4800b). The firmware wants
+ * each entry as 0x00BBGGRR
+ */
+static void fb_set_palette(void)
+{
+	volatile unsigned int mailbuffer[264] __attribute__((aligned (16)));
+	unsigned int count, rgb;
+
+	mailbuffer[0] = 264 * 4;	// Total size
+	mailbuffer[1] = 0;		// Request
+	mailbuffer[2] = 0x4800b;	// Set palette
+	mailbuffer[3] = 258 * 4;	// Buffer size
+	mailbuffer[4] = 258 * 4;	// Request size
+	mailbuffer[5] = 0;		// First entry
+	mailbuffer[6] = 256;		// Number of entries
+
+	for(count=0; count<256; count++)
+	{
+		rgb = fb_rgb332_palette(count);
+		mailbuffer[7+count] = ((rgb >> 16) & 0xff) | (rgb & 0xff00) |
+			((rgb & 0xff) << 16);
+	}
+
+	mailbuffer[263] = 0;		// End tag
+
+	writemailbox(8, mem_v2p((unsigned int)mailbuffer));
+	readmailbox(8);
+}
+
+/* Use a font, and work out how many characters fit on the screen */
+static void set_font(const struct font *f)
+{
+	font = f;
+	max_x = fastdiv(fb_x, font->div_x_magic, font->div_x_shift);
+	max_y = fastdiv(fb_y, font->div_y_magic, font->div_y_shift);
+}
+
 /* Initialise the framebuffer */
 void fb_init(void)
 {
@@ -67,6 +171,10 @@ void fb_init(void)
 	/* Physical memory address of the mailbuffer, for passing to VC */
 	unsigned int physical_mb = mem_v2p((unsigned int)mailbuffer);
 
+	stat_register_counter(&stat_characters);
+	stat_register_counter(&stat_scrolls);
+	stat_register_histogram(&stat_flush);
+
 	/* Get the display size */
 	mailbuffer[0] = 8 * 4;		// Total size
 	mailbuffer[1] = 0;		// Request
@@ -117,12 +225,19 @@ void fb_init(void)
 	mailbuffer[c++] = 8;		// Value buffer size (bytes)
 	mailbuffer[c++] = 8;		// Req. + value length (bytes)
 	mailbuffer[c++] = fb_x;		// Horizontal resolution
-	mailbuffer[c++] = fb_y;		// Vertical resolution
+	mailbuffer[c++] = fb_y * 2;	// Vertical resolution (two pages)
 
 	mailbuffer[c++] = 0x00048005;	// Tag id (set depth)
 	mailbuffer[c++] = 4;		// Value buffer size (bytes)
 	mailbuffer[c++] = 4;		// Req. + value length (bytes)
-	mailbuffer[c++] = 16;		// 16 bpp
+	mailbuffer[c++] = FB_DEPTH;	// Bits per pixel
+
+#if FB_DEPTH >= 24
+	mailbuffer[c++] = 0x00048006;	// Tag id (set pixel order)
+	mailbuffer[c++] = 4;		// Value buffer size (bytes)
+	mailbuffer[c++] = 4;		// Req. + value length (bytes)
+	mailbuffer[c++] = 0;		// BGR (0xRRGGBB little-endian)
+#endif
 
 	mailbuffer[c++] = 0x00040001;	// Tag id (allocate framebuffer)
 	mailbuffer[c++] = 8;		// Value buffer size (bytes)
@@ -170,18 +285,29 @@ void fb_init(void)
 		fb_fail(FBFAIL_INVALID_TAG_DATA);
 
 	/* physical_screenbase is the address of the screen in RAM
-	 * screenbase needs to be the screen address in virtual memory
+	 * screenbase needs to be the screen address in virtual memory. It is
+	 * only ever written in fb_flush(), so doesn't need to be strongly
+	 * ordered - letting the CPU merge writes into bursts is much faster
 	 */
-	screenbase=mem_p2v(physical_screenbase);
+	screenbase = (unsigned int)mem_map(physical_screenbase & 0x3fffffff,
+		screensize, MEM_NONCACHED);
+	if(screenbase == 0)
+		screenbase = mem_p2v(physical_screenbase);
 
-	/* Get the framebuffer pitch (bytes per line) */
-	mailbuffer[0] = 7 * 4;		// Total size
+	/* Get the framebuffer pitch (bytes per line) and the depth it
+	 * actually has
+	 */
+	mailbuffer[0] = 11 * 4;		// Total size
 	mailbuffer[1] = 0;		// Request
 	mailbuffer[2] = 0x40008;	// Display size
 	mailbuffer[3] = 4;		// Buffer size
 	mailbuffer[4] = 0;		// Request size
 	mailbuffer[5] = 0;		// Space for pitch
-	mailbuffer[6] = 0;		// End tag
+	mailbuffer[6] = 0x40005;	// Depth
+	mailbuffer[7] = 4;		// Buffer size
+	mailbuffer[8] = 0;		// Request size
+	mailbuffer[9] = 0;		// Space for depth
+	mailbuffer[10] = 0;		// End tag
 
 	writemailbox(8, physical_mb);
 
@@ -195,77 +321,812 @@ void fb_init(void)
 	if(pitch == 0)
 		fb_fail(FBFAIL_INVALID_PITCH_DATA);
 
-	/* Need to set up max_x/max_y before using console_write */
-	max_x = fb_x / CHARSIZE_X;
-	max_y = fb_y / CHARSIZE_Y;
-
-	console_write(COLOUR_PUSH BG_BLUE BG_HALF FG_CYAN
-			"Framebuffer initialised. Address = 0x");
-	console_write(tohex(physical_screenbase, sizeof(physical_screenbase)));
-	console_write(" (physical), 0x");
-	console_write(tohex(screenbase, sizeof(screenbase)));
-	console_write(" (virtual), size = 0x");
-	console_write(tohex(screensize, sizeof(screensize)));
-	console_write(", resolution = ");
-	console_write(todec(fb_x, 0));
-	console_write("x");
-	console_write(todec(fb_y, 0));
-	console_write(COLOUR_POP "\n");
-}
-
-/* Current console text cursor position (ie. where the next character will
- * be written
-*/
-static int consx = 0;
-static int consy = 0;
-
-/* Current fg/bg colour */
-static unsigned short int fgcolour = 0xffff;
-static unsigned short int bgcolour = 0;
-
-/* A small stack to allow temporary colour changes in text */
-static unsigned int colour_stack[] = { 0, 0, 0, 0, 0, 0, 0, 0 };
-static unsigned int colour_sp = 8;
-
-/* Move to a new line, and, if at the bottom of the screen, scroll the
- * framebuffer 1 character row upwards, discarding the top row
+	depth = FB_DEPTH;
+	if(mailbuffer[8] == 0x80000004 && mailbuffer[9])
+		depth = mailbuffer[9];
+
+	ops = fb_ops_for_depth(depth);
+	if(ops == 0)
+		fb_fail(FBFAIL_UNSUPPORTED_DEPTH);
+
+	if(depth == 8)
+		fb_set_palette();
+
+	/* Back buffer, starting off blank. If it can't be allocated, draw
+	 * straight onto the screen
+	 */
+	drawbase = (unsigned int)mem_alloc(pitch * fb_y, MEM_CACHED);
+	if(drawbase == 0)
+	{
+		drawbase = screenbase;
+	}
+	else
+	{
+		memclr((void *)drawbase, pitch * fb_y);
+
+		/* Flush with DMA if there's a channel available. It needs
+		 * to be a full channel, for 2D transfers
+		 */
+		flush_dma = dma_channel_alloc(DMA_CHANNEL_FULL);
+
+		/* Double buffering needs a back buffer to draw into, and
+		 * the firmware to have given us both pages
+		 */
+		if(screensize >= 2 * pitch * fb_y)
+			pages = 2;
+	}
+
+	/* Need to set up the font before using console_write. "make
+	 * FB_FONT=name" chooses one; otherwise larger screens get the 8x16
+	 * font, which is easier to read at high resolutions
+	 */
+#ifdef FB_FONT
+	set_font(&FB_FONT);
+#else
+	set_font(fb_x >= 1280 ? &font_8x16 : &font_teletext);
+#endif
+	viewport_init(&console, 0, 0, max_x, max_y, VIEWPORT_SCROLL);
+
+	fb_dirty(0, 0, fb_x, fb_y);
+
+	kprintf(COLOUR_PUSH BG_BLUE BG_HALF FG_CYAN
+		"Framebuffer initialised. Address = 0x%08X (physical), 0x%08X "
+		"(virtual), size = 0x%08X, resolution = %ux%u, %ubpp, back "
+		"buffer at 0x%08X" COLOUR_POP "\n",
+		physical_screenbase, screenbase, screensize, fb_x, fb_y,
+		depth, drawbase);
+}
+
+void fb_get_info(struct fb_info *info)
+{
+	info->base = drawbase;
+	info->screen = FB_PAGE(front);
+	info->size = pitch * fb_y;
+	info->width = fb_x;
+	info->height = fb_y;
+	info->pitch = pitch;
+	info->bpp = depth;
+	info->ops = ops;
+}
+
+unsigned int fb_colour(unsigned int rgb)
+{
+	return ops->colour(rgb);
+}
+
+/* Add an area to a dirty rectangle list. The area is merged into an
+ * existing rectangle if it overlaps or touches one (as consecutive
+ * characters on the console do). If the list is full, it is merged into the
+ * last one
  */
-static void newline()
+static void rect_add(struct fb_rect *list, unsigned int *count,
+	unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
 {
-	unsigned int source;
-	/* Number of bytes in a character row */
-	register unsigned int rowbytes = CHARSIZE_Y * pitch;
+	struct fb_rect *r;
+	unsigned int n;
 
-	consx = 0;
-	if(consy<(max_y-1))
+	for(n=0; n<*count; n++)
 	{
-		consy++;
+		r = &list[n];
+
+		if(x0 <= r->x1 && r->x0 <= x1 && y0 <= r->y1 && r->y0 <= y1)
+			break;
+	}
+
+	if(n == *count)
+	{
+		if(*count < FB_DIRTY_MAX)
+		{
+			r = &list[(*count)++];
+			r->x0 = x0;
+			r->y0 = y0;
+			r->x1 = x1;
+			r->y1 = y1;
+
+			return;
+		}
+
+		r = &list[*count - 1];
+	}
+
+	if(x0 < r->x0)
+		r->x0 = x0;
+	if(y0 < r->y0)
+		r->y0 = y0;
+	if(x1 > r->x1)
+		r->x1 = x1;
+	if(y1 > r->y1)
+		r->y1 = y1;
+}
+
+/* Mark an area of the back buffer as changed */
+void fb_dirty(unsigned int x, unsigned int y, unsigned int width,
+	unsigned int height)
+{
+	unsigned int x1 = x + width;
+	unsigned int y1 = y + height;
+
+	if(x1 > fb_x)
+		x1 = fb_x;
+	if(y1 > fb_y)
+		y1 = fb_y;
+	if(x >= x1 || y >= y1)
+		return;
+
+	rect_add(dirty, &dirty_count, x, y, x1, y1);
+}
+
+/* Copy a list of rectangles from the back buffer to the framebuffer page
+ * at dest
+ *
+ * With DMA, each rectangle is one control block (a 2D copy, or a plain copy
+ * if it covers whole lines) in a chain, and the copy carries on in the
+ * background; the data cache is cleaned first so the DMA engine sees what
+ * the CPU has drawn. Otherwise, the CPU copies each line in bursts
+ */
+static void flush_rects(struct fb_rect *list, unsigned int count,
+	unsigned int dest)
+{
+	struct fb_rect *r;
+	struct dma_cb *cb;
+	unsigned int n, offset, width, line, arm11 = cpu_is_arm11();
+
+	if(flush_dma >= 0)
+	{
+		cb = dma_channel_cbs(flush_dma);
+
+		/* Don't change control blocks the DMA engine is using */
+		dma_wait(flush_dma);
+
+		for(n=0; n<count; n++)
+		{
+			r = &list[n];
+			offset = r->y0 * pitch + r->x0 * ops->bytes;
+			width = (r->x1 - r->x0) * ops->bytes;
+
+			if(width == pitch)
+			{
+				dma_cb_copy(&cb[n], (void *)(dest + offset),
+					(void *)(drawbase + offset),
+					(r->y1 - r->y0) * pitch);
+				if(!arm11)
+					cleancache_lines(drawbase + offset,
+						(r->y1 - r->y0) * pitch);
+			}
+			else
+			{
+				dma_cb_copy2d(&cb[n],
+					(void *)(dest + offset), pitch,
+					(void *)(drawbase + offset), pitch,
+					width, r->y1 - r->y0);
+				if(!arm11)
+					for(line=r->y0; line<r->y1; line++)
+						cleancache_lines(drawbase +
+							offset + (line - r->y0) *
+							pitch, width);
+			}
+
+			if(n)
+				dma_cb_link(&cb[n-1], &cb[n]);
+		}
+
+		/* The DMA engine reads the back buffer from memory. On ARMv7,
+		 * only the lines being copied are cleaned, above; cleancache()
+		 * would be a set/way walk of all of L1 and L2. On the ARM1176
+		 * it's a single operation
+		 */
+		if(arm11)
+			cleancache();
+		dsb();
+
+		dma_start(flush_dma, cb, 0);
+	}
+	else
+	{
+		for(n=0; n<count; n++)
+		{
+			r = &list[n];
+
+			/* Round out to whole words, for memcpy_burst */
+			offset = (r->y0 * pitch + r->x0 * ops->bytes) & ~3;
+			width = ((r->x1 * ops->bytes + 3) & ~3) -
+				((r->x0 * ops->bytes) & ~3);
+
+			for(line=r->y0; line<r->y1; line++)
+			{
+				memcpy_burst((void *)(dest + offset),
+					(void *)(drawbase + offset), width);
+				offset += pitch;
+			}
+		}
+	}
+}
+
+/* Show page on screen (tag 0x48009, set virtual offset), then wait for
+ * the next vsync (tag 0x4800e) so nothing is drawn into the old page while
+ * it is still being displayed. If the firmware doesn't know the vsync tag,
+ * it isn't asked again
+ */
+static void flip(unsigned int page)
+{
+	volatile unsigned int mailbuffer[12] __attribute__((aligned (16)));
+	unsigned int c = 1;
+
+	mailbuffer[c++] = 0;		// Request
+
+	mailbuffer[c++] = 0x00048009;	// Tag id (set virtual offset)
+	mailbuffer[c++] = 8;		// Value buffer size (bytes)
+	mailbuffer[c++] = 8;		// Req. + value length (bytes)
+	mailbuffer[c++] = 0;		// X offset
+	mailbuffer[c++] = page * fb_y;	// Y offset
+
+	if(vsync_supported)
+	{
+		mailbuffer[c++] = 0x0004800e;	// Tag id (wait for vsync)
+		mailbuffer[c++] = 4;		// Value buffer size (bytes)
+		mailbuffer[c++] = 4;		// Req. + value length (bytes)
+		mailbuffer[c++] = 0;
+	}
+
+	mailbuffer[c++] = 0;		// Terminating tag
+	mailbuffer[0] = c * 4;		// Buffer size
+
+	writemailbox(8, mem_v2p((unsigned int)mailbuffer));
+	readmailbox(8);
+
+	/* Firmware sets the top bit of the length on tags it recognises */
+	if(vsync_supported && !(mailbuffer[9] & 0x80000000))
+		vsync_supported = 0;
+	else if(vsync_supported)
+		present_stats.vsyncs++;
+}
+
+/* Make the back buffer visible
+ *
+ * Single buffered, the dirty rectangles are copied straight to the page on
+ * screen. Double buffered, they are copied (along with the previous frame's)
+ * to the hidden page, which is then flipped to at vsync
+ */
+void fb_flush(void)
+{
+	struct fb_rect list[FB_DIRTY_MAX];
+	unsigned int count, n, start, now;
+
+	if(drawbase == screenbase)
+	{
+		dirty_count = 0;
 		return;
 	}
 
-	/* Copy a screen's worth of data (minus 1 character row) from the
-	 * second row to the first
+	if(dirty_count == 0)
+		return;
+
+	start = timer_read();
+
+	if(!double_buffered)
+	{
+		flush_rects(dirty, dirty_count, FB_PAGE(front));
+	}
+	else
+	{
+		/* This frame's changes plus last frame's */
+		count = dirty_count;
+		for(n=0; n<count; n++)
+			list[n] = dirty[n];
+		for(n=0; n<prev_dirty_count; n++)
+			rect_add(list, &count, prev_dirty[n].x0,
+				prev_dirty[n].y0, prev_dirty[n].x1,
+				prev_dirty[n].y1);
+
+		flush_rects(list, count, FB_PAGE(1 - front));
+		fb_wait();
+
+		front = 1 - front;
+		flip(front);
+
+		for(n=0; n<dirty_count; n++)
+			prev_dirty[n] = dirty[n];
+		prev_dirty_count = dirty_count;
+	}
+
+	now = timer_read();
+	trace(TRACE_CONSOLE_FLUSH, dirty_count, now - start);
+	stat_record(&stat_flush, now - start);
+	dirty_count = 0;
+
+	/* Statistics. The first frame time is measured from the previous
+	 * present, so the time spent drawing is included
 	 */
+	present_stats.present_time += now - start;
 
-	/* Calculate the address to copy the screen data from */
-	source = screenbase + rowbytes;
-	memmove((void *)screenbase, (void *)source, (max_y-1)*rowbytes);
+	if(present_stats.presents++)
+	{
+		n = now - last_present;
 
-	/* Clear last line on screen */
-	memclr((void *)(screenbase + (max_y-1)*rowbytes), rowbytes);
+		if(n < present_stats.min_frame || present_stats.presents == 2)
+			present_stats.min_frame = n;
+		if(n > present_stats.max_frame)
+			present_stats.max_frame = n;
+		present_stats.last_frame = n;
+		present_stats.total_frame += n;
+	}
+
+	last_present = now;
 }
 
-/* Write null-terminated text to the console
- * Supports control characters (see framebuffer.h) for colour and newline
+/* Wait for a DMA flush to finish */
+void fb_wait(void)
+{
+	if(flush_dma >= 0)
+		dma_wait(flush_dma);
+}
+
+unsigned int fb_set_double_buffered(unsigned int enable)
+{
+	if(pages < 2)
+		return 0;
+
+	/* Anything which has been drawn but not shown yet goes out in the
+	 * mode it was drawn in
+	 */
+	fb_flush();
+	fb_wait();
+
+	if(enable && !double_buffered)
+	{
+		/* The hidden page could be anything */
+		prev_dirty[0].x0 = 0;
+		prev_dirty[0].y0 = 0;
+		prev_dirty[0].x1 = fb_x;
+		prev_dirty[0].y1 = fb_y;
+		prev_dirty_count = 1;
+	}
+
+	double_buffered = enable ? 1 : 0;
+
+	return 1;
+}
+
+const struct fb_present_stats *fb_get_present_stats(void)
+{
+	return &present_stats;
+}
+
+void fb_reset_present_stats(void)
+{
+	present_stats.presents = 0;
+	present_stats.vsyncs = 0;
+	present_stats.last_frame = 0;
+	present_stats.min_frame = 0;
+	present_stats.max_frame = 0;
+	present_stats.total_frame = 0;
+	present_stats.present_time = 0;
+}
+
+void fb_print_present_stats(void)
+{
+	unsigned int frames = present_stats.presents;
+	unsigned int average;
+
+	/* n presents give n-1 frame times */
+	if(frames < 2)
+	{
+		kprintf("Presents: %u\n", frames);
+		return;
+	}
+
+	average = present_stats.total_frame / (frames - 1);
+
+	kprintf("Presents: %u (%u at vsync), %u per second; frame time "
+		"%uus average, %u-%uus, last %uus; %uus per present\n",
+		frames, present_stats.vsyncs,
+		average ? 1000000 / average : 0, average,
+		present_stats.min_frame, present_stats.max_frame,
+		present_stats.last_frame, present_stats.present_time / frames);
+}
+
+/* Colours for the control codes (1-8 foreground, 17-24 background) */
+static const unsigned int console_colours[] = {
+	0xff0000,	/* Red */
+	0x00ff00,	/* Green */
+	0x0000ff,	/* Blue */
+	0xffff00,	/* Yellow */
+	0xff00ff,	/* Magenta */
+	0x00ffff,	/* Cyan */
+	0xffffff,	/* White */
+	0x000000	/* Black */
+};
+
+/* Half brightness */
+#define HALF_COLOUR(c)	(((c) >> 1) & 0x7f7f7f)
+
+void viewport_init(struct viewport *vp, unsigned int x, unsigned int y,
+	unsigned int width, unsigned int height, unsigned int flags)
+{
+	/* Keep it on the screen */
+	if(x >= max_x)
+		x = max_x - 1;
+	if(y >= max_y)
+		y = max_y - 1;
+	if(width == 0 || width > max_x - x)
+		width = max_x - x;
+	if(height == 0 || height > max_y - y)
+		height = max_y - y;
+
+	vp->x = x;
+	vp->y = y;
+	vp->width = width;
+	vp->height = height;
+	vp->flags = flags;
+	vp->cursor_x = 0;
+	vp->cursor_y = 0;
+	vp->fgcolour = 0xffffff;
+	vp->bgcolour = 0;
+	vp->colour_sp = VIEWPORT_COLOUR_STACK;
+	vp->esc_state = 0;
+	vp->saved_x = 0;
+	vp->saved_y = 0;
+	vp->saved_fgcolour = vp->fgcolour;
+	vp->saved_bgcolour = vp->bgcolour;
+}
+
+/* Address of a character cell in the back buffer */
+static unsigned int cell_address(unsigned int x, unsigned int y)
+{
+	return drawbase + y*font->height*pitch + x*font->width*ops->bytes;
+}
+
+/* Scroll a viewport up 1 character row, discarding the top row, and clear
+ * the bottom row to the background colour. Nothing outside the viewport
+ * is moved
+ *
+ * The scroll happens in the back buffer, so reads come from the cache
+ * rather than the framebuffer. If the viewport is as wide as the screen
+ * its rows are one block of memory, moved in one go; otherwise each line of
+ * pixels is moved separately
  */
-void console_write(char *text)
+static void scroll(struct viewport *vp, unsigned int bgpixel)
+{
+	unsigned int base = cell_address(vp->x, vp->y);
+	unsigned int width = vp->width * font->width;
+	/* Number of pixel lines/bytes in a character row */
+	unsigned int rowlines = font->height;
+	register unsigned int rowbytes = rowlines * pitch;
+	unsigned int lines = (vp->height - 1) * rowlines;
+
+	if(vp->width == max_x)
+		memmove((void *)base, (void *)(base + rowbytes),
+			(vp->height - 1) * rowbytes);
+	else
+		ops->blit(base, pitch, base + rowbytes, pitch, width, lines);
+
+	ops->fill(base + lines * pitch, pitch, width, rowlines, bgpixel);
+
+	fb_dirty(vp->x * font->width, vp->y * font->height, width,
+		vp->height * rowlines);
+	stat_inc(&stat_scrolls);
+}
+
+/* Move to a new line. At the bottom of a scrolling viewport, scroll it;
+ * otherwise go back to the top
+ */
+static void newline(struct viewport *vp, unsigned int bgpixel)
 {
-	volatile unsigned short int *ptr;
+	vp->cursor_x = 0;
+	if(vp->cursor_y < vp->height - 1)
+	{
+		vp->cursor_y++;
+		return;
+	}
+
+	if(vp->flags & VIEWPORT_SCROLL)
+		scroll(vp, bgpixel);
+	else
+		vp->cursor_y = 0;
+}
+
+/* Fill width x height character cells, from x, y in a viewport, with the
+ * background colour
+ */
+static void erase(struct viewport *vp, unsigned int x, unsigned int y,
+	unsigned int width, unsigned int height, unsigned int bgpixel)
+{
+	if(width == 0 || height == 0)
+		return;
+
+	ops->fill(cell_address(vp->x + x, vp->y + y), pitch,
+		width * font->width, height * font->height, bgpixel);
+	fb_dirty((vp->x + x) * font->width, (vp->y + y) * font->height,
+		width * font->width, height * font->height);
+}
+
+void viewport_clear(struct viewport *vp)
+{
+	if(ops == 0)
+		return;
+
+	erase(vp, 0, 0, vp->width, vp->height, ops->colour(vp->bgcolour));
+
+	vp->cursor_x = 0;
+	vp->cursor_y = 0;
+}
 
-	unsigned int row, addr;
-	int col;
+void viewport_goto(struct viewport *vp, unsigned int x, unsigned int y)
+{
+	vp->cursor_x = x < vp->width ? x : vp->width - 1;
+	vp->cursor_y = y < vp->height ? y : vp->height - 1;
+}
+
+/* ANSI/VT100 escape sequences
+ *
+ * ESC 7, ESC 8		Save/restore cursor and colours (DECSC/DECRC)
+ * ESC [ r ; c H	Move the cursor to row r, column c, from 1 (CUP; also f)
+ * ESC [ n A/B/C/D	Move the cursor up/down/right/left n (CUU etc.)
+ * ESC [ n J		Erase: 0 cursor to end, 1 start to cursor, 2 all (ED)
+ * ESC [ n K		Erase in line, the same way (EL)
+ * ESC [ n ; ... m	Colours (SGR): 0 reset, 2 half brightness,
+ *			30-37/90-97 foreground, 40-47/100-107 background,
+ *			39/49 default foreground/background
+ * ESC [ s, ESC [ u	Save/restore cursor, as ESC 7/ESC 8
+ *
+ * Positions are within the viewport. Anything else is read and ignored.
+ * Sequences may be split between writes, as the parser's state is kept in
+ * the viewport
+ */
+#define ESC_NONE	0
+#define ESC_START	1	/* Had ESC */
+#define ESC_CSI		2	/* Had ESC [, reading parameters */
+#define ESC_IGNORE	3	/* Had ESC [ ?, or too many parameters */
+
+/* ANSI colour numbers (black, red, green, yellow, blue, magenta, cyan,
+ * white) to console_colours
+ */
+static const unsigned char ansi_colours[] = { 7, 0, 1, 3, 2, 4, 5, 6 };
+
+/* A parameter, or its default if it's missing or 0 */
+static unsigned int esc_param(struct viewport *vp, unsigned int n,
+	unsigned int def)
+{
+	if(n >= vp->esc_count || vp->esc_params[n] == 0)
+		return def;
+
+	return vp->esc_params[n];
+}
+
+/* Cursor column for erasing. After a character is written in the last
+ * column, the cursor is just past it until the next character wraps
+ */
+static inline unsigned int erase_x(struct viewport *vp)
+{
+	return vp->cursor_x < vp->width ? vp->cursor_x : vp->width - 1;
+}
+
+static void esc_sgr(struct viewport *vp)
+{
+	unsigned int n, p;
+
+	/* No parameters is the same as 0 */
+	if(vp->esc_count == 0)
+		vp->esc_params[vp->esc_count++] = 0;
+
+	for(n=0; n<vp->esc_count; n++)
+	{
+		p = vp->esc_params[n];
+
+		if(p == 0)
+		{
+			vp->fgcolour = 0xffffff;
+			vp->bgcolour = 0;
+		}
+		else if(p == 2)
+			vp->fgcolour = HALF_COLOUR(vp->fgcolour);
+		else if((p >= 30 && p <= 37) || (p >= 90 && p <= 97))
+			vp->fgcolour = console_colours[ansi_colours[p % 10]];
+		else if((p >= 40 && p <= 47) || (p >= 100 && p <= 107))
+			vp->bgcolour = console_colours[ansi_colours[p % 10]];
+		else if(p == 39)
+			vp->fgcolour = 0xffffff;
+		else if(p == 49)
+			vp->bgcolour = 0;
+	}
+}
+
+/* Carry out a complete ESC [ sequence */
+static void esc_csi(struct viewport *vp, unsigned char final)
+{
+	unsigned int n, x, y, bgpixel = ops->colour(vp->bgcolour);
+
+	switch(final)
+	{
+		case 'H': case 'f':
+			viewport_goto(vp, esc_param(vp, 1, 1) - 1,
+				esc_param(vp, 0, 1) - 1);
+			break;
+		case 'A':
+			n = esc_param(vp, 0, 1);
+			vp->cursor_y = n < vp->cursor_y ? vp->cursor_y - n : 0;
+			break;
+		case 'B':
+			viewport_goto(vp, vp->cursor_x,
+				vp->cursor_y + esc_param(vp, 0, 1));
+			break;
+		case 'C':
+			viewport_goto(vp, vp->cursor_x + esc_param(vp, 0, 1),
+				vp->cursor_y);
+			break;
+		case 'D':
+			n = esc_param(vp, 0, 1);
+			x = erase_x(vp);
+			vp->cursor_x = n < x ? x - n : 0;
+			break;
+		case 'J':
+			x = erase_x(vp);
+			y = vp->cursor_y;
+			switch(esc_param(vp, 0, 0))
+			{
+				case 0:
+					erase(vp, x, y, vp->width - x, 1,
+						bgpixel);
+					erase(vp, 0, y + 1, vp->width,
+						vp->height - y - 1, bgpixel);
+					break;
+				case 1:
+					erase(vp, 0, 0, vp->width, y, bgpixel);
+					erase(vp, 0, y, x + 1, 1, bgpixel);
+					break;
+				case 2:
+					erase(vp, 0, 0, vp->width, vp->height,
+						bgpixel);
+					break;
+			}
+			break;
+		case 'K':
+			x = erase_x(vp);
+			y = vp->cursor_y;
+			switch(esc_param(vp, 0, 0))
+			{
+				case 0:
+					erase(vp, x, y, vp->width - x, 1,
+						bgpixel);
+					break;
+				case 1:
+					erase(vp, 0, y, x + 1, 1, bgpixel);
+					break;
+				case 2:
+					erase(vp, 0, y, vp->width, 1, bgpixel);
+					break;
+			}
+			break;
+		case 'm':
+			esc_sgr(vp);
+			break;
+		case 's':
+			vp->saved_x = vp->cursor_x;
+			vp->saved_y = vp->cursor_y;
+			break;
+		case 'u':
+			vp->cursor_x = vp->saved_x;
+			vp->cursor_y = vp->saved_y;
+			break;
+	}
+}
+
+/* Feed text to the escape sequence parser, which has just had an ESC or is
+ * part way through a sequence. Returns the text after the sequence (or the
+ * end of the text, if the sequence isn't finished)
+ */
+static char *escape(struct viewport *vp, char *text)
+{
 	unsigned char ch;
 
+	while((ch = (unsigned char)*text))
+	{
+		text++;
+
+		switch(vp->esc_state)
+		{
+			case ESC_START:
+				vp->esc_state = ESC_NONE;
+
+				if(ch == '[')
+				{
+					vp->esc_state = ESC_CSI;
+					vp->esc_count = 0;
+					vp->esc_params[0] = 0;
+				}
+				else if(ch == '7')
+				{
+					vp->saved_x = vp->cursor_x;
+					vp->saved_y = vp->cursor_y;
+					vp->saved_fgcolour = vp->fgcolour;
+					vp->saved_bgcolour = vp->bgcolour;
+				}
+				else if(ch == '8')
+				{
+					vp->cursor_x = vp->saved_x;
+					vp->cursor_y = vp->saved_y;
+					vp->fgcolour = vp->saved_fgcolour;
+					vp->bgcolour = vp->saved_bgcolour;
+				}
+
+				if(vp->esc_state == ESC_NONE)
+					return text;
+				break;
+
+			case ESC_CSI:
+				if(ch >= '0' && ch <= '9')
+				{
+					/* esc_count is the parameter being
+					 * read, less 1 until a digit is seen
+					 */
+					if(vp->esc_count == 0)
+						vp->esc_count = 1;
+					vp->esc_params[vp->esc_count - 1] =
+						vp->esc_params[vp->esc_count - 1]
+						* 10 + ch - '0';
+					break;
+				}
+
+				if(ch == ';')
+				{
+					if(vp->esc_count == 0)
+						vp->esc_count = 1;
+					if(vp->esc_count == VIEWPORT_ESC_PARAMS)
+					{
+						vp->esc_state = ESC_IGNORE;
+						break;
+					}
+					vp->esc_params[vp->esc_count++] = 0;
+					break;
+				}
+
+				if(ch == '?')
+				{
+					vp->esc_state = ESC_IGNORE;
+					break;
+				}
+
+				/* Fall through - a final character */
+			case ESC_IGNORE:
+				/* Final characters are 0x40-0x7e */
+				if(ch < 0x40 || ch > 0x7e)
+					break;
+
+				if(vp->esc_state == ESC_CSI)
+					esc_csi(vp, ch);
+
+				vp->esc_state = ESC_NONE;
+				return text;
+		}
+	}
+
+	return text;
+}
+
+/* Draw text in a viewport. Handles the control characters (see
+ * framebuffer.h) for colour and newline, and ANSI escape sequences.
+ * Ordinary characters only go through the control code switch - the
+ * escape sequence parser only sees text after an ESC
+ */
+static void draw_text(struct viewport *vp, char *text)
+{
+	unsigned int fgpixel, bgpixel;
+	unsigned char ch;
+
+	/* Colours are converted to pixel values once per call, rather than
+	 * per character
+	 */
+	fgpixel = ops->colour(vp->fgcolour);
+	bgpixel = ops->colour(vp->bgcolour);
+
+	/* Finish a sequence left over from the last write */
+	if(vp->esc_state != ESC_NONE)
+	{
+		text = escape(vp, text);
+		fgpixel = ops->colour(vp->fgcolour);
+		bgpixel = ops->colour(vp->bgcolour);
+	}
+
 	/* Double parentheses to silence compiler warnings about
 	 * assignments as boolean values
 	 */
@@ -276,88 +1137,148 @@ void console_write(char *text)
 		/* Deal with control codes */
 		switch(ch)
 		{
-			case 1: fgcolour = 0b1111100000000000; continue;
-			case 2: fgcolour = 0b0000011111100000; continue;
-			case 3: fgcolour = 0b0000000000011111; continue;
-			case 4: fgcolour = 0b1111111111100000; continue;
-			case 5: fgcolour = 0b1111100000011111; continue;
-			case 6: fgcolour = 0b0000011111111111; continue;
-			case 7: fgcolour = 0b1111111111111111; continue;
-			case 8: fgcolour = 0b0000000000000000; continue;
-				/* Half brightness */
-			case 9: fgcolour = (fgcolour >> 1) & 0b0111101111101111; continue;
-			case 10: newline(); continue;
+			case 1: case 2: case 3: case 4:
+			case 5: case 6: case 7: case 8:
+				vp->fgcolour = console_colours[ch - 1];
+				fgpixel = ops->colour(vp->fgcolour);
+				continue;
+			case 9: /* Half brightness */
+				vp->fgcolour = HALF_COLOUR(vp->fgcolour);
+				fgpixel = ops->colour(vp->fgcolour);
+				continue;
+			case 10: newline(vp, bgpixel); continue;
+			case 13: vp->cursor_x = 0; continue;
 			case 11: /* Colour stack push */
-				if(colour_sp)
-					colour_sp--;
-				colour_stack[colour_sp] =
-					fgcolour | (bgcolour<<16);
+				if(vp->colour_sp)
+					vp->colour_sp--;
+				vp->colour_stack_fg[vp->colour_sp] = vp->fgcolour;
+				vp->colour_stack_bg[vp->colour_sp] = vp->bgcolour;
 				continue;
 			case 12: /* Colour stack pop */
-				fgcolour = colour_stack[colour_sp] & 0xffff;
-				bgcolour = colour_stack[colour_sp] >> 16;
-				if(colour_sp<8)
-					colour_sp++;
+				if(vp->colour_sp == VIEWPORT_COLOUR_STACK)
+					continue;
+				vp->fgcolour = vp->colour_stack_fg[vp->colour_sp];
+				vp->bgcolour = vp->colour_stack_bg[vp->colour_sp];
+				fgpixel = ops->colour(vp->fgcolour);
+				bgpixel = ops->colour(vp->bgcolour);
+				vp->colour_sp++;
+				continue;
+			case 17: case 18: case 19: case 20:
+			case 21: case 22: case 23: case 24:
+				vp->bgcolour = console_colours[ch - 17];
+				bgpixel = ops->colour(vp->bgcolour);
+				continue;
+			case 25: /* Half brightness */
+				vp->bgcolour = HALF_COLOUR(vp->bgcolour);
+				bgpixel = ops->colour(vp->bgcolour);
+				continue;
+			case 27: /* Escape sequence */
+				vp->esc_state = ESC_START;
+				text = escape(vp, text);
+				fgpixel = ops->colour(vp->fgcolour);
+				bgpixel = ops->colour(vp->bgcolour);
 				continue;
-			case 17: bgcolour = 0b1111100000000000; continue;
-			case 18: bgcolour = 0b0000011111100000; continue;
-			case 19: bgcolour = 0b0000000000011111; continue;
-			case 20: bgcolour = 0b1111111111100000; continue;
-			case 21: bgcolour = 0b1111100000011111; continue;
-			case 22: bgcolour = 0b0000011111111111; continue;
-			case 23: bgcolour = 0b1111111111111111; continue;
-			case 24: bgcolour = 0b0000000000000000; continue;
-				/* Half brightness */
-			case 25: bgcolour = (bgcolour >> 1) & 0b0111101111101111; continue;
 		}
 
-		/* Unknown control codes, and anything >127, get turned into
-		 * spaces. Anything >=32 <=127 gets 32 subtracted from it to
-		 * turn it into a value between 0 and 95, to index into the
-		 * character definitions table
+		/* Unknown control codes get turned into spaces. Characters
+		 * the font doesn't have are drawn as its default character
 		 */
 		if(ch<32)
-		{
-			ch=0;
-		}
-		else
-		{
-			if(ch>127)
-				ch=0;
-			else
-				ch-=32;
-		}
+			ch=' ';
 
-		/* Plot character onto screen
-		 *
-		 * CHARSIZE_Y and CHARSIZE_X are the size of the block the
-		 * character occupies. The character itself is one pixel
-		 * smaller in each direction, and is located in the upper left
-		 * of the block
+		/* Wrap if the last character went in the last column. This
+		 * happens here, rather than straight after that character,
+		 * so that a line which fills the width followed by a newline
+		 * doesn't leave a blank line, and text can go right up to
+		 * the bottom right corner without scrolling
 		 */
-		for(row=0; row<CHARSIZE_Y; row++)
-		{
-			addr = (row+consy*CHARSIZE_Y)*pitch + consx*CHARSIZE_X*2;
+		if(vp->cursor_x >= vp->width)
+			newline(vp, bgpixel);
 
-			for(col=(CHARSIZE_X-2); col>=0; col--)
-			{
-				ptr = (unsigned short int *)(screenbase+addr);
+		/* Plot character onto screen. The font's glyph rows are in
+		 * the format the glyph kernel takes, so they're drawn
+		 * straight from the font
+		 */
+		ops->glyph(cell_address(vp->x + vp->cursor_x,
+			vp->y + vp->cursor_y), pitch, font_glyph(font, ch),
+			font->width, font->height, fgpixel, bgpixel);
 
-				addr+=2;
+		fb_dirty((vp->x + vp->cursor_x) * font->width,
+			(vp->y + vp->cursor_y) * font->height, font->width,
+			font->height);
+		stat_inc(&stat_characters);
 
-				if(row<(CHARSIZE_Y-1) && (teletext[ch][row] & (1<<col)))
-					*ptr = fgcolour;
-				else
-					*ptr = bgcolour;
-			}
+		vp->cursor_x++;
+	}
+}
 
-			ptr = (unsigned short int *)(screenbase+addr);
-			*ptr = bgcolour;
-		}
+/* Write null-terminated text to a viewport. The screen is updated
+ * (fb_flush) before returning, unless double buffering is on
+ */
+void viewport_write(struct viewport *vp, char *text)
+{
+	/* Nothing to draw on until fb_init() has run */
+	if(ops == 0)
+		return;
 
-		if(++consx >=max_x)
-		{
-			newline();
-		}
-	}
+	/* The viewport's cursor, colours and escape sequence state, and the
+	 * back buffer, are shared by every thread that writes
+	 */
+	thread_preempt_off();
+
+	draw_text(vp, text);
+
+	/* In double buffered mode, the caller decides when a frame is
+	 * finished
+	 */
+	if(!double_buffered)
+		fb_flush();
+
+	thread_preempt_on();
+}
+
+struct viewport *console_viewport(void)
+{
+	return &console;
+}
+
+void console_get_size(unsigned int *columns, unsigned int *rows)
+{
+	*columns = max_x;
+	*rows = max_y;
+}
+
+/* Change the console font. The screen is cleared, as the character grid
+ * changes, and the console viewport covers all of it again
+ */
+void console_set_font(const struct font *f)
+{
+	if(ops == 0)
+		return;
+
+	set_font(f);
+	console.x = 0;
+	console.y = 0;
+	console.width = max_x;
+	console.height = max_y;
+	console.cursor_x = 0;
+	console.cursor_y = 0;
+
+	memclr((void *)drawbase, pitch * fb_y);
+	fb_dirty(0, 0, fb_x, fb_y);
+
+	if(!double_buffered)
+		fb_flush();
+}
+
+/* Write null-terminated text to the console viewport
+ * Supports control characters (see framebuffer.h) for colour and newline
+ * The text is also sent to the serial port, and the screen is updated
+ * (fb_flush) before returning, unless double buffering is on
+ */
+void console_write(char *text)
+{
+	uart_write(text);
+
+	viewport_write(&console, text);
 }
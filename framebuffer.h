@@ -1,9 +1,131 @@
 #ifndef FRAMEBUFFER_H
 #define FRAMEBUFFER_H
 
+#include "fbops.h"
+#include "font.h"
+
 extern void fb_init(void);
 extern void console_write(char *text);
 
+/* Change the console font (see font.h), clearing the screen */
+extern void console_set_font(const struct font *f);
+
+/* Text viewports
+ *
+ * A viewport is a rectangle of character cells with its own cursor,
+ * colours and colour stack. Text wraps at its right edge, and at the
+ * bottom a VIEWPORT_SCROLL viewport scrolls - moving only its own rows -
+ * while any other goes back to the top line. So a status line can be
+ * rewritten in place while a log scrolls underneath it
+ *
+ * As well as the control characters below, viewports understand carriage
+ * return and the common ANSI/VT100 escape sequences for moving the cursor,
+ * erasing and colours (see framebuffer.c), with positions relative to the
+ * viewport. So a field can be overwritten in place
+ *
+ * console_write() writes to the console viewport, which covers the whole
+ * screen unless it is set up again with viewport_init(). Changing the font
+ * resets it to the whole screen; other viewports need setting up again
+ */
+#define VIEWPORT_COLOUR_STACK	8
+/* Most parameters in an escape sequence */
+#define VIEWPORT_ESC_PARAMS	4
+
+/* Flags */
+#define VIEWPORT_SCROLL		1
+
+struct viewport
+{
+	unsigned int x, y;		/* Top left character cell */
+	unsigned int width, height;	/* In characters */
+	unsigned int flags;
+	unsigned int cursor_x, cursor_y;	/* Within the viewport */
+	unsigned int fgcolour, bgcolour;	/* 0xRRGGBB */
+	unsigned int colour_stack_fg[VIEWPORT_COLOUR_STACK];
+	unsigned int colour_stack_bg[VIEWPORT_COLOUR_STACK];
+	unsigned int colour_sp;
+
+	/* ANSI escape sequence parser (see framebuffer.c) */
+	unsigned int esc_state;
+	unsigned int esc_params[VIEWPORT_ESC_PARAMS];
+	unsigned int esc_count;
+	unsigned int saved_x, saved_y;
+	unsigned int saved_fgcolour, saved_bgcolour;
+};
+
+/* Set up a viewport (in character cells, clipped to the screen; a width or
+ * height of 0 means up to the edge), with the cursor at the top left and
+ * white text on black. Doesn't draw anything - see viewport_clear()
+ */
+extern void viewport_init(struct viewport *vp, unsigned int x,
+	unsigned int y, unsigned int width, unsigned int height,
+	unsigned int flags);
+/* Fill with the background colour, and move the cursor to the top left */
+extern void viewport_clear(struct viewport *vp);
+/* Move the cursor, within the viewport */
+extern void viewport_goto(struct viewport *vp, unsigned int x, unsigned int y);
+/* As console_write(), but not copied to the serial port */
+extern void viewport_write(struct viewport *vp, char *text);
+
+extern struct viewport *console_viewport(void);
+/* Screen size in characters, for the current font */
+extern void console_get_size(unsigned int *columns, unsigned int *rows);
+
+/* Framebuffer details, for code which draws on it directly. Drawing goes
+ * into the back buffer at base; the screen is only updated by fb_flush()
+ */
+struct fb_info
+{
+	unsigned int base;	/* Back buffer virtual address */
+	unsigned int screen;	/* Framebuffer virtual address */
+	unsigned int size;	/* Bytes */
+	unsigned int width;	/* Pixels */
+	unsigned int height;
+	unsigned int pitch;	/* Bytes per line */
+	unsigned int bpp;
+	const struct fb_ops *ops;	/* Pixel kernels for the depth */
+};
+
+extern void fb_get_info(struct fb_info *info);
+
+/* Convert 0xRRGGBB to a pixel value for the screen's depth */
+extern unsigned int fb_colour(unsigned int rgb);
+
+/* Mark an area (in pixels) of the back buffer as changed */
+extern void fb_dirty(unsigned int x, unsigned int y, unsigned int width,
+	unsigned int height);
+/* Copy changed areas of the back buffer to the screen. Single buffered,
+ * this may finish in the background; fb_wait() waits for it. Double
+ * buffered, this presents a frame: the hidden page is updated, then
+ * displayed at the next vsync
+ */
+extern void fb_flush(void);
+extern void fb_wait(void);
+
+/* Turn double buffering on or off. While it is on, console_write() doesn't
+ * update the screen - call fb_flush() once a frame is complete. Returns 0
+ * if double buffering isn't available
+ */
+extern unsigned int fb_set_double_buffered(unsigned int enable);
+
+/* fb_flush() statistics. Times are in microseconds; a frame is the time
+ * from one present to the next
+ */
+struct fb_present_stats
+{
+	unsigned int presents;
+	unsigned int vsyncs;		/* Presents which waited for vsync */
+	unsigned int last_frame;
+	unsigned int min_frame;
+	unsigned int max_frame;
+	unsigned int total_frame;	/* For the average */
+	unsigned int present_time;	/* Total time spent in fb_flush() */
+};
+
+extern const struct fb_present_stats *fb_get_present_stats(void);
+extern void fb_reset_present_stats(void);
+extern void fb_print_present_stats(void);
+
 /* Control characters for the console */
 #define FG_RED "\001"
 #define FG_GREEN "\002"
@@ -0,0 +1,247 @@
+/* 2D drawing primitives
+ *
+ * Clipping and dirty rectangles are dealt with here; the pixels are drawn
+ * by the kernels for the screen's depth (fbops.c), so each primitive costs
+ * one indirect call rather than one per pixel. Horizontal and vertical
+ * lines go to the span kernels, and filled rectangles to the word-burst
+ * fill
+ */
+
+#include "gfx.h"
+
+#include "framebuffer.h"
+
+/* Where drawing goes, and whether it's the screen */
+static struct fb_info target;
+static unsigned int on_screen = 0;
+
+/* Address of pixel x, y in the target */
+#define PIXEL(x, y)	(target.base + (y) * target.pitch + \
+			(x) * target.ops->bytes)
+
+void gfx_init(void)
+{
+	fb_get_info(&target);
+	on_screen = 1;
+}
+
+void gfx_target(unsigned int base, unsigned int pitch, unsigned int width,
+	unsigned int height)
+{
+	fb_get_info(&target);
+
+	target.base = base;
+	target.pitch = pitch;
+	target.width = width;
+	target.height = height;
+	on_screen = 0;
+}
+
+/* Clip a rectangle to the target. Returns 0 if none of it is left */
+static unsigned int clip(int *x, int *y, int *width, int *height)
+{
+	int x1 = *x + *width;
+	int y1 = *y + *height;
+
+	if(*x < 0)
+		*x = 0;
+	if(*y < 0)
+		*y = 0;
+	if(x1 > (int)target.width)
+		x1 = target.width;
+	if(y1 > (int)target.height)
+		y1 = target.height;
+
+	if(*x >= x1 || *y >= y1)
+		return 0;
+
+	*width = x1 - *x;
+	*height = y1 - *y;
+
+	return 1;
+}
+
+static inline void dirty(int x, int y, int width, int height)
+{
+	if(on_screen)
+		fb_dirty(x, y, width, height);
+}
+
+void gfx_fill_rect(int x, int y, int width, int height, unsigned int colour)
+{
+	if(!clip(&x, &y, &width, &height))
+		return;
+
+	target.ops->fill(PIXEL(x, y), target.pitch, width, height, colour);
+	dirty(x, y, width, height);
+}
+
+void gfx_hline(int x, int y, int width, unsigned int colour)
+{
+	int height = 1;
+
+	if(!clip(&x, &y, &width, &height))
+		return;
+
+	target.ops->span(PIXEL(x, y), width, colour);
+	dirty(x, y, width, 1);
+}
+
+void gfx_vline(int x, int y, int height, unsigned int colour)
+{
+	int width = 1;
+
+	if(!clip(&x, &y, &width, &height))
+		return;
+
+	target.ops->vspan(PIXEL(x, y), target.pitch, height, colour);
+	dirty(x, y, 1, height);
+}
+
+void gfx_rect(int x, int y, int width, int height, unsigned int colour)
+{
+	if(width <= 0 || height <= 0)
+		return;
+
+	gfx_hline(x, y, width, colour);
+	if(height > 1)
+		gfx_hline(x, y + height - 1, width, colour);
+
+	if(height > 2)
+	{
+		gfx_vline(x, y + 1, height - 2, colour);
+		if(width > 1)
+			gfx_vline(x + width - 1, y + 1, height - 2, colour);
+	}
+}
+
+/* Is a point inside the target? */
+#define INSIDE(x, y)	((unsigned int)(x) < target.width && \
+			(unsigned int)(y) < target.height)
+
+/* Bresenham's line algorithm
+ *
+ * Horizontal and vertical lines are spans. Lines entirely inside the target
+ * are drawn by the line kernel, working in addresses: one step along the
+ * major (longer) axis per pixel, plus a step along the minor axis whenever
+ * the error term runs out. Anything else is drawn a pixel at a time,
+ * skipping the pixels outside the target
+ */
+void gfx_line(int x0, int y0, int x1, int y1, unsigned int colour)
+{
+	int dx, dy, sx, sy, error, left, top;
+	int bytes = target.ops->bytes;
+
+	if(y0 == y1)
+	{
+		gfx_hline(x0 < x1 ? x0 : x1, y0,
+			(x0 < x1 ? x1 - x0 : x0 - x1) + 1, colour);
+		return;
+	}
+
+	if(x0 == x1)
+	{
+		gfx_vline(x0, y0 < y1 ? y0 : y1,
+			(y0 < y1 ? y1 - y0 : y0 - y1) + 1, colour);
+		return;
+	}
+
+	dx = x1 > x0 ? x1 - x0 : x0 - x1;
+	dy = y1 > y0 ? y1 - y0 : y0 - y1;
+	sx = x1 > x0 ? 1 : -1;
+	sy = y1 > y0 ? 1 : -1;
+
+	/* The bounding box, before the clipped loop below moves x0 and y0 */
+	left = x1 < x0 ? x1 : x0;
+	top = y1 < y0 ? y1 : y0;
+
+	if(INSIDE(x0, y0) && INSIDE(x1, y1))
+	{
+		if(dx >= dy)
+			target.ops->line(PIXEL(x0, y0), sx * bytes,
+				sy * (int)target.pitch, dx, dx, dy, colour);
+		else
+			target.ops->line(PIXEL(x0, y0), sy * (int)target.pitch,
+				sx * bytes, dy, dy, dx, colour);
+	}
+	else
+	{
+		/* Same algorithm, in coordinates */
+		error = (dx >= dy ? dx : dy) >> 1;
+
+		while(1)
+		{
+			if(INSIDE(x0, y0))
+				target.ops->plot(PIXEL(x0, y0), colour);
+
+			if(dx >= dy)
+			{
+				if(x0 == x1)
+					break;
+				x0 += sx;
+				error -= dy;
+				if(error < 0)
+				{
+					y0 += sy;
+					error += dx;
+				}
+			}
+			else
+			{
+				if(y0 == y1)
+					break;
+				y0 += sy;
+				error -= dx;
+				if(error < 0)
+				{
+					x0 += sx;
+					error += dy;
+				}
+			}
+		}
+	}
+
+	dx++;
+	dy++;
+	if(clip(&left, &top, &dx, &dy))
+		dirty(left, top, dx, dy);
+}
+
+/* Clip a blit, moving the source on by however much was cut off the top
+ * and left. Returns 0 if nothing is left to draw
+ */
+static unsigned int clip_blit(int *x, int *y, const void **src,
+	unsigned int src_pitch, int *width, int *height)
+{
+	int ox = *x, oy = *y;
+
+	if(!clip(x, y, width, height))
+		return 0;
+
+	*src = (const unsigned char *)*src + (*y - oy) * src_pitch +
+		(*x - ox) * target.ops->bytes;
+
+	return 1;
+}
+
+void gfx_blit(int x, int y, const void *src, unsigned int src_pitch,
+	int width, int height)
+{
+	if(!clip_blit(&x, &y, &src, src_pitch, &width, &height))
+		return;
+
+	target.ops->blit(PIXEL(x, y), target.pitch, (unsigned int)src,
+		src_pitch, width, height);
+	dirty(x, y, width, height);
+}
+
+void gfx_blit_key(int x, int y, const void *src, unsigned int src_pitch,
+	int width, int height, unsigned int key)
+{
+	if(!clip_blit(&x, &y, &src, src_pitch, &width, &height))
+		return;
+
+	target.ops->blit_key(PIXEL(x, y), target.pitch, (unsigned int)src,
+		src_pitch, width, height, key);
+	dirty(x, y, width, height);
+}
@@ -0,0 +1,66 @@
+#ifndef GFX_H
+#define GFX_H
+
+/* 2D drawing
+ *
+ * Drawing goes into a target surface - normally the framebuffer's back
+ * buffer, where the areas drawn are marked as dirty and appear on screen at
+ * the next fb_flush(). Coordinates are in pixels, and everything is clipped
+ * to the target. Colours are pixel values, from fb_colour()
+ */
+
+/* Draw on the screen (the back buffer) */
+extern void gfx_init(void);
+
+/* Draw somewhere else: an off-screen area of width x height pixels, pitch
+ * bytes per line, in the screen's pixel format. Use gfx_init() to go back
+ * to the screen
+ */
+extern void gfx_target(unsigned int base, unsigned int pitch,
+	unsigned int width, unsigned int height);
+
+extern void gfx_fill_rect(int x, int y, int width, int height,
+	unsigned int colour);
+/* Outline of a rectangle, 1 pixel wide */
+extern void gfx_rect(int x, int y, int width, int height, unsigned int colour);
+extern void gfx_hline(int x, int y, int width, unsigned int colour);
+extern void gfx_vline(int x, int y, int height, unsigned int colour);
+extern void gfx_line(int x0, int y0, int x1, int y1, unsigned int colour);
+
+/* Copy width x height pixels (in the screen's pixel format) from src, which
+ * has src_pitch bytes per line. gfx_blit_key skips source pixels which are
+ * the colour key
+ */
+extern void gfx_blit(int x, int y, const void *src, unsigned int src_pitch,
+	int width, int height);
+extern void gfx_blit_key(int x, int y, const void *src,
+	unsigned int src_pitch, int width, int height, unsigned int key);
+
+/* RGB565 pack/unpack. Unpacking repeats the top bits of each component into
+ * the bottom ones, so white stays white
+ */
+static inline unsigned int gfx_rgb565(unsigned int r, unsigned int g,
+	unsigned int b)
+{
+	return ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+}
+
+static inline unsigned int gfx_rgb565_to_rgb(unsigned int c)
+{
+	unsigned int r = (c >> 11) & 0x1f;
+	unsigned int g = (c >> 5) & 0x3f;
+	unsigned int b = c & 0x1f;
+
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+
+	return (r << 16) | (g << 8) | b;
+}
+
+static inline unsigned int gfx_rgb_to_rgb565(unsigned int rgb)
+{
+	return gfx_rgb565(rgb >> 16, (rgb >> 8) & 0xff, rgb & 0xff);
+}
+
+#endif	/* GFX_H */
@@ -0,0 +1,500 @@
+/* Micro-benchmarks of the kernel's rendering and utility code, run on the
+ * build machine ("make host-bench"; see host.h)
+ *
+ * Each benchmark prints the host cycles per iteration and a checksum of
+ * what it produced (usually the whole screen). Everything is deterministic,
+ * so the checksums only change when the output does, and they're compared
+ * with known-good ones (bench_expected[]). Before the benchmarks, a few
+ * unit checks test memclr(), memmove(), ksnprintf() and fastdiv.h against
+ * the obvious answers. Any mismatch is a failure, and the exit status is
+ * 1, so "make host-bench" fails
+ *
+ * Options: -v copies console output to stdout, as the kernel does to the
+ * serial port, and -s WIDTHxHEIGHT sets the screen size (1280x720 unless
+ * given). "make host FB_DEPTH=n FB_FONT=name" works as it does for the
+ * kernel
+ */
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atags.h"
+#include "fastdiv.h"
+#include "framebuffer.h"
+#include "kprintf.h"
+#include "memory.h"
+#include "memutils.h"
+#include "textutils.h"
+
+/* Physical address of the ATAGs, as the firmware leaves them */
+#define BENCH_ATAGS	0x100
+
+/* Size of the memory utility buffers, and iterations of the short loops */
+#define BENCH_COPY_SIZE	(1 << 20)
+#define BENCH_LOOPS	4096
+/* Lines of console output for the text benchmarks */
+#define BENCH_LINES	512
+/* Default screen size */
+#define BENCH_WIDTH	1280
+#define BENCH_HEIGHT	720
+
+static unsigned long long bench_start_time;
+
+/* Checks and checksums that didn't match */
+static unsigned int bench_failures;
+
+/* Set if the screen is the size, depth and font bench_expected[]'s screen
+ * checksums were taken at
+ */
+static unsigned int bench_default_screen;
+
+/* Known-good checksums. The memory and text ones were worked out
+ * independently, and the screens checked by eye. Those with screen set
+ * depend on the screen size, depth and font, so are only compared at the
+ * defaults (BENCH_WIDTH x BENCH_HEIGHT, 16 bits, and the font
+ * framebuffer.c picks for that)
+ */
+static const struct
+{
+	const char *name;
+	unsigned int checksum;
+	unsigned int screen;
+} bench_expected[] = {
+	{ "memmove 1M",			0xf39c9dc5, 0 },
+	{ "memmove 1M, overlapping",	0xe2153905, 0 },
+	{ "memcpy_burst 1M",		0xf39c9dc5, 0 },
+	{ "memfill32 1M",		0x161c9dc5, 0 },
+	{ "memclr 1M, unaligned",	0x905cb3c7, 0 },
+	{ "decdigits",			0x05b3d989, 0 },
+	{ "hexdigits",			0x13e92869, 0 },
+	{ "print_atags",		0x6849b693, 1 },
+	{ "Console lines",		0xa88d08d9, 1 },
+	{ "Console lines, colour",	0x711d4999, 1 },
+	{ "Full screen flush",		0x711d4999, 1 },
+	{ "Console clear",		0xee731dc5, 1 },
+};
+
+static void bench_start(void)
+{
+	bench_start_time = __builtin_ia32_rdtsc();
+}
+
+/* Host cycles per iteration since bench_start() */
+static unsigned long long bench_stop(unsigned int loops)
+{
+	return (__builtin_ia32_rdtsc() - bench_start_time) / loops;
+}
+
+static void bench_result(const char *name, unsigned long long cycles,
+	unsigned int checksum)
+{
+	unsigned int n;
+
+	printf("  %-24s %12llu cycles  %08x\n", name, cycles, checksum);
+
+	for(n=0; n<sizeof(bench_expected) / sizeof(bench_expected[0]); n++)
+	{
+		if(strcmp(bench_expected[n].name, name) != 0 ||
+			(bench_expected[n].screen && !bench_default_screen))
+			continue;
+
+		if(checksum != bench_expected[n].checksum)
+		{
+			printf("  FAIL: should be %08x\n",
+				bench_expected[n].checksum);
+			bench_failures++;
+		}
+	}
+}
+
+static void check(const char *what, unsigned int ok)
+{
+	printf("  %-50s %s\n", what, ok ? "ok" : "FAIL");
+	if(!ok)
+		bench_failures++;
+}
+
+/* 32 bit FNV-1a */
+static unsigned int bench_checksum(const void *data, unsigned int size)
+{
+	const unsigned char *p = data;
+	unsigned int hash = 2166136261u;
+
+	while(size--)
+		hash = (hash ^ *p++) * 16777619;
+
+	return hash;
+}
+
+/* Get everything drawn onto the screen */
+static void bench_flush(void)
+{
+	fb_flush();
+	fb_wait();
+}
+
+static unsigned int bench_screen(void)
+{
+	struct fb_info fb;
+
+	fb_get_info(&fb);
+
+	return bench_checksum((void *)fb.screen, fb.size);
+}
+
+/* Same numbers every run (Numerical Recipes LCG) */
+static unsigned int bench_seed;
+
+static unsigned int bench_random(void)
+{
+	bench_seed = bench_seed * 1664525 + 1013904223;
+	return bench_seed;
+}
+
+/* Every start alignment and length up to 32, with guard bytes either side */
+static void check_memclr(void)
+{
+	unsigned char buffer[48];
+	unsigned int offset, length, n, ok = 1;
+
+	for(offset=0; offset<8; offset++)
+	{
+		for(length=0; length<=32; length++)
+		{
+			for(n=0; n<sizeof(buffer); n++)
+				buffer[n] = 0xaa;
+
+			memclr(buffer + offset, length);
+
+			for(n=0; n<sizeof(buffer); n++)
+				if(buffer[n] != (n >= offset &&
+					n < offset + length ? 0 : 0xaa))
+					ok = 0;
+		}
+	}
+
+	check("memclr, every alignment and length to 32", ok);
+}
+
+/* Every pair of offsets up to 16 apart, both ways, against a copy made
+ * through a separate buffer
+ */
+static void check_memmove(void)
+{
+	unsigned char buffer[96], expected[96], copy[64];
+	unsigned int src, dest, length, n, ok = 1;
+
+	for(src=0; src<16; src++)
+	{
+		for(dest=0; dest<16; dest++)
+		{
+			for(length=0; length<=64; length++)
+			{
+				for(n=0; n<sizeof(buffer); n++)
+					buffer[n] = expected[n] = n;
+				for(n=0; n<length; n++)
+					copy[n] = expected[src + n];
+				for(n=0; n<length; n++)
+					expected[dest + n] = copy[n];
+
+				if(memmove(buffer + dest, buffer + src,
+					length) != buffer + dest)
+					ok = 0;
+
+				for(n=0; n<sizeof(buffer); n++)
+					if(buffer[n] != expected[n])
+						ok = 0;
+			}
+		}
+	}
+
+	check("memmove, overlapping both ways", ok);
+}
+
+/* One ksnprintf() conversion, which should produce expected */
+static unsigned int check_format(const char *expected, const char *format,
+	...)
+{
+	char buffer[64];
+	va_list args;
+	int length;
+
+	va_start(args, format);
+	length = kvsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	if(strcmp(buffer, expected) == 0 && length == (int)strlen(expected))
+		return 1;
+
+	printf("    \"%s\" gave \"%s\" (%d), not \"%s\"\n", format,
+		buffer, length, expected);
+	return 0;
+}
+
+static void check_ksnprintf(void)
+{
+	char buffer[8];
+	unsigned int ok = 1;
+
+	ok &= check_format("0 4294967295", "%u %u", 0, 0xffffffff);
+	ok &= check_format("-42 -2147483648", "%d %i", -42, 0x80000000);
+	ok &= check_format("00ff DEADBEEF", "%04x %X", 0xff, 0xdeadbeef);
+	ok &= check_format("-0012|  7|7  |", "%05d|%3u|%-3u|", -12, 7, 7);
+	ok &= check_format("ab   |  hi|(null)", "%-5s|%*s|%s", "ab", 4, "hi",
+		(char *)0);
+	ok &= check_format("[c] 100%", "[%c] %u%%", 'c', 100);
+	ok &= check_format("0x0000ABCD", "%p", (void *)0xabcd);
+
+	/* Truncated, but the length is still the full output's */
+	ok &= ksnprintf(buffer, 5, "%s", "hello world") == 11 &&
+		strcmp(buffer, "hell") == 0;
+	buffer[0] = 'x';
+	ok &= ksnprintf(buffer, 0, "%u", 12345) == 5 && buffer[0] == 'x';
+
+	check("ksnprintf conversions and truncation", ok);
+}
+
+/* Against real division, for the edges and a million random values */
+static void check_fastdiv(void)
+{
+	unsigned int n, x, ok = 1;
+
+	bench_seed = 1;
+	for(n=0; n<1000000; n++)
+	{
+		if(n < 1000)
+			x = n;
+		else if(n < 2000)
+			x = 0xffffffff - (n - 1000);
+		else
+			x = bench_random();
+
+		if(udiv10(x) != x / 10 || udiv100(x) != x / 100 ||
+			udiv1000(x) != x / 1000 ||
+			udiv1000000(x) != x / 1000000 ||
+			UDIV_CONST(x, 3, 1) != x / 3 ||
+			UDIV_CONST(x, 5, 2) != x / 5 ||
+			UDIV_CONST(x, 6, 2) != x / 6 ||
+			UDIV_CONST(x, 12, 3) != x / 12 ||
+			UDIV_CONST(x, 10000, 13) != x / 10000)
+			ok = 0;
+	}
+
+	check("fastdiv, every divisor in the table", ok);
+}
+
+static void bench_memutils(void)
+{
+	unsigned char *src = mem_alloc(BENCH_COPY_SIZE * 2, MEM_CACHED);
+	unsigned char *dest = src + BENCH_COPY_SIZE;
+	unsigned long long cycles;
+	unsigned int count;
+
+	bench_seed = 0;
+	for(count=0; count<BENCH_COPY_SIZE; count++)
+		src[count] = bench_random();
+
+	bench_start();
+	for(count=0; count<16; count++)
+		memmove(dest, src, BENCH_COPY_SIZE);
+	cycles = bench_stop(16);
+	bench_result("memmove 1M", cycles,
+		bench_checksum(dest, BENCH_COPY_SIZE));
+
+	/* Overlapping, so it has to work backwards */
+	bench_start();
+	for(count=0; count<16; count++)
+		memmove(dest + 4, dest, BENCH_COPY_SIZE - 4);
+	cycles = bench_stop(16);
+	bench_result("memmove 1M, overlapping", cycles,
+		bench_checksum(dest, BENCH_COPY_SIZE));
+
+	bench_start();
+	for(count=0; count<16; count++)
+		memcpy_burst(dest, src, BENCH_COPY_SIZE);
+	cycles = bench_stop(16);
+	bench_result("memcpy_burst 1M", cycles,
+		bench_checksum(dest, BENCH_COPY_SIZE));
+
+	bench_start();
+	for(count=0; count<16; count++)
+		memfill32(dest, 0x12345678, BENCH_COPY_SIZE / 4);
+	cycles = bench_stop(16);
+	bench_result("memfill32 1M", cycles,
+		bench_checksum(dest, BENCH_COPY_SIZE));
+
+	bench_start();
+	for(count=0; count<16; count++)
+		memclr(dest + 1, BENCH_COPY_SIZE - 2);
+	cycles = bench_stop(16);
+	bench_result("memclr 1M, unaligned", cycles,
+		bench_checksum(dest, BENCH_COPY_SIZE));
+}
+
+static void bench_textutils(void)
+{
+	unsigned long long cycles;
+	char buffer[12], *p;
+	unsigned int count, checksum = 0;
+
+	bench_seed = 1;
+	bench_start();
+	for(count=0; count<BENCH_LOOPS; count++)
+	{
+		p = decdigits(buffer + 10, bench_random() >> (count & 31));
+		checksum += bench_checksum(p, buffer + 10 - p);
+	}
+	cycles = bench_stop(BENCH_LOOPS);
+	bench_result("decdigits", cycles, checksum);
+
+	checksum = 0;
+	bench_start();
+	for(count=0; count<BENCH_LOOPS; count++)
+	{
+		p = hexdigits(buffer + 8, bench_random(), count & 7, count & 1);
+		checksum += bench_checksum(p, buffer + 8 - p);
+	}
+	cycles = bench_stop(BENCH_LOOPS);
+	bench_result("hexdigits", cycles, checksum);
+}
+
+/* A typical set of ATAGs, where the firmware puts them */
+static void bench_atags(void)
+{
+	unsigned int *atags = (unsigned int *)mem_p2v(BENCH_ATAGS);
+	unsigned long long cycles;
+	unsigned int word = 0;
+
+	atags[word++] = 5;		/* ATAG_CORE */
+	atags[word++] = ATAG_CORE;
+	atags[word++] = 0;
+	atags[word++] = 4096;
+	atags[word++] = 0;
+	atags[word++] = 4;		/* ATAG_MEM */
+	atags[word++] = ATAG_MEM;
+	atags[word++] = HOST_RAM_SIZE;
+	atags[word++] = 0;
+	atags[word++] = 2 + 4;		/* ATAG_CMDLINE, 16 characters */
+	atags[word++] = ATAG_CMDLINE;
+	memmove(&atags[word], "console=ttyAMA0", 16);
+	word += 4;
+	atags[word++] = 0;		/* ATAG_NONE */
+	atags[word++] = ATAG_NONE;
+
+	bench_start();
+	print_atags(BENCH_ATAGS);
+	bench_flush();
+	cycles = bench_stop(1);
+	bench_result("print_atags", cycles, bench_screen());
+}
+
+static void bench_console(void)
+{
+	struct fb_info fb;
+	unsigned long long cycles;
+	unsigned int count;
+	char line[80];
+
+	bench_start();
+	for(count=0; count<BENCH_LINES; count++)
+	{
+		ksnprintf(line, sizeof(line), "Line %u: the quick brown fox "
+			"jumps over the lazy dog\n", count);
+		console_write(line);
+	}
+	bench_flush();
+	cycles = bench_stop(BENCH_LINES);
+	bench_result("Console lines", cycles, bench_screen());
+
+	bench_start();
+	for(count=0; count<BENCH_LINES; count++)
+	{
+		ksnprintf(line, sizeof(line), COLOUR_PUSH FG_YELLOW "Line %u"
+			BG_BLUE BG_HALF " in colour" COLOUR_POP "\n", count);
+		console_write(line);
+	}
+	bench_flush();
+	cycles = bench_stop(BENCH_LINES);
+	bench_result("Console lines, colour", cycles, bench_screen());
+
+	fb_get_info(&fb);
+	bench_start();
+	for(count=0; count<BENCH_LINES / 16; count++)
+	{
+		fb_dirty(0, 0, fb.width, fb.height);
+		fb_flush();
+	}
+	bench_flush();
+	cycles = bench_stop(BENCH_LINES / 16);
+	bench_result("Full screen flush", cycles, bench_screen());
+
+	bench_start();
+	viewport_clear(console_viewport());
+	bench_flush();
+	cycles = bench_stop(1);
+	bench_result("Console clear", cycles, bench_screen());
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int width = BENCH_WIDTH, height = BENCH_HEIGHT;
+	struct fb_info fb;
+	int arg;
+
+	for(arg=1; arg<argc; arg++)
+	{
+		if(strcmp(argv[arg], "-v") == 0)
+			host_serial = 1;
+		else if(strcmp(argv[arg], "-s") == 0 && arg + 1 < argc &&
+			sscanf(argv[arg + 1], "%ux%u", &width, &height) == 2)
+			arg++;
+		else
+		{
+			fprintf(stderr, "Usage: %s [-v] [-s WIDTHxHEIGHT]\n",
+				argv[0]);
+			return 2;
+		}
+	}
+
+	if(!host_init(width, height))
+	{
+		fprintf(stderr, "Can't map the mock RAM and peripherals at "
+			"0x%08x\n", mem_p2v(0));
+		return 1;
+	}
+
+	fb_init();
+	fb_get_info(&fb);
+#ifndef FB_FONT
+	bench_default_screen = fb.width == BENCH_WIDTH &&
+		fb.height == BENCH_HEIGHT && fb.bpp == 16;
+#endif
+
+	printf("Checks\n");
+	check_memclr();
+	check_memmove();
+	check_ksnprintf();
+	check_fastdiv();
+
+	printf("Host benchmarks, %ux%u %ubpp (cycles per iteration, "
+		"checksum)\n", fb.width, fb.height, fb.bpp);
+	if(!bench_default_screen)
+		printf("  (not the default screen, so its checksums aren't "
+			"checked)\n");
+
+	bench_memutils();
+	bench_textutils();
+	bench_atags();
+	bench_console();
+
+	if(bench_failures)
+	{
+		printf("%u failed\n", bench_failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef HOST_H
+#define HOST_H
+
+/* Host build ("make host")
+ *
+ * Kernel code which doesn't need the hardware - memutils.c, textutils.c,
+ * atags.c, and the framebuffer and console (framebuffer.c, fbops.c,
+ * kprintf.c, stats.c and the fonts) - compiled for the build machine with
+ * HOST defined, which swaps the ARM instructions in soc.h, barrier.h,
+ * interrupts.h, timer.h, smp.h and memutils.c for plain C. The rest of the
+ * kernel is replaced by the mock in mock.c:
+ *
+ * - RAM and the peripherals are memory mapped where the kernel expects
+ *   them (mem_p2v(), soc_local()), so the same pointers work. Peripheral
+ *   registers are plain memory, and read back whatever was last written
+ * - The VideoCore mailbox answers the property tags the kernel uses,
+ *   allocating the framebuffer from the mock RAM
+ * - There are no DMA channels, threads or interrupts, so the CPU does all
+ *   the copies. The system timer is the host's clock, and the cycle counter
+ *   its time stamp counter
+ *
+ * The kernel code assumes pointers are 32 bits, so this is an x86 Linux
+ * build with -m32 (gcc-multilib on x86-64)
+ */
+
+/* Size of the mock RAM, from physical address 0 */
+#define HOST_RAM_SIZE	(64 << 20)
+
+/* Map the mock RAM and peripherals, and set the display size and depth the
+ * mailbox reports. Must be called before anything else. Returns 0 if the
+ * addresses the kernel uses aren't free in this process
+ */
+extern int host_init(unsigned int width, unsigned int height);
+
+/* If set, text the console copies to the serial port goes to stdout */
+extern int host_serial;
+
+#endif	/* HOST_H */
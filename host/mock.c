@@ -0,0 +1,309 @@
+/* Mock hardware for the host build (see host.h) */
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "dma.h"
+#include "led.h"
+#include "mailbox.h"
+#include "memory.h"
+#include "soc.h"
+#include "thread.h"
+#include "timer.h"
+#include "uart.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE	0x100000
+#endif
+
+int host_serial;
+
+/* Display size and depth reported by the mailbox */
+static unsigned int host_width, host_height, host_depth = 16;
+
+/* Next free physical address of the mock RAM, for mem_alloc() and the
+ * framebuffer. The first megabyte is left for the ATAGs and mailbox
+ * buffers
+ */
+static unsigned int phys_next = 0x00100000;
+
+/* Map anonymous memory at exactly address */
+static int host_map(unsigned int address, unsigned int size)
+{
+	void *p = mmap((void *)address, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+		MAP_FIXED_NOREPLACE, -1, 0);
+
+	if(p == MAP_FAILED)
+		return 0;
+	if(p != (void *)address)
+	{
+		/* Older kernels take MAP_FIXED_NOREPLACE as a hint */
+		munmap(p, size);
+		return 0;
+	}
+
+	return 1;
+}
+
+int host_init(unsigned int width, unsigned int height)
+{
+	host_width = width;
+	host_height = height;
+
+	return host_map(mem_p2v(0), HOST_RAM_SIZE) &&
+		host_map(mem_p2v(SOC_PERIPHERALS_BCM2835), 0x01000000) &&
+		host_map(soc_local(SOC_LOCAL_PERIPHERALS), 0x00100000);
+}
+
+/* Memory (memory.c). Anything outside the mock RAM (such as a mailbox
+ * buffer on the host stack) is taken to be at the same physical address,
+ * which is safe as the host never puts anything in the first 64MB
+ */
+unsigned int mem_v2p(unsigned int virtualaddr)
+{
+	if(virtualaddr - mem_p2v(0) < HOST_RAM_SIZE)
+		return virtualaddr - mem_p2v(0);
+
+	return virtualaddr;
+}
+
+void *mem_map(unsigned int physaddr, unsigned int size, unsigned int type)
+{
+	if(physaddr >= HOST_RAM_SIZE || size > HOST_RAM_SIZE - physaddr)
+		return 0;
+
+	return (void *)mem_p2v(physaddr);
+}
+
+static unsigned int host_alloc(unsigned int size)
+{
+	unsigned int physaddr = phys_next;
+
+	size = (size + 0x000fffff) & 0xfff00000;
+	if(size == 0 || size > HOST_RAM_SIZE - phys_next)
+		return 0;
+
+	phys_next += size;
+
+	return physaddr;
+}
+
+void *mem_alloc(unsigned int size, unsigned int type)
+{
+	unsigned int physaddr = host_alloc(size);
+
+	return physaddr ? (void *)mem_p2v(physaddr) : 0;
+}
+
+/* VideoCore mailbox (mailbox.c). Property requests (channel 8) are
+ * answered straight away, tag by tag; anything else is ignored
+ */
+static unsigned int mailbox_last[16];
+static unsigned int fb_physical, fb_size;
+
+/* Answer one tag, given its value buffer. Returns the length of the
+ * response, or ~0 if the tag isn't known
+ */
+static unsigned int mailbox_tag(unsigned int tag, unsigned int *value)
+{
+	switch(tag)
+	{
+		case 0x10005:	/* ARM memory */
+			value[0] = 0;
+			value[1] = HOST_RAM_SIZE;
+			return 8;
+		case 0x40003:	/* Get display size */
+			value[0] = host_width;
+			value[1] = host_height;
+			return 8;
+		case 0x40001:	/* Allocate framebuffer (both pages) */
+			if(!fb_physical)
+			{
+				fb_size = host_width * host_depth / 8 *
+					host_height * 2;
+				fb_physical = host_alloc(fb_size);
+			}
+			/* A bus address, as the firmware gives */
+			value[0] = fb_physical | 0x40000000;
+			value[1] = fb_size;
+			return 8;
+		case 0x40005:	/* Get depth */
+			value[0] = host_depth;
+			return 4;
+		case 0x48005:	/* Set depth */
+			host_depth = value[0];
+			return 4;
+		case 0x40008:	/* Get pitch */
+			value[0] = host_width * host_depth / 8;
+			return 4;
+		case 0x48003:	/* Set physical size */
+		case 0x48004:	/* Set virtual size */
+		case 0x48009:	/* Set virtual offset */
+			return 8;
+		case 0x48006:	/* Set pixel order */
+			return 4;
+		case 0x4800b:	/* Set palette */
+			value[0] = 0;
+			return 4;
+		case 0x4800e:	/* Wait for vsync */
+			return 0;
+	}
+
+	return ~0;
+}
+
+static void mailbox_property(unsigned int *buffer)
+{
+	unsigned int words = buffer[0] / 4, position = 2, length;
+
+	while(position + 3 <= words && buffer[position])
+	{
+		length = mailbox_tag(buffer[position], &buffer[position + 3]);
+		if(length != ~0U)
+			buffer[position + 2] = 0x80000000 | length;
+
+		position += 3 + buffer[position + 1] / 4;
+	}
+
+	buffer[1] = 0x80000000;
+}
+
+void writemailbox(unsigned int channel, unsigned int data)
+{
+	unsigned int address = data & ~15;
+
+	channel &= 15;
+	mailbox_last[channel] = data;
+
+	if(channel == 8)
+		mailbox_property((unsigned int *)(address < HOST_RAM_SIZE ?
+			mem_p2v(address) : address));
+}
+
+unsigned int readmailbox(unsigned int channel)
+{
+	return mailbox_last[channel & 15];
+}
+
+void mailbox_init(void)
+{
+}
+
+/* DMA (dma.c). No channels are free, so the framebuffer copies with the
+ * CPU. Control blocks can still be built, holding host addresses, and are
+ * run by the CPU when started, as the DMA engine would
+ */
+#define TI_TDMODE	(1<<1)
+
+static struct dma_cb host_cbs[DMA_CBS_PER_CHANNEL];
+
+int dma_channel_alloc(unsigned int flags)
+{
+	return -1;
+}
+
+void dma_channel_free(unsigned int channel)
+{
+}
+
+struct dma_cb *dma_channel_cbs(unsigned int channel)
+{
+	return host_cbs;
+}
+
+void dma_cb_copy(struct dma_cb *cb, void *dest, const void *src,
+	unsigned int length)
+{
+	cb->ti = 0;
+	cb->source_ad = (unsigned int)src;
+	cb->dest_ad = (unsigned int)dest;
+	cb->txfr_len = length;
+	cb->stride = 0;
+	cb->nextconbk = 0;
+}
+
+void dma_cb_copy2d(struct dma_cb *cb, void *dest, int dest_pitch,
+	const void *src, int src_pitch, unsigned int width, unsigned int rows)
+{
+	dma_cb_copy(cb, dest, src, ((rows - 1) << 16) | width);
+	cb->ti = TI_TDMODE;
+	cb->stride = (((dest_pitch - (int)width) & 0xffff) << 16) |
+		((src_pitch - (int)width) & 0xffff);
+}
+
+void dma_cb_link(struct dma_cb *cb, struct dma_cb *next)
+{
+	cb->nextconbk = (unsigned int)next;
+}
+
+void dma_start(unsigned int channel, struct dma_cb *first,
+	void (*done)(unsigned int channel))
+{
+	struct dma_cb *cb;
+	char *dest, *src;
+	unsigned int rows, width;
+
+	for(cb=first; cb; cb=(struct dma_cb *)cb->nextconbk)
+	{
+		dest = (char *)cb->dest_ad;
+		src = (char *)cb->source_ad;
+		rows = cb->ti & TI_TDMODE ? (cb->txfr_len >> 16) + 1 : 1;
+		width = cb->ti & TI_TDMODE ? cb->txfr_len & 0xffff :
+			cb->txfr_len;
+
+		while(rows--)
+		{
+			memmove(dest, src, width);
+			dest += width + (short)(cb->stride >> 16);
+			src += width + (short)(cb->stride & 0xffff);
+		}
+	}
+
+	if(done)
+		done(channel);
+}
+
+void dma_wait(unsigned int channel)
+{
+}
+
+/* Threads (thread.c). There's only the one */
+void thread_preempt_off(void)
+{
+}
+
+void thread_preempt_on(void)
+{
+}
+
+/* System timer (timer.c) */
+unsigned int timer_read(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* Serial port (uart.c) */
+void uart_write(char *text)
+{
+	if(host_serial)
+		fputs(text, stdout);
+}
+
+/* OK LED (led.c). Only used to show that the framebuffer couldn't be set
+ * up, which is fatal
+ */
+void output(unsigned int num)
+{
+	fprintf(stderr, "Framebuffer initialisation failed (%u)\n", num);
+	exit(1);
+}
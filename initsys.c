@@ -1,24 +1,39 @@
+#include "soc.h"
+
 /* Virtual memory layout
  *
  * 0x00000000 - 0x7fffffff (0-2GB) = user process memory
  * 0x80000000 - 0xa0ffffff (2GB) = physical memory
- * 	includes peripherals at 0x20000000 - 0x20ffffff
- * 0xc0000000 - 0xefffffff = kernel heap/stack
+ * 	includes peripherals at 0x20000000 - 0x20ffffff (0x3f000000 -
+ * 	0x3fffffff on the BCM2836/7)
+ * 0xa1000000 - 0xa10fffff = ARM local peripherals (BCM2836/7 only)
+ * 0xc0000000 - 0xdfffffff = kernel heap/stack
+ * 0xe0000000 - 0xefffffff = mapped later, on request (see memory.c)
  * 0xf0000000 - 0xffffffff = kernel code
  *
  * Memory from 0x80000000 upwards won't be accessible to user processes
  */
 
 static unsigned int *initpagetable = (unsigned int * const)0x4000; /* 16K */
-static unsigned int *kerneldatatable = (unsigned int * const)0x3c00; /* 1K */
 
 /* initsys calls main() when it's finished, so we need to tell the compiler
  * it's an external symbol
  */
 extern void main(void);
 
+/* Unpack the high kernel if it was built compressed, in unlz4.c */
+extern void unlz4_kernel(void);
+
+/* Burst memory fill, in start.s */
+extern void init_fill(unsigned int *dest, unsigned int count,
+			unsigned int value, unsigned int step);
+
+/* Move the stack pointers into the physical memory window, in start.s */
+extern void init_stacks_high(void);
+
 /* Memory locations. Defined in linkscript, set during linking */
 extern unsigned int _physdatastart, _physbssstart, _physbssend;
+extern unsigned int _physdatatables, _physdatatablesend;
 extern unsigned int _kstart, _kend;
 
 __attribute__((naked)) void initsys(void)
@@ -26,11 +41,17 @@ __attribute__((naked)) void initsys(void)
 	register unsigned int x;
 	register unsigned int pt_addr;
 	register unsigned int control;
-	register unsigned int *bss;
+	register unsigned int pages, tables;
 
 	/* Save r0-r2 as they contain the start values used by the kernel */
 	asm volatile("push {r0, r1, r2}");
 
+	/* If this is a compressed kernel, the high kernel needs to be in
+	 * place before anything else - .bss and the page tables are laid
+	 * out after it, and the compressed data is in the way
+	 */
+	unlz4_kernel();
+
 	/* The MMU has two translation tables. Table 0 covers the bottom
 	 * of the address space, from 0x00000000, and deals with between
 	 * 32MB to 4GB of the virtual address space.
@@ -66,21 +87,28 @@ __attribute__((naked)) void initsys(void)
 	 * 0 or 3 = translation fault (3 is reserved and shouldn't be used)
 	 * 1 = course page table
 	 * 2 = section or supersection
+	 *
+	 * The data cache is off, so every store goes straight out to memory.
+	 * The table is written in three runs with init_fill, which stores 8
+	 * entries per instruction:
+	 * 0x00000000-0x7fffffff	unmapped
+	 * 0x80000000-0xa0ffffff	physical memory, read/write for
+	 *				privileged modes, no execute
+	 * 0xa1000000-0xffffffff	unmapped
+	 */
+	init_fill(&initpagetable[0], 0x800, 0, 0);
+	init_fill(&initpagetable[0x800], 0xa10 - 0x800, 0<<20 | 0x0410 | 2, 1<<20);
+	init_fill(&initpagetable[0xa10], 4096 - 0xa10, 0, 0);
+
+	/* The quad-core SoCs have their peripherals at 0x3f000000. Map them
+	 * where the BCM2835's would be, so the same virtual addresses work
+	 * on both, and the ARM local peripherals in the megabyte after
 	 */
-	for(x=0; x<4096; x++)
+	if(!cpu_is_arm11())
 	{
-		if((x >= (0x80000000>>20)) && (x < (0xa1000000>>20)))
-		{
-			/* Map physical memory to virtual
-			 * Read/write for priviledged modes, no execute
-			 */
-			initpagetable[x] = (x-2048)<<20 | 0x0410 | 2;
-		}
-		else
-		{
-			/* No entry in table; translation fault */
-			initpagetable[x] = 0;
-		}
+		init_fill(&initpagetable[0xa00], 16,
+			SOC_PERIPHERALS_BCM2836 | 0x0410 | 2, 1<<20);
+		initpagetable[0xa10] = SOC_LOCAL_PERIPHERALS | 0x0410 | 2;
 	}
 
 	/* Map 0x00000000-0x000fffff into virtual memory at the same address.
@@ -91,11 +119,12 @@ __attribute__((naked)) void initsys(void)
 	 */
 	initpagetable[0] = 0<<20 | 0x0400 | 2;
 
-	/* Map 1MB at 0xf00000000-0xf00fffff to the kernel code in memory.
-	 * Typically, this is loaded at 0x9000, and appears in virtual memory
-	 * from 0xf0009000. This means we can use a single 1MB entry to
-	 * cover it all (as long as the kernel doesn't get above 1MB...),
-	 * reducing the number of TLB entries
+	/* Map the kernel code at 0xf0000000 onwards to physical memory from
+	 * 0x00000000, one 1MB section per megabyte. Typically, the kernel is
+	 * loaded at 0x9000, and appears in virtual memory from 0xf0009000.
+	 * Using sections rather than pages keeps the number of TLB entries
+	 * down, and there are as many as needed to reach the end of the
+	 * kernel's read-only data
 	 *
 	 * Map as read-only for privileged modes only
 	 *
@@ -104,19 +133,30 @@ __attribute__((naked)) void initsys(void)
 	 * read-only and only available to the kernel, the potential for harm
 	 * is minimal
 	 */
-	initpagetable[3840] = 0<<20 | 0x8400 | 2;
+	x = ((unsigned int)&_kend - 0xf0000000 + 0x000fffff) >> 20;
+	init_fill(&initpagetable[3840], x, 0<<20 | 0x8400 | 2, 1<<20);
 
-	/* 0xc0000000-0xc00fffff is mapped to physical memory by a course
-	 * page table
+	/* 0xc0000000 onwards is mapped to physical memory by coarse page
+	 * tables, each of which covers 1MB
 	 *
 	 * This maps the kernel data from where it has been loaded in memory
 	 * (after the kernel code, eg. at 0x0001f000) to 0xc0000000
 	 * Only memory in use is mapped (to the next 4K). The rest of the
-	 * table is unmapped.
+	 * last table is unmapped.
+	 *
+	 * The coarse tables are placed, 1K aligned, straight after .bss in
+	 * physical memory (see linkscript), and there are as many of them
+	 * as the size of the kernel's data needs
 	 */
-	initpagetable[3072] = 1 | (unsigned int)kerneldatatable;
+	pages = ((unsigned int)&_physbssend - (unsigned int)&_physdatastart
+		+ 0xfff) >> 12;
+	tables = ((unsigned int)&_physdatatablesend -
+		(unsigned int)&_physdatatables) >> 10;
+
+	init_fill(&initpagetable[3072], tables,
+		1 | (unsigned int)&_physdatatables, 1<<10);
 
-	/* Populate kerneldatatable - see ARM1176JZF-S manual, 6-40
+	/* Populate the coarse tables - see ARM1176JZF-S manual, 6-40
 	 *
 	 * APX/AP bits for a page table entry are at bits 9 and 4&5. The
 	 * meaning is the same as for a section entry.
@@ -128,30 +168,21 @@ __attribute__((naked)) void initsys(void)
 	 * 2 = small page (4K), executable	(XN is bit 0)
 	 * 3 = small page (4K), not-executable  (XN is bit 0)
 	 * 
-	 * 256 entries, one for each 4KB in the 1MB covered by the table
+	 * 256 entries per table, one for each 4KB in the 1MB covered by it.
+	 * The tables are contiguous, so one run of entries covers them all
 	 */
-	for(x=0; x<256; x++)
-	{
-		/* &_physbssend is the physical address of the end of the
-		 * kernel data - somewhere between 0x00009000 and 1MB (any
-		 * more than that and this code will need rewriting...)
-		 */
-		if(x <= ((unsigned int)&_physbssend >> 12))
-			kerneldatatable[x] = ((unsigned int)&_physdatastart + (x<<12)) | 0x0010 | 2;
-		else
-			kerneldatatable[x] = 0;
-	}
+	init_fill(&_physdatatables, pages,
+		(unsigned int)&_physdatastart | 0x0010 | 2, 1<<12);
+	init_fill(&_physdatatables + pages, (tables<<8) - pages, 0, 0);
 
 	/* The .bss section is allocated in physical memory, but its contents
 	 * (all zeroes) are not loaded in with the kernel.
-	 * It needs to be zeroed before it can be used
+	 * It needs to be zeroed before it can be used. linkscript pads .bss
+	 * to a whole number of words
 	 */
-	bss = &_physbssstart;
-	while(bss<&_physbssend)
-	{
-		*bss = 0;
-		bss++;
-	}
+	init_fill(&_physbssstart,
+		((unsigned int)&_physbssend - (unsigned int)&_physbssstart) >> 2,
+		0, 0);
 
 	pt_addr = (unsigned int) initpagetable;
 
@@ -177,6 +208,12 @@ __attribute__((naked)) void initsys(void)
 	/* Write value back to control register */
 	asm volatile("mcr p15, 0, %[control], c1, c0, 0" : : [control] "r" (control));
 
+	/* The stacks were set up at their physical addresses. They're still
+	 * reachable there (through the temporary mapping of the first
+	 * megabyte), but that goes once main() is running
+	 */
+	init_stacks_high();
+
 	/* Set the LR (R14) to the address of main(), then pop off r0-r2
 	 * before exiting this function (which doesn't store anything else
 	 * on the stack). The "mov lr" comes first as it's impossible to
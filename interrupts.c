@@ -1,10 +1,23 @@
 #include "interrupts.h"
 
 #include "framebuffer.h"
+#include "kprintf.h"
 #include "led.h"
 #include "memory.h"
-#include "textutils.h"
+#include "smp.h"
+#include "soc.h"
+#include "stats.h"
+#include "thread.h"
+#include "trace.h"
+#include "uart.h"
 
+/* For putting constants into the entry code */
+#define STRINGIFY_(X)	#X
+#define STRINGIFY(X)	STRINGIFY_(X)
+
+static volatile unsigned int *irqPendingBasic = (unsigned int *) mem_p2v(0x2000b200);
+static volatile unsigned int *irqPending1 = (unsigned int *) mem_p2v(0x2000b204);
+static volatile unsigned int *irqPending2 = (unsigned int *) mem_p2v(0x2000b208);
 static volatile unsigned int *irqEnable1 = (unsigned int *) mem_p2v(0x2000b210);
 static volatile unsigned int *irqEnable2 = (unsigned int *) mem_p2v(0x2000b214);
 static volatile unsigned int *irqEnableBasic = (unsigned int *) mem_p2v(0x2000b218);
@@ -27,11 +40,11 @@ __attribute__ ((naked, aligned(32))) static void interrupt_vectors(void)
 {
 	asm volatile("b bad_exception\n"	/* RESET */
 		"b bad_exception\n"	/* UNDEF */
-		"b interrupt_swi\n"
+		"b interrupt_swi\n"	/* syscall.c */
 		"b interrupt_prefetch_abort \n"
 		"b interrupt_data_abort \n"
 		"b bad_exception;\n"	/* Unused vector */
-		"b interrupt_irq \n"
+		"b interrupt_irq_entry \n"
 		"b bad_exception\n"	/* FIQ */
 	);
 }
@@ -42,33 +55,155 @@ __attribute__ ((naked)) void bad_exception(void)
 	while(1);
 }
 
-__attribute__ ((interrupt ("SWI"))) void interrupt_swi(void)
+/* Handlers for each interrupt number (see interrupts.h) */
+static interrupt_handler irq_handlers[IRQ_COUNT];
+
+/* Times each interrupt has been handled, registered with its handler */
+static struct stat_counter irq_counts[IRQ_COUNT];
+static char irq_names[IRQ_COUNT][8];
+
+/* Call the handler for each interrupt set in pending, numbered from base */
+static void irq_dispatch(unsigned int pending, unsigned int base)
 {
-	register unsigned int addr;
-	register unsigned int swi_no;
-	/* Read link register into addr - contains the address of the
-	 * instruction after the SWI
+	unsigned int bit;
+
+	while(pending)
+	{
+		bit = 31 - __builtin_clz(pending);
+		pending &= ~(1<<bit);
+
+		if(irq_handlers[base + bit])
+		{
+			irq_handlers[base + bit]();
+			stat_inc(&irq_counts[base + bit]);
+		}
+	}
+}
+
+/* IRQ entry. The interrupted context is saved on the stack of whatever was
+ * interrupted (system mode - the IRQ stack is barely used), as a frame holding
+ * every register (struct thread_frame, in thread.h). interrupt_irq()
+ * returns the address of the frame to go back to, which is another
+ * thread's if the scheduler has switched threads
+ *
+ * Handlers run in system mode, with IRQs disabled
+ */
+__attribute__ ((naked)) void interrupt_irq_entry(void)
+{
+	/* First, the cycle counter into this core's smp_core irq_entry
+	 * (cycles_read(), in timer.h, but the CPU is checked here as
+	 * cpu_is_arm11() does). r0 and r1 go on the IRQ stack meanwhile
 	 */
-	asm volatile("mov %[addr], lr" : [addr] "=r" (addr) );
+	asm volatile("push {r0, r1}\n"
+		"mrc p15, 0, r0, c0, c0, 0\n"	/* Main ID register */
+		"and r0, r0, #0xf000\n"
+		"cmp r0, #0xb000\n"		/* ARM11 */
+		"mrceq p15, 0, r0, c15, c12, 1\n"
+		"mrcne p15, 0, r0, c9, c13, 0\n"
+		"mrc p15, 0, r1, c13, c0, 4\n"	/* TPIDRPRW: smp_this() */
+		"str r0, [r1, #" STRINGIFY(SMP_CORE_IRQ_ENTRY) "]\n"
+		"pop {r0, r1}\n"
 
-	addr -= 4;
-	/* Bottom 24 bits of the SWI instruction are the SWI number */
-	swi_no = *((unsigned int *)addr) & 0x00ffffff;
+		"sub lr, lr, #4\n"
+		/* Return address and CPSR onto the system mode stack */
+		"srsdb sp!, #0x1f\n"
+		"cps #0x1f\n"
+		"push {r0-r12, lr}\n"
+		"mov r0, sp\n"
+		/* The stack needs to be 8 byte aligned for C */
+		"and r4, sp, #4\n"
+		"sub sp, sp, r4\n"
+		"bl interrupt_irq\n"
+		"mov sp, r0\n"
+		"pop {r0-r12, lr}\n"
+		"rfeia sp!\n"
+	);
+}
+
+/* Work out which interrupts are pending, and call their handlers
+ *
+ * The basic pending register has "something pending in register 1/2" bits,
+ * but they don't cover the GPU interrupts which have their own bit in the
+ * basic register (such as the UART), so all three registers are read
+ *
+ * On the BCM2836/7, IPIs from the other cores come in too (smp.c). The GPU
+ * interrupts are only routed to core 0
+ */
+unsigned int interrupt_irq(unsigned int frame)
+{
+	unsigned int pending;
 
-	console_write(COLOUR_PUSH FG_GREEN "SWI call. Address: 0x");
-	console_write(tohex(addr, 4));
-	console_write("  SWI number ");
-	console_write(todec(swi_no, 0));
-	console_write(COLOUR_POP "\n");
+	trace(TRACE_IRQ_ENTRY, ((struct thread_frame *)frame)->pc, frame);
+
+	if(!cpu_is_arm11())
+	{
+		smp_ipi_irq();
+
+		if(smp_this()->id != 0)
+		{
+			trace(TRACE_IRQ_EXIT, ((struct thread_frame *)frame)->pc,
+				frame);
+			return frame;
+		}
+	}
+
+	if((pending = *irqPendingBasic & 0xff))
+		irq_dispatch(pending, 64);
+	if((pending = *irqPending1))
+		irq_dispatch(pending, 0);
+	if((pending = *irqPending2))
+		irq_dispatch(pending, 32);
+
+	frame = thread_switch(frame);
+	trace(TRACE_IRQ_EXIT, ((struct thread_frame *)frame)->pc, frame);
+
+	return frame;
 }
 
-/* IRQs flash the OK LED */
-__attribute__ ((interrupt ("IRQ"))) void interrupt_irq(void)
+interrupt_handler interrupt_register(unsigned int irq,
+	interrupt_handler handler)
+{
+	interrupt_handler previous;
+
+	if(irq >= IRQ_COUNT)
+		return 0;
+
+	previous = irq_handlers[irq];
+	irq_handlers[irq] = handler;
+
+	ksnprintf(irq_names[irq], sizeof(irq_names[irq]), "IRQ %u", irq);
+	irq_counts[irq].name = irq_names[irq];
+	stat_register_counter(&irq_counts[irq]);
+
+	if(irq < 32)
+		*irqEnable1 = 1<<irq;
+	else if(irq < 64)
+		*irqEnable2 = 1<<(irq-32);
+	else
+		*irqEnableBasic = 1<<(irq-64);
+
+	return previous;
+}
+
+/* ARM timer interrupts flash the OK LED */
+static void armtimer_irq(void)
 {
 	*armTimerIRQClear = 0;
 	led_invert();
 }
 
+/* "ABORT type address fault" on the serial port only, for "make
+ * qemu-bench" (tools/qemu-bench.pl)
+ */
+static void abort_marker(const char *type, unsigned int addr, unsigned int far)
+{
+	char line[48];
+
+	ksnprintf(line, sizeof(line), "ABORT %s 0x%08X 0x%08X\n", type, addr,
+		far);
+	uart_write(line);
+}
+
 __attribute__ ((interrupt ("ABORT"))) void interrupt_data_abort(void)
 {
 	register unsigned int addr, far;
@@ -77,17 +212,16 @@ __attribute__ ((interrupt ("ABORT"))) void interrupt_data_abort(void)
 	asm volatile("mrc p15, 0, %[addr], c6, c0, 0": [addr] "=r" (far) );
 
 
-	console_write("Data abort!\n");
-	console_write("Instruction address: 0x");
 	/* addr = lr, but the very start of the abort routine does
 	 * sub lr, lr, #4
 	 * lr = address of aborted instruction, plus 8
 	 */
-	console_write(tohex(addr-4, 4));
+	trace(TRACE_DATA_ABORT, addr-4, far);
 
-	console_write("  fault address: 0x");
-	console_write(tohex(far, 4));
-	console_write("\n");
+	kprintf("Data abort!\nInstruction address: 0x%08X  fault address: 0x%08X\n",
+		addr-4, far);
+	abort_marker("data", addr-4, far);
+	trace_dump(TRACE_DUMP_ABORT);
 
 	/* Routine terminates by returning to LR-4, which is the instruction
 	 * after the aborted one
@@ -104,14 +238,15 @@ __attribute__ ((interrupt ("ABORT"))) void interrupt_prefetch_abort(void)
 	register unsigned int addr;
 	asm volatile("mov %[addr], lr" : [addr] "=r" (addr) );
 
-	console_write("Prefetch abort!\n");
-	console_write("Instruction address: 0x");
 	/* lr = address of aborted instruction, plus 4
 	 * addr = lr, but the very start of the abort routine does
 	 * sub lr, lr, #4
 	 */
-	console_write(tohex(addr, 4));
-	console_write("\n");
+	trace(TRACE_PREFETCH_ABORT, addr, 0);
+
+	kprintf("Prefetch abort!\nInstruction address: 0x%08X\n", addr);
+	abort_marker("prefetch", addr, addr);
+	trace_dump(TRACE_DUMP_ABORT);
 
 	/* Set the return address to be the function main_endloop(), by
 	 * putting its address into the program counter
@@ -126,20 +261,26 @@ __attribute__ ((interrupt ("ABORT"))) void interrupt_prefetch_abort(void)
 	/* Doesn't reach this point */
 }
 
+/* Point this core at the interrupt vectors and turn on interrupts */
+void interrupts_init_core(void)
+{
+	/* Set interrupt base register */
+	asm volatile("mcr p15, 0, %[addr], c12, c0, 0" : : [addr] "r" (&interrupt_vectors));
+	/* Turn on interrupts */
+	asm volatile("cpsie i");
+}
+
 /* Initialise the interrupts
  *
  * Enable the ARM timer interrupt
  */
 void interrupts_init(void)
 {
-	/* Set interrupt base register */
-	asm volatile("mcr p15, 0, %[addr], c12, c0, 0" : : [addr] "r" (&interrupt_vectors));
-	/* Turn on interrupts */
-	asm volatile("cpsie i");
+	interrupts_init_core();
 
 	/* Use the ARM timer - BCM 2832 peripherals doc, p.196 */
 	/* Enable ARM timer IRQ */
-	*irqEnableBasic = 0x00000001;
+	interrupt_register(IRQ_ARMTIMER, armtimer_irq);
 
 	/* Interrupt every 1024 * 256 (prescaler) timer ticks */
 	*armTimerLoad = 0x00000400;
@@ -3,4 +3,69 @@
 
 extern void interrupts_init(void);
 
+/* Just the per-core part of interrupts_init(), for cores 1-3 (smp.c) */
+extern void interrupts_init_core(void);
+
+/* Interrupt numbers for interrupt_register
+ * 0-63 are the GPU peripheral interrupts (BCM2835 peripherals guide,
+ * p.113), 64-71 the ARM-specific interrupts in the basic pending register
+ */
+#define IRQ_SYSTIMER(n)	(n)		/* System timer compare 0-3 */
+#define IRQ_DMA(n)	(16 + (n))	/* DMA channels 0-11 (11 is 11-14) */
+#define IRQ_UART	57		/* PL011 UART */
+#define IRQ_ARMTIMER	64		/* ARM timer */
+
+#define IRQ_COUNT	72
+
+/* Call handler (with IRQs disabled, on the interrupted stack) whenever
+ * interrupt irq is pending, and enable the interrupt. The handler must
+ * clear the interrupt at its source. Returns the handler it replaces (or 0),
+ * so that something borrowing an interrupt can put it back
+ */
+typedef void (*interrupt_handler)(void);
+extern interrupt_handler interrupt_register(unsigned int irq,
+	interrupt_handler handler);
+
+/* Disable IRQs, returning the previous CPSR so they can be restored */
+static inline unsigned int irq_save(void)
+{
+	unsigned int cpsr;
+
+#ifdef HOST
+	/* No interrupts in the host build */
+	cpsr = 0;
+	asm volatile("" : : : "memory");
+#else
+	asm volatile("mrs %[cpsr], cpsr\n"
+		"cpsid i" : [cpsr] "=r" (cpsr) : : "memory");
+#endif
+
+	return cpsr;
+}
+
+static inline void irq_restore(unsigned int cpsr)
+{
+#ifdef HOST
+	asm volatile("" : : : "memory");
+#else
+	asm volatile("msr cpsr_c, %[cpsr]" : : [cpsr] "r" (cpsr) : "memory");
+#endif
+}
+
+/* Non-zero if IRQs are disabled: in an interrupt handler, or between
+ * irq_save() and irq_restore()
+ */
+static inline unsigned int irq_disabled(void)
+{
+	unsigned int cpsr;
+
+#ifdef HOST
+	cpsr = 0;
+#else
+	asm volatile("mrs %[cpsr], cpsr" : [cpsr] "=r" (cpsr));
+#endif
+
+	return cpsr & 0x80;
+}
+
 #endif	/* INTERRUPTS_H */
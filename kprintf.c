@@ -0,0 +1,280 @@
+/* Formatted output: kprintf, ksnprintf
+ *
+ * Everything is formatted in one pass into a buffer, using only the
+ * caller's stack, so formatting is safe from any context (including
+ * interrupt handlers); tohex()/todec() return shared static buffers and
+ * aren't. Writing the result out is another matter: console_write() only
+ * holds off other threads, not interrupts, so an interrupt handler which
+ * prints can corrupt a line being drawn. Handlers post their printing as
+ * a task (task.h) instead. The abort handlers are the exception, as an
+ * abort stops whatever caused it, and saying so comes first
+ */
+
+#include "kprintf.h"
+
+#include "framebuffer.h"
+#include "textutils.h"
+
+/* Where formatted output goes. When the buffer fills up, flush() is called
+ * to empty it; if flush is 0, further output is discarded (but still
+ * counted)
+ */
+struct kprintf_out
+{
+	char *buffer;
+	unsigned int size;	/* Usable size, not including the final 0 */
+	unsigned int pos;
+	unsigned int total;
+	void (*flush)(struct kprintf_out *out);
+};
+
+static void out_char(struct kprintf_out *out, char ch)
+{
+	if(out->pos == out->size && out->flush)
+		out->flush(out);
+
+	if(out->pos < out->size)
+		out->buffer[out->pos++] = ch;
+
+	out->total++;
+}
+
+/* Output a string of length bytes, padded to width with pad. Negative width
+ * left-aligns (pads on the right, always with spaces)
+ */
+static void out_field(struct kprintf_out *out, const char *str,
+	unsigned int length, int width, char pad)
+{
+	int fill = (width < 0 ? -width : width) - (int)length;
+
+	/* Zero padding goes after a sign */
+	if(pad == '0' && length && *str == '-')
+	{
+		out_char(out, '-');
+		str++;
+		length--;
+	}
+
+	if(width > 0)
+		while(fill-- > 0)
+			out_char(out, pad);
+
+	while(length--)
+		out_char(out, *str++);
+
+	if(width < 0)
+		while(fill-- > 0)
+			out_char(out, ' ');
+}
+
+/* Colour letters for %F/%B, in control code order (framebuffer.h) */
+static const char colour_letters[] = "rgbymcwkh";
+
+static void kformat(struct kprintf_out *out, const char *format, va_list args)
+{
+	/* Longest conversion is "-" and 10 decimal digits */
+	char digits[12];
+	char *end = &digits[sizeof(digits)];
+	char *str;
+	char ch, pad;
+	int width;
+	unsigned int value, count;
+
+	while((ch = *format++))
+	{
+		if(ch != '%')
+		{
+			out_char(out, ch);
+			continue;
+		}
+
+		pad = ' ';
+		width = 0;
+
+		ch = *format++;
+
+		if(ch == '-')
+		{
+			width = -1;
+			ch = *format++;
+		}
+		else if(ch == '0')
+		{
+			pad = '0';
+			ch = *format++;
+		}
+
+		if(ch == '*')
+		{
+			value = va_arg(args, int);
+			width = width < 0 ? -(int)value : (int)value;
+			ch = *format++;
+		}
+		else if(ch >= '0' && ch <= '9')
+		{
+			value = 0;
+			while(ch >= '0' && ch <= '9')
+			{
+				value = value * 10 + ch - '0';
+				ch = *format++;
+			}
+			width = width < 0 ? -(int)value : (int)value;
+		}
+		else if(width < 0)
+		{
+			/* "-" with no width */
+			width = 0;
+		}
+
+		switch(ch)
+		{
+			case 0:
+				/* Format string ends in the middle of a
+				 * conversion
+				 */
+				format--;
+				break;
+
+			case 'd':
+			case 'i':
+				value = va_arg(args, int);
+				if((int)value < 0)
+				{
+					str = decdigits(end, -value);
+					*--str = '-';
+				}
+				else
+				{
+					str = decdigits(end, value);
+				}
+				out_field(out, str, end - str, width, pad);
+				break;
+
+			case 'u':
+				str = decdigits(end, va_arg(args, unsigned int));
+				out_field(out, str, end - str, width, pad);
+				break;
+
+			case 'x':
+			case 'X':
+				str = hexdigits(end, va_arg(args, unsigned int), 1,
+					ch == 'X');
+				out_field(out, str, end - str, width, pad);
+				break;
+
+			case 'p':
+				str = hexdigits(end, (unsigned int)va_arg(args,
+					void *), 8, 1);
+				out_char(out, '0');
+				out_char(out, 'x');
+				out_field(out, str, end - str, 0, pad);
+				break;
+
+			case 'c':
+				digits[0] = (char)va_arg(args, int);
+				out_field(out, digits, 1, width, ' ');
+				break;
+
+			case 's':
+				str = va_arg(args, char *);
+				if(!str)
+					str = "(null)";
+				for(count=0; str[count]; count++);
+				out_field(out, str, count, width, ' ');
+				break;
+
+			case 'F':
+			case 'B':
+				/* Colour control codes: foreground 1-9,
+				 * background 17-25
+				 */
+				for(count=0; colour_letters[count]; count++)
+					if(colour_letters[count] == *format)
+						break;
+
+				if(colour_letters[count])
+					out_char(out, count + (ch == 'F' ? 1 : 17));
+				if(*format)
+					format++;
+				break;
+
+			case '<':
+				out_char(out, COLOUR_PUSH[0]);
+				break;
+
+			case '>':
+				out_char(out, COLOUR_POP[0]);
+				break;
+
+			default:
+				/* %% and anything unrecognised */
+				out_char(out, ch);
+				break;
+		}
+	}
+
+	/* No buffer when only counting */
+	if(out->buffer)
+		out->buffer[out->pos] = 0;
+}
+
+int kvsnprintf(char *buffer, unsigned int size, const char *format,
+	va_list args)
+{
+	struct kprintf_out out;
+
+	/* With no room even for the terminating 0, nothing is stored, but
+	 * the length is still counted
+	 */
+	out.buffer = size ? buffer : 0;
+	out.size = size ? size - 1 : 0;
+	out.pos = 0;
+	out.total = 0;
+	out.flush = 0;
+
+	kformat(&out, format, args);
+
+	return out.total;
+}
+
+int ksnprintf(char *buffer, unsigned int size, const char *format, ...)
+{
+	va_list args;
+	int ret;
+
+	va_start(args, format);
+	ret = kvsnprintf(buffer, size, format, args);
+	va_end(args);
+
+	return ret;
+}
+
+/* Send a full buffer to the console, and start again */
+static void kprintf_flush(struct kprintf_out *out)
+{
+	out->buffer[out->pos] = 0;
+	console_write(out->buffer);
+	out->pos = 0;
+}
+
+int kprintf(const char *format, ...)
+{
+	char buffer[KPRINTF_BUFSIZE];
+	struct kprintf_out out;
+	va_list args;
+
+	out.buffer = buffer;
+	out.size = KPRINTF_BUFSIZE - 1;
+	out.pos = 0;
+	out.total = 0;
+	out.flush = kprintf_flush;
+
+	va_start(args, format);
+	kformat(&out, format, args);
+	va_end(args);
+
+	if(out.pos)
+		console_write(buffer);
+
+	return out.total;
+}
@@ -0,0 +1,59 @@
+#ifndef KPRINTF_H
+#define KPRINTF_H
+
+/* Variable argument lists (no system headers, so use gcc's builtins) */
+typedef __builtin_va_list va_list;
+#define va_start(ap, last)	__builtin_va_start(ap, last)
+#define va_arg(ap, type)	__builtin_va_arg(ap, type)
+#define va_end(ap)		__builtin_va_end(ap)
+
+/* Size of the on-stack buffer kprintf formats into. Longer output is
+ * written to the console in more than one piece
+ */
+#define KPRINTF_BUFSIZE	256
+
+/* Formatted output. Supported conversions:
+ *
+ *	%d %i	signed decimal
+ *	%u	unsigned decimal
+ *	%x %X	hex, lower/upper case
+ *	%p	pointer (0x followed by 8 hex digits)
+ *	%c	character
+ *	%s	string
+ *	%%	a % sign
+ *
+ * A minimum field width may come between the % and the conversion, with
+ * a leading 0 to pad with zeroes instead of spaces, or a - to left-align
+ * (eg. %08X, %-10s). "*" takes the width from the argument list
+ *
+ * Console colour control codes (framebuffer.h) can be put straight into
+ * the format string, or chosen with:
+ *
+ *	%F?	foreground colour
+ *	%B?	background colour
+ *		? = r(ed) g(reen) b(lue) y(ellow) m(agenta) c(yan) w(hite)
+ *		    k (black) or h (half brightness)
+ *	%<	push colours (COLOUR_PUSH)
+ *	%>	pop colours (COLOUR_POP)
+ *
+ * The colour directives aren't standard printf, so gcc's format checking
+ * isn't used
+ */
+
+/* Format into buffer, writing at most size bytes including the
+ * terminating 0. Returns the length of the full output, even if it was
+ * truncated
+ */
+extern int ksnprintf(char *buffer, unsigned int size, const char *format, ...);
+extern int kvsnprintf(char *buffer, unsigned int size, const char *format,
+	va_list args);
+
+/* Format onto the console. The line is built in a buffer on the caller's
+ * stack and handed to console_write() in one go, so lines from different
+ * threads aren't mixed. Not for interrupt handlers, which can interrupt
+ * console output in progress: use ksnprintf() and post a task to print
+ * it. Returns the number of characters written
+ */
+extern int kprintf(const char *format, ...);
+
+#endif	/* KPRINTF_H */
@@ -5,6 +5,9 @@
 
 #include "barrier.h"
 #include "memory.h"
+#include "stats.h"
+#include "timer.h"
+#include "trace.h"
 
 /* Mailbox memory addresses */
 static volatile unsigned int *MAILBOX0READ = (unsigned int *) mem_p2v(0x2000b880);
@@ -17,6 +20,19 @@ static volatile unsigned int *MAILBOX0WRITE = (unsigned int *) mem_p2v(0x2000b8a
 /* Bit 30 set in status register if the read mailbox is empty */
 #define MAILBOX_EMPTY 0x40000000
 
+static struct stat_counter stat_writes = STAT_COUNTER_INIT("Mailbox writes");
+static struct stat_histogram stat_round_trip =
+	STAT_HISTOGRAM_INIT("Mailbox round trip", "us");
+
+/* When each channel was last written to, for the round trip time */
+static unsigned int write_time[16];
+
+void mailbox_init(void)
+{
+	stat_register_counter(&stat_writes);
+	stat_register_histogram(&stat_round_trip);
+}
+
 unsigned int readmailbox(unsigned int channel)
 {
 	unsigned int count = 0;
@@ -35,6 +51,7 @@ unsigned int readmailbox(unsigned int channel)
 			/* This is an arbritarily large number */
 			if(count++ >(1<<25))
 			{
+				trace(TRACE_MAILBOX_READ, channel, 0xffffffff);
 				return 0xffffffff;
 			}
 		}
@@ -46,7 +63,12 @@ unsigned int readmailbox(unsigned int channel)
 		dmb();
 
 		if ((data & 15) == channel)
+		{
+			trace(TRACE_MAILBOX_READ, channel, data);
+			stat_record(&stat_round_trip,
+				timer_read() - write_time[channel]);
 			return data;
+		}
 	}
 }
 
@@ -59,6 +81,10 @@ void writemailbox(unsigned int channel, unsigned int data)
 		flushcache();
 	}
 
+	trace(TRACE_MAILBOX_WRITE, channel, data);
+	stat_inc(&stat_writes);
+	write_time[channel & 15] = timer_read();
+
 	dmb();
 	*MAILBOX0WRITE = (data | channel);
 }
@@ -2,6 +2,9 @@
 #ifndef MAILBOX_H
 #define MAILBOX_H
 
+/* Register the mailbox statistics */
+extern void mailbox_init(void);
+
 extern unsigned int readmailbox(unsigned int channel);
 extern void writemailbox(unsigned int channel, unsigned int data);
 
@@ -1,12 +1,25 @@
 #include "led.h"
 #include "atags.h"
 #include "barrier.h"
+#include "benchmark.h"
+#include "dma.h"
+#include "fastdiv.h"
 #include "framebuffer.h"
+#include "gfx.h"
 #include "interrupts.h"
+#include "kprintf.h"
 #include "mailbox.h"
 #include "memory.h"
 #include "memutils.h"
-#include "textutils.h"
+#include "smp.h"
+#include "soc.h"
+#include "stats.h"
+#include "syscall.h"
+#include "task.h"
+#include "thread.h"
+#include "timer.h"
+#include "trace.h"
+#include "uart.h"
 
 /* Pull various bits of information from the VideoCore and display it on
  * screen
@@ -35,11 +48,8 @@ void mailboxtest(void)
 
 	var = readmailbox(8);
 
-	console_write(COLOUR_PUSH FG_CYAN "Display resolution: " BG_WHITE BG_HALF BG_HALF);
-	console_write(todec(buffer[5], 0));
-	console_write("x");
-	console_write(todec(buffer[6], 0));
-	console_write(COLOUR_POP "\n");
+	kprintf(COLOUR_PUSH FG_CYAN "Display resolution: " BG_WHITE BG_HALF BG_HALF
+		"%ux%u" COLOUR_POP "\n", buffer[5], buffer[6]);
 
 	buffer[0] = 8 * 4;	// Total size
 	buffer[1] = 0;		// Request
@@ -56,9 +66,8 @@ void mailboxtest(void)
 
 	var = readmailbox(8);
 
-	console_write(COLOUR_PUSH FG_CYAN "Pitch: " BG_WHITE BG_HALF BG_HALF);
-	console_write(todec(buffer[5], 0));
-	console_write(" bytes" COLOUR_POP "\n");
+	kprintf(COLOUR_PUSH FG_CYAN "Pitch: " BG_WHITE BG_HALF BG_HALF
+		"%u bytes" COLOUR_POP "\n", buffer[5]);
 
 	buffer[0] = 200 * 4;	// Total size
 	buffer[1] = 0;		// Request
@@ -74,9 +83,9 @@ void mailboxtest(void)
 
 	var = readmailbox(8);
 
-	console_write("\n" COLOUR_PUSH FG_RED "Kernel command line: " COLOUR_PUSH BG_RED BG_HALF BG_HALF);
-	console_write((char *)(&buffer[5]));
-	console_write(COLOUR_POP COLOUR_POP "\n\n");
+	kprintf("\n" COLOUR_PUSH FG_RED "Kernel command line: " COLOUR_PUSH BG_RED
+		BG_HALF BG_HALF "%s" COLOUR_POP COLOUR_POP "\n\n",
+		(char *)(&buffer[5]));
 
 
 	buffer[0] = 13 * 4;	// Total size
@@ -104,29 +113,17 @@ void mailboxtest(void)
 	size = buffer[6];
 	var = size / (1024*1024);
 
-	console_write(COLOUR_PUSH FG_YELLOW "ARM memory: " BG_YELLOW BG_HALF BG_HALF "0x");
-	console_write(tohex(mem, 4));
-	console_write(" - 0x");
-	console_write(tohex(mem+size-1, 4));
-	console_write(" (");
-	console_write(todec(size, 0));
 	/* ] appears as an arrow in the SAA5050 character set */
-	console_write(" bytes ] ");
-	console_write(todec(var, 0));
-	console_write(" megabytes)" COLOUR_POP "\n");
+	kprintf(COLOUR_PUSH FG_YELLOW "ARM memory: " BG_YELLOW BG_HALF BG_HALF
+		"0x%08X - 0x%08X (%u bytes ] %u megabytes)" COLOUR_POP "\n",
+		mem, mem+size-1, size, var);
 
 	mem = buffer[10];
 	size = buffer[11];
 	var = size / (1024*1024);
-	console_write(COLOUR_PUSH FG_YELLOW "VC memory:  " BG_YELLOW BG_HALF BG_HALF "0x");
-	console_write(tohex(mem, 4));
-	console_write(" - 0x");
-	console_write(tohex(mem+size-1, 4));
-	console_write(" (");
-	console_write(todec(size, 0));
-	console_write(" bytes ] ");
-	console_write(todec(var, 0));
-	console_write(" megabytes)" COLOUR_POP "\n");
+	kprintf(COLOUR_PUSH FG_YELLOW "VC memory:  " BG_YELLOW BG_HALF BG_HALF
+		"0x%08X - 0x%08X (%u bytes ] %u megabytes)" COLOUR_POP "\n",
+		mem, mem+size-1, size, var);
 }
 
 /* Call non-existent code at 33MB - should cause a prefetch abort */
@@ -135,6 +132,191 @@ static void(*deliberate_prefetch_abort)(void) = (void(*)(void))0x02100000;
 /* Location of the initial page table in RAM */
 static unsigned int *initpagetable = (unsigned int *) mem_p2v(0x4000);
 
+/* Start-up timings and sizes recorded by unlz4.c. These are in the .init
+ * section, so are only reachable through the physical memory mapping
+ */
+extern unsigned int boot_entry_time, boot_unpack_end;
+extern unsigned int boot_packed_size, boot_unpacked_size;
+
+#define INIT_VAR(X) (*(unsigned int *)mem_p2v((unsigned int)&(X)))
+
+/* One "BOOT stage time" line on the serial port only, for "make
+ * qemu-bench" (tools/qemu-bench.pl). Times are timer_read()'s
+ */
+static void boot_marker(const char *stage, unsigned int time)
+{
+	char line[40];
+
+	ksnprintf(line, sizeof(line), "BOOT %s %u\n", stage, time);
+	uart_write(line);
+}
+
+/* Initialisation, in order, and when each finished */
+static void status_init(void);
+
+static const struct boot_stage
+{
+	const char *name;
+	void (*init)(void);
+} boot_stages[] = {
+	{ "mem", mem_init },
+	{ "mailbox", mailbox_init },
+	{ "led", led_init },
+	{ "uart", uart_init },
+	{ "dma", dma_init },
+	{ "fb", fb_init },
+	{ "gfx", gfx_init },
+	{ "status", status_init },
+	{ "smp", smp_init },
+	{ "trace", trace_init },
+	{ "interrupts", interrupts_init },
+	{ "thread", thread_init },
+	{ "task", task_init },
+};
+
+#define BOOT_STAGES	(sizeof(boot_stages) / sizeof(boot_stages[0]))
+static unsigned int boot_stage_times[BOOT_STAGES];
+
+/* Show how long the kernel took to get going: time from reset to the
+ * kernel's first instruction (firmware start-up and loading kernel.img from
+ * the SD card), time spent unpacking a compressed kernel, and time from
+ * there to main(). Build both kernel.img and kernel-lz4.img to compare
+ */
+static void boot_timings(unsigned int main_time)
+{
+	unsigned int entry = INIT_VAR(boot_entry_time);
+	unsigned int unpacked = INIT_VAR(boot_unpack_end);
+	unsigned int stage;
+
+	if(INIT_VAR(boot_packed_size))
+		kprintf(COLOUR_PUSH FG_CYAN "Kernel entered at %uus, unpacked "
+			"%u -> %u bytes in %uus, main() at %uus" COLOUR_POP "\n\n",
+			entry, INIT_VAR(boot_packed_size),
+			INIT_VAR(boot_unpacked_size), unpacked - entry, main_time);
+	else
+		kprintf(COLOUR_PUSH FG_CYAN "Kernel entered at %uus "
+			"(uncompressed), main() at %uus" COLOUR_POP "\n\n",
+			entry, main_time);
+
+	boot_marker("entry", entry);
+	if(INIT_VAR(boot_packed_size))
+		boot_marker("unpacked", unpacked);
+	boot_marker("main", main_time);
+	for(stage=0; stage<BOOT_STAGES; stage++)
+		boot_marker(boot_stages[stage].name, boot_stage_times[stage]);
+}
+
+/* Status line along the bottom of the screen. The console scrolls above it,
+ * and the status line is rewritten in place
+ */
+static struct viewport status;
+static unsigned int status_seconds = ~0;
+
+/* How often it's checked (a timer task), in microseconds */
+#define STATUS_INTERVAL	100000
+static struct task_timer status_timer;
+
+/* Statistics panel down the right hand side, if the screen is wide enough
+ * to leave PANEL_CONSOLE_MIN columns for the console, redrawn every
+ * PANEL_INTERVAL microseconds
+ */
+#define PANEL_WIDTH		40
+#define PANEL_CONSOLE_MIN	64
+#define PANEL_INTERVAL		1000000
+static struct viewport panel;
+static unsigned int panel_shown;
+static struct task_timer panel_timer;
+
+static void status_init(void)
+{
+	unsigned int columns, rows, console_columns;
+
+	console_get_size(&columns, &rows);
+
+	console_columns = columns;
+	if(columns >= PANEL_WIDTH + PANEL_CONSOLE_MIN)
+	{
+		console_columns = columns - PANEL_WIDTH;
+		viewport_init(&panel, console_columns, 0, PANEL_WIDTH,
+			rows - 1, 0);
+		panel.fgcolour = 0xc0c0c0;
+		panel.bgcolour = 0x202020;
+		viewport_clear(&panel);
+		panel_shown = 1;
+	}
+
+	viewport_init(console_viewport(), 0, 0, console_columns, rows - 1,
+		VIEWPORT_SCROLL);
+	viewport_init(&status, 0, rows - 1, columns, 1, 0);
+	status.fgcolour = 0x00ffff;
+	status.bgcolour = 0x000080;
+	viewport_clear(&status);
+}
+
+static void panel_update(void *arg)
+{
+	stats_panel(&panel);
+}
+
+/* Show the uptime, if it has changed. Only the characters from the first
+ * one that differs from what's on screen are redrawn - usually just the
+ * last digit - by moving the cursor there with an escape sequence
+ */
+static char status_text[40];
+
+static void status_update(void *arg)
+{
+	char line[sizeof(status_text)], out[sizeof(status_text) + 16];
+	unsigned int seconds = udiv1000000(timer_read());
+	unsigned int first;
+
+	if(seconds == status_seconds)
+		return;
+	status_seconds = seconds;
+
+	ksnprintf(line, sizeof(line), "Up %u:%02u:%02u", seconds / 3600,
+		(seconds / 60) % 60, seconds % 60);
+
+	for(first=0; line[first] && line[first] == status_text[first]; first++);
+	if(line[first] == 0 && status_text[first] == 0)
+		return;
+
+	/* Columns count from 1. Erase to the end of the line in case the new
+	 * text is shorter
+	 */
+	ksnprintf(out, sizeof(out), "\033[1;%uH%s\033[K", first + 1,
+		line + first);
+	viewport_write(&status, out);
+
+	memmove(status_text, line, sizeof(status_text));
+}
+
+/* Which SoC this is, and how long an IPI takes to get to each of the other
+ * cores and back
+ */
+static void print_cores(void)
+{
+	static const char *socs[] = { "BCM2835", "BCM2836", "BCM2837" };
+	unsigned int core;
+
+	kprintf(COLOUR_PUSH FG_CYAN "SoC: %s, CPU part 0x%03X, %u core%s "
+		"running" COLOUR_POP "\n", socs[soc_type()], cpu_part(),
+		smp_core_count, smp_core_count == 1 ? "" : "s");
+
+	for(core=1; core<SMP_MAX_CORES && !cpu_is_arm11(); core++)
+	{
+		if(smp_cores[core].online)
+			kprintf(COLOUR_PUSH FG_CYAN "Core %u: IPI round trip "
+				"%u cycles" COLOUR_POP "\n", core,
+				smp_ipi_round_trip(core));
+		else
+			kprintf(COLOUR_PUSH FG_RED "Core %u didn't start"
+				COLOUR_POP "\n", core);
+	}
+
+	console_write("\n");
+}
+
 /* Data/bss locations in physical RAM */
 extern unsigned int _physdatastart, _physbssstart, _physbssend;
 extern unsigned int _datastart, _bssstart, _bssend;
@@ -153,27 +335,34 @@ extern unsigned int _kstart, _krodata, _kend;
  */
 void main(unsigned int r0, unsigned int machtype, unsigned int atagsaddr)
 {
+	unsigned int main_time = timer_read();
+	unsigned int info[4], stage;
+
 	/* No further need to access kernel code at 0x00000000 - 0x000fffff */
 	initpagetable[0] = 0;
 	/* Flush it out of the TLB */
 	asm volatile("mcr p15, 0, %[data], c8, c7, 1" : : [data] "r" (0x00000000));
 
 	/* Initialise stuff */
-	mem_init();
-	led_init();
-	fb_init();
-	interrupts_init();
+	for(stage=0; stage<BOOT_STAGES; stage++)
+	{
+		boot_stages[stage].init();
+		boot_stage_times[stage] = timer_read();
+	}
 
 	/* Say hello */
 	console_write("Pi-Baremetal booted\n\n");
 
-	console_write(FG_RED "Machine type is 0x");
-	console_write(tohex(machtype, 4));
+	boot_timings(main_time);
 
 	if(machtype == 0xc42)
-		console_write(", a Broadcom BCM2708 (Raspberry Pi)\n\n" FG_WHITE);
+		kprintf(FG_RED "Machine type is 0x%08X, a Broadcom BCM2708 "
+			"(Raspberry Pi)\n\n" FG_WHITE, machtype);
 	else
-		console_write(". Unknown machine type. Good luck!\n\n" FG_WHITE);
+		kprintf(FG_RED "Machine type is 0x%08X. Unknown machine type. "
+			"Good luck!\n\n" FG_WHITE, machtype);
+
+	print_cores();
 
 	/* Read in ATAGS */
 	print_atags(atagsaddr);
@@ -181,44 +370,48 @@ void main(unsigned int r0, unsigned int machtype, unsigned int atagsaddr)
 	/* Read in some system data */
 	mailboxtest();
 
-	/* Test interrupt */
+	/* Test system calls. The unknown one is reported from a task */
 	console_write("\nTest SWI: ");
-	asm volatile("swi #1234");
-
-	console_write(FG_YELLOW "\nKernel starts:         0x");
-	console_write(tohex((unsigned int)&_kstart, 4));
-	console_write(FG_YELLOW "\nKernel read-only data: 0x");
-	console_write(tohex((unsigned int)&_krodata, 4));
-	console_write(FG_YELLOW "\nKernel ends:           0x");
-	console_write(tohex((unsigned int)&_kend, 4));
-
-	console_write(FG_MAGENTA "\n\nKernel data: 0x");
-	console_write(tohex((unsigned int)&_physdatastart, 4));
-	console_write(" - 0x");
-	console_write(tohex((unsigned int)&_physbssstart, 4));
-	console_write(" (physical), 0x");
-	console_write(tohex((unsigned int)&_datastart, 4));
-	console_write(" - 0x");
-	console_write(tohex((unsigned int)&_bssstart, 4));
-	console_write(" (virtual)\nKernel bss:  0x");
-	console_write(tohex((unsigned int)&_physbssstart, 4));
-	console_write(" - 0x");
-	console_write(tohex((unsigned int)&_physbssend, 4));
-	console_write(" (physical), 0x");
-	console_write(tohex((unsigned int)&_bssstart, 4));
-	console_write(" - 0x");
-	console_write(tohex((unsigned int)&_bssend, 4));
-	console_write(" (virtual)\n");
-
-	console_write(BG_WHITE BG_HALF BG_HALF FG_CYAN
+	syscall(SYS_WRITE, (unsigned int)"SYS_WRITE OK");
+	syscall4(SYS_INFO, 0, 0, 0, 0, info);
+	kprintf(", SYS_INFO: SoC %u, %u cores, %u switches\n", info[0],
+		info[1], info[2]);
+	if(syscall(1234, 0) != SYSCALL_ENOSYS)
+		console_write(FG_RED "Unknown system call didn't fail\n" FG_WHITE);
+	task_run_pending();
+
+	kprintf(FG_YELLOW "\nKernel starts:         0x%08X"
+		FG_YELLOW "\nKernel read-only data: 0x%08X"
+		FG_YELLOW "\nKernel ends:           0x%08X",
+		(unsigned int)&_kstart, (unsigned int)&_krodata,
+		(unsigned int)&_kend);
+
+	kprintf(FG_MAGENTA "\n\nKernel data: 0x%08X - 0x%08X (physical), "
+		"0x%08X - 0x%08X (virtual)\n",
+		(unsigned int)&_physdatastart, (unsigned int)&_physbssstart,
+		(unsigned int)&_datastart, (unsigned int)&_bssstart);
+	kprintf("Kernel bss:  0x%08X - 0x%08X (physical), "
+		"0x%08X - 0x%08X (virtual)\n",
+		(unsigned int)&_physbssstart, (unsigned int)&_physbssend,
+		(unsigned int)&_bssstart, (unsigned int)&_bssend);
+
+	/* The aborts below are deliberate. Anything else is a failure, as
+	 * far as "make qemu-bench" is concerned
+	 */
+	uart_write("EXPECT data\n");
+	kprintf(BG_WHITE BG_HALF BG_HALF FG_CYAN
 		"\nKernel code should be read-only, even to privileged CPU modes: "
-		"attempting write to 0x");
-	console_write(tohex((unsigned int)&_kstart, 4));
-	console_write("\n" FG_RED);
+		"attempting write to 0x%08X\n" FG_RED, (unsigned int)&_kstart);
 	_kstart = 1234;
 
 	console_write(FG_WHITE BG_GREEN BG_HALF "\nOK LED flashing under interrupt");
 
+#ifdef BENCHMARK
+	console_write(BG_BLACK "\n");
+	benchmarks();
+#endif
+
+	uart_write("EXPECT prefetch\n");
 	console_write(BG_BLACK FG_YELLOW
 		"\n\nPerforming deliberate prefetch abort (calling non-existent code at 0x02100000): "
 		FG_RED BG_RED BG_HALF);
@@ -231,12 +424,39 @@ void main(unsigned int r0, unsigned int machtype, unsigned int atagsaddr)
 	while(1);
 }
 
+/* Serial port commands, checked for every SERIAL_INTERVAL microseconds:
+ * "t" sends the trace records, and "s" prints the statistics
+ */
+#define SERIAL_INTERVAL	50000
+static struct task_timer serial_timer;
+
+static void serial_poll(void *arg)
+{
+	int ch;
+
+	while((ch = uart_getc()) >= 0)
+	{
+		if(ch == 't')
+			trace_stream();
+		else if(ch == 's')
+			stats_print();
+	}
+}
+
 void main_endloop(void)
 {
 	console_write(FG_WHITE BG_GREEN BG_HALF "\nPrefetch abort done");
-
-	/* Repeatedly halt the CPU and wait for interrupt */
-	while(1)
-		asm volatile("mcr p15,0,r0,c7,c0,4" : : : "r0");
-
+	boot_marker("ready", timer_read());
+
+	/* From here on, everything is done in tasks. The idle thread halts
+	 * the CPU in between
+	 */
+	task_timer_start(&status_timer, status_update, 0, TASK_PRIORITY_LOW,
+		0, STATUS_INTERVAL);
+	task_timer_start(&serial_timer, serial_poll, 0, TASK_PRIORITY_LOW,
+		0, SERIAL_INTERVAL);
+	if(panel_shown)
+		task_timer_start(&panel_timer, panel_update, 0,
+			TASK_PRIORITY_LOW, 0, PANEL_INTERVAL);
+	task_run();
 }
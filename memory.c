@@ -1,11 +1,20 @@
 #include "memory.h"
 
+#include "barrier.h"
+#include "mailbox.h"
+#include "memutils.h"
+#include "soc.h"
+#include "stats.h"
+
 /* Virtual memory layout
  *
  * 0x00000000 - 0x7fffffff (0-2GB) = user process memory
  * 0x80000000 - 0xa0ffffff = physical memory
- * 	includes peripherals at 0x20000000 - 0x20ffffff
- * 0xc0000000 - 0xefffffff = kernel data
+ * 	includes peripherals at 0x20000000 - 0x20ffffff (which are at
+ * 	0x3f000000 on the BCM2836/7, but mapped here all the same)
+ * 0xa1000000 - 0xa10fffff = ARM local peripherals (BCM2836/7 only)
+ * 0xc0000000 - 0xdfffffff = kernel data
+ * 0xe0000000 - 0xefffffff = mapped on request (mem_map/mem_alloc)
  * 0xf0000000 - 0xffffffff = kernel code
  */
 
@@ -14,6 +23,8 @@ static unsigned int *pagetable = (unsigned int * const) mem_p2v(0x4000); /* 16k
 
 /* Last used location in physical RAM */
 extern unsigned int _physbssend;
+/* End of the kernel data page tables, which come after .bss */
+extern unsigned int _physdatatablesend;
 /* Start of kernel in physical RAM */
 extern unsigned int _highkernelload;
 
@@ -76,19 +87,248 @@ unsigned int mem_v2p(unsigned int virtualaddr)
  * the corresponding mapped area of virtual memory (0x80000000-0xa0ffffff)
  */
 
+/* Area of virtual memory used by mem_map() */
+#define MAP_START	0xe0000000
+#define MAP_END		0xf0000000
+
+/* Next free virtual address for mem_map() */
+static unsigned int map_next = MAP_START;
+
+/* Free physical RAM for mem_alloc(), from the first whole megabyte after
+ * the kernel to the end of the ARM's memory
+ */
+static unsigned int phys_next, phys_end;
+
+static struct stat_counter stat_mapped = STAT_COUNTER_INIT("MB mapped");
+static struct stat_counter stat_allocated =
+	STAT_COUNTER_INIT("MB allocated");
+
+/* Ask VideoCore how much memory the ARM has (tag 0x10005). Returns the
+ * address of the end of it, or 0 if the firmware won't say
+ */
+static unsigned int mem_arm_end(void)
+{
+	volatile unsigned int mailbuffer[8] __attribute__((aligned (16)));
+
+	mailbuffer[0] = 8 * 4;		// Total size
+	mailbuffer[1] = 0;		// Request
+	mailbuffer[2] = 0x10005;	// ARM memory
+	mailbuffer[3] = 8;		// Buffer size
+	mailbuffer[4] = 0;		// Request size
+	mailbuffer[5] = 0;		// Space for base address
+	mailbuffer[6] = 0;		// Space for size
+	mailbuffer[7] = 0;		// End tag
+
+	writemailbox(8, mem_v2p((unsigned int)mailbuffer));
+	readmailbox(8);
+
+	if(mailbuffer[1] != 0x80000000)
+		return 0;
+
+	return mailbuffer[5] + mailbuffer[6];
+}
+
+/* Map size bytes of physical memory from physaddr into kernel virtual
+ * memory, using 1MB sections. type is one of the MEM_* memory types
+ * Returns the virtual address corresponding to physaddr, or 0 if there's no
+ * virtual address space left
+ */
+
+void *mem_map(unsigned int physaddr, unsigned int size, unsigned int type)
+{
+	unsigned int base = physaddr & 0xfff00000;
+	unsigned int sections = (physaddr - base + size + 0x000fffff) >> 20;
+	unsigned int virtualaddr = map_next;
+	unsigned int x;
+
+	if(sections > ((MAP_END - map_next) >> 20))
+		return 0;
+
+	map_next += sections << 20;
+	stat_add(&stat_mapped, sections);
+
+	/* With more than one core, cached memory is marked shareable (S, bit
+	 * 16) so that the cores' caches are kept coherent with each other.
+	 * That also needs each core in SMP mode (enable_smp, start.s)
+	 */
+	if(!cpu_is_arm11() && (type & 0x000c))
+		type |= 1<<16;
+
+	/* Read/write for privileged modes only (AP=01), never executable */
+	for(x=0; x<sections; x++)
+		pagetable[(virtualaddr >> 20) + x] =
+			(base + (x << 20)) | type | 0x0410 | 2;
+
+	/* Make sure the table entries have been written before the TLB
+	 * is flushed
+	 */
+	dsb();
+	asm volatile("mcr p15, 0, %[data], c8, c7, 0" : : [data] "r" (0));
+
+	return (void *)(virtualaddr + (physaddr - base));
+}
+
+/* Allocate size bytes of RAM (rounded up to a whole number of megabytes)
+ * and map it into kernel virtual memory. Returns the virtual address, or 0
+ * if there isn't enough memory free. The memory isn't cleared
+ *
+ * Allocations are permanent - there's no mem_free()
+ */
+void *mem_alloc(unsigned int size, unsigned int type)
+{
+	unsigned int physaddr = phys_next;
+	void *virtualaddr;
+
+	size = (size + 0x000fffff) & 0xfff00000;
+
+	if(size == 0 || size > phys_end - phys_next)
+		return 0;
+
+	virtualaddr = mem_map(physaddr, size, type);
+	if(virtualaddr)
+	{
+		phys_next += size;
+		stat_add(&stat_allocated, size >> 20);
+	}
+
+	return virtualaddr;
+}
+
+/* Where mem_alloc_cached() allocates from next, and the end of its
+ * megabyte
+ */
+static unsigned int cached_next, cached_end;
+
+void *mem_alloc_cached(unsigned int size)
+{
+	unsigned int addr;
+
+	size = (size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+
+	if(size > cached_end - cached_next)
+	{
+		if(size > 0x00100000)
+			return 0;
+
+		cached_next = (unsigned int)mem_alloc(0x00100000, MEM_CACHED);
+		if(!cached_next)
+		{
+			cached_end = 0;
+			return 0;
+		}
+		cached_end = cached_next + 0x00100000;
+	}
+
+	addr = cached_next;
+	cached_next += size;
+	memclr((void *)addr, size);
+
+	return (void *)addr;
+}
+
+/* Clean, or clean and invalidate, the whole data cache on ARMv7, where it
+ * has to be done a line at a time by set and way. Every level of cache up
+ * to the level of coherency (where the CPU and everything else see the
+ * same memory) is covered, which includes the shared L2
+ * ARM Architecture Reference Manual ARMv7-A, B4.2.1 and B6.2.1
+ */
+/* Clean the lines holding length bytes from address, by virtual address,
+ * to the point of coherency (DCCMVAC). The line size is the smallest of
+ * any cache's, from the cache type register
+ * ARM Architecture Reference Manual ARMv7-A, B4.2.1 and B6.2.1
+ */
+void cache_v7_clean_range(unsigned int address, unsigned int length)
+{
+	unsigned int ctr, line, end = address + length;
+
+	asm volatile("mrc p15, 0, %[ctr], c0, c0, 1" : [ctr] "=r" (ctr));
+	line = 4 << ((ctr >> 16) & 0xf);
+
+	for(address &= ~(line - 1); address < end; address += line)
+		asm volatile("mcr p15, 0, %[mva], c7, c10, 1"
+			: : [mva] "r" (address));
+
+	dsb();
+}
+
+void cache_v7_all(unsigned int op)
+{
+	unsigned int clidr, ccsidr, levels, level;
+	unsigned int ways, sets, way, set, way_shift, line_shift, setway;
+
+	asm volatile("mrc p15, 1, %[clidr], c0, c0, 1" : [clidr] "=r" (clidr));
+	levels = (clidr >> 24) & 7;
+
+	for(level=0; level<levels; level++)
+	{
+		/* Cache type 2 and over have data (or unified) caches */
+		if(((clidr >> (level * 3)) & 7) < 2)
+			continue;
+
+		/* Select the level's data cache, and read its geometry */
+		asm volatile("mcr p15, 2, %[sel], c0, c0, 0"
+			: : [sel] "r" (level << 1));
+		asm volatile("mcr p15, 0, %[zero], c7, c5, 4"
+			: : [zero] "r" (0));
+		asm volatile("mrc p15, 1, %[ccsidr], c0, c0, 0"
+			: [ccsidr] "=r" (ccsidr));
+
+		line_shift = (ccsidr & 7) + 4;
+		ways = ((ccsidr >> 3) & 0x3ff) + 1;
+		sets = ((ccsidr >> 13) & 0x7fff) + 1;
+		/* The way number goes in the top bits */
+		way_shift = ways > 1 ? __builtin_clz(ways - 1) : 0;
+
+		for(way=0; way<ways; way++)
+		{
+			for(set=0; set<sets; set++)
+			{
+				setway = (way << way_shift) |
+					(set << line_shift) | (level << 1);
+
+				if(op == CACHE_CLEAN)
+					asm volatile("mcr p15, 0, %[sw], c7, c10, 2"
+						: : [sw] "r" (setway));
+				else
+					asm volatile("mcr p15, 0, %[sw], c7, c14, 2"
+						: : [sw] "r" (setway));
+			}
+		}
+	}
+
+	dsb();
+}
+
 /* Translation table 0 - covers the first 64 MB, for now
  * Needs to be aligned to its size (ie 64*4 bytes)
  */
 unsigned int pagetable0[64]	__attribute__ ((aligned (256)));
 
+/* Switch this core to pagetable0 for the bottom 64MB */
+void mem_init_core(void)
+{
+	/* Get physical address of pagetable0 */
+	unsigned int pt0_addr = mem_v2p((unsigned int) &pagetable0);
+
+	/* Use translation table 0 up to 64MB */
+	asm volatile("mcr p15, 0, %[n], c2, c0, 2" : : [n] "r" (6));
+	/* Translation table 0 - ARM1176JZF-S manual, 3-57 */
+	asm volatile("mcr p15, 0, %[addr], c2, c0, 0" : : [addr] "r" (pt0_addr));
+	/* Invalidate the translation lookaside buffer (TLB)
+	 * ARM1176JZF-S manual, p. 3-86
+	 */
+	asm volatile("mcr p15, 0, %[data], c8, c7, 0" : : [data] "r" (0));
+}
+
 /* Initialise memory - actually, there's not much to do now, since initsys
  * covers most of it. It just sets up a pagetable for the first 64MB of RAM
- * (all unmapped)
+ * (all unmapped), finds the free RAM for mem_alloc() and turns on the data
+ * cache
  */
 void mem_init(void)
 {
 	unsigned int x;
-	unsigned int pt0_addr;
+	unsigned int control;
 
 	/* Translation table 0 - covers the first 64 MB, for now
 	 * Currently nothing mapped in it.
@@ -98,15 +338,31 @@ void mem_init(void)
 		pagetable0[x] = 0;
 	}
 
-	/* Get physical address of pagetable0 */
-	pt0_addr = mem_v2p((unsigned int) &pagetable0);
+	mem_init_core();
 
-	/* Use translation table 0 up to 64MB */
-	asm volatile("mcr p15, 0, %[n], c2, c0, 2" : : [n] "r" (6));
-	/* Translation table 0 - ARM1176JZF-S manual, 3-57 */
-	asm volatile("mcr p15, 0, %[addr], c2, c0, 0" : : [addr] "r" (pt0_addr));
-	/* Invalidate the translation lookaside buffer (TLB)
-	 * ARM1176JZF-S manual, p. 3-86
+	/* RAM after the kernel (its data page tables are the last thing in
+	 * memory) is free for mem_alloc()
 	 */
-	asm volatile("mcr p15, 0, %[data], c8, c7, 0" : : [data] "r" (0));
+	phys_next = ((unsigned int)&_physdatatablesend + 0x000fffff) & 0xfff00000;
+	phys_end = mem_arm_end();
+	if(phys_end < phys_next)
+		phys_end = phys_next;
+
+	stat_register_counter(&stat_mapped);
+	stat_register_counter(&stat_allocated);
+
+	/* Invalidate and turn on the data cache. It is only used by memory
+	 * mapped as MEM_CACHED - everything initsys mapped is strongly
+	 * ordered, so isn't cached
+	 * ARM1176JZF-S manual, 3-44 and 3-74
+	 *
+	 * The Cortex-A7 and A53 invalidate their caches at reset, and have
+	 * no single operation to do it
+	 */
+	if(cpu_is_arm11())
+		asm volatile("mcr p15, 0, %[zero], c7, c6, 0"
+			: : [zero] "r" (0));
+	asm volatile("mrc p15, 0, %[control], c1, c0, 0" : [control] "=r" (control));
+	control |= (1<<2);
+	asm volatile("mcr p15, 0, %[control], c1, c0, 0" : : [control] "r" (control));
 }
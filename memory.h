@@ -9,8 +9,54 @@ extern unsigned int mem_v2p(unsigned int);
 /* Convert a physical address to a virtual one - essentially, just add
  * 0x80000000 to it
  */
-#define mem_p2v(X) (X+0x80000000)
+#define mem_p2v(X) ((X)+0x80000000)
 
 extern void mem_init(void);
 
+/* Set up the MMU on cores 1-3 (smp.c) as mem_init() did on core 0 */
+extern void mem_init_core(void);
+
+/* Memory types for mem_map()/mem_alloc() - the TEX/C/B bits of a section
+ * descriptor. See ARM1176JZF-S manual, 6-15
+ *
+ * MEM_STRONGLY_ORDERED - uncached, unbuffered, every access in order (as
+ *	the physical memory window at 0x80000000)
+ * MEM_NONCACHED - normal memory, uncached, but writes are buffered and can
+ *	be merged into bursts. Good for the framebuffer
+ * MEM_CACHED - write-back, write-allocate cached. Anything else reading the
+ *	memory (DMA, VideoCore) needs the data cache cleaning first. On the
+ *	quad-core SoCs, mem_map() also makes it shareable, so it's coherent
+ *	between the cores
+ */
+#define MEM_STRONGLY_ORDERED	0x0000
+#define MEM_NONCACHED		0x1000
+#define MEM_CACHED		0x100c
+
+/* Map physical memory into kernel virtual memory. Returns the virtual
+ * address of physaddr, or 0 on failure
+ */
+extern void *mem_map(unsigned int physaddr, unsigned int size,
+	unsigned int type);
+
+/* Allocate and map RAM, in whole megabytes. Returns the virtual address,
+ * or 0 if there isn't enough free
+ */
+extern void *mem_alloc(unsigned int size, unsigned int type);
+
+/* Largest cache line of any of the CPUs (the Cortex-A7/A53's; the ARM1176's
+ * are 32 bytes). Data written by different cores, or by an interrupt
+ * handler and a thread, goes in different lines so they don't fight over
+ * one
+ */
+#define CACHE_LINE_SIZE	64
+#define CACHE_ALIGNED	__attribute__((aligned (CACHE_LINE_SIZE)))
+
+/* Allocate size bytes of cleared, cached memory, aligned to a cache line,
+ * from a megabyte at a time. For small structures that need cached memory:
+ * anything changed with the atomic operations in atomic.h, which don't
+ * work on strongly ordered memory (such as the kernel's own data) on the
+ * quad-core SoCs
+ */
+extern void *mem_alloc_cached(unsigned int size);
+
 #endif /* MEMORY_H */
@@ -29,9 +29,9 @@ void memclr(void *address, unsigned int length)
 	/* Deal with the remaining 1-3 bytes, if any */
 	while(length)
 	{
+		*((unsigned char *)addr) = 0;
 		addr++;
 		length--;
-		*((unsigned char *)addr) = 0;
 	}
 }
 	
@@ -85,7 +85,7 @@ void *memmove(void *dest, const void *src, unsigned int length)
 		while(length)
 		{
 			length-=4;
-			*((unsigned int *)d+length) = *((unsigned int *)s+length);
+			*(unsigned int *)(d+length) = *(unsigned int *)(s+length);
 		}
 	}
 	else
@@ -117,3 +117,99 @@ void *memmove(void *dest, const void *src, unsigned int length)
 
 	return dest;
 }
+
+/* Copy length bytes from src to dest in 8 word blocks, then words, then
+ * bytes. dest and src must be word aligned and not overlap
+ */
+void memcpy_burst(void *dest, const void *src, unsigned int length)
+{
+	register unsigned int d = (unsigned int)dest;
+	register unsigned int s = (unsigned int)src;
+
+	while(length >= 32)
+	{
+#ifdef HOST
+		unsigned int word;
+
+		for(word=0; word<8; word++)
+			((unsigned int *)d)[word] = ((unsigned int *)s)[word];
+		d += 32;
+		s += 32;
+#else
+		asm volatile("ldmia %[s]!, {r3-r10}\n"
+			"stmia %[d]!, {r3-r10}"
+			: [s] "+r" (s), [d] "+r" (d)
+			:
+			: "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10",
+				"memory");
+#endif
+		length -= 32;
+	}
+
+	while(length >= 4)
+	{
+		*((unsigned int *)d) = *((unsigned int *)s);
+		d+=4;
+		s+=4;
+		length-=4;
+	}
+
+	while(length)
+	{
+		*((unsigned char *)d) = *((unsigned char *)s);
+		d++;
+		s++;
+		length--;
+	}
+}
+
+/* Fill count words with value, 8 words at a time, then the remainder one
+ * at a time. dest must be word aligned
+ */
+void memfill32(void *dest, unsigned int value, unsigned int count)
+{
+	register unsigned int d = (unsigned int)dest;
+
+#ifdef HOST
+	while(count >= 8)
+	{
+		((unsigned int *)d)[0] = value;
+		((unsigned int *)d)[1] = value;
+		((unsigned int *)d)[2] = value;
+		((unsigned int *)d)[3] = value;
+		((unsigned int *)d)[4] = value;
+		((unsigned int *)d)[5] = value;
+		((unsigned int *)d)[6] = value;
+		((unsigned int *)d)[7] = value;
+		d += 32;
+		count -= 8;
+	}
+#else
+	if(count >= 8)
+	{
+		asm volatile("mov r3, %[v]\n"
+			"mov r4, %[v]\n"
+			"mov r5, %[v]\n"
+			"mov r6, %[v]\n"
+			"mov r7, %[v]\n"
+			"mov r8, %[v]\n"
+			"mov r9, %[v]\n"
+			"mov r10, %[v]\n"
+			"1:\n"
+			"stmia %[d]!, {r3-r10}\n"
+			"sub %[n], %[n], #8\n"
+			"cmp %[n], #8\n"
+			"bhs 1b"
+			: [d] "+r" (d), [n] "+r" (count)
+			: [v] "r" (value)
+			: "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10",
+				"cc", "memory");
+	}
+#endif
+
+	while(count--)
+	{
+		*((unsigned int *)d) = value;
+		d+=4;
+	}
+}
@@ -7,4 +7,15 @@ extern void memclr(void *address, unsigned int length);
 /* Move length bytes from src to dest. Memory areas may overlap */
 extern void *memmove(void *dest, const void *src, unsigned int length);
 
+/* Copy length bytes from src to dest, 32 bytes at a time with LDM/STM so
+ * that the writes go out as bursts. Both addresses must be word aligned,
+ * and the areas must not overlap
+ */
+extern void memcpy_burst(void *dest, const void *src, unsigned int length);
+
+/* Fill count words from dest (which must be word aligned) with value,
+ * using 8-word STM bursts
+ */
+extern void memfill32(void *dest, unsigned int value, unsigned int count);
+
 #endif	/* MEMUTILS_H */
@@ -0,0 +1,329 @@
+/* RGB565 colour operations
+ *
+ * A word holds two RGB565 pixels, but the components don't line up with
+ * the bytes the ARMv6 SIMD instructions work on. So each word is split into
+ * two: one with the red and blue of both pixels, and one with the greens,
+ * each component moved to the top of its own byte:
+ *
+ *	pixels	RRRRRGGG GGGBBBBB RRRRRGGG GGGBBBBB
+ *	rb	RRRRR... BBBBB... RRRRR... BBBBB...
+ *	g	........ GGGGGG.. ........ GGGGGG..
+ *
+ * Byte operations then work on all the components of both pixels at once.
+ * Byte saturation (UQADD8) saturates the component, and halving adds
+ * (UHADD8) drop the right bit - whatever lands in the spare bits below each
+ * component is masked off when the words are packed back together
+ */
+
+#include "rgb565.h"
+
+#include "gfx.h"
+#include "memutils.h"
+
+/* ARMv6 SIMD instructions */
+static inline unsigned int uqadd8(unsigned int a, unsigned int b)
+{
+	unsigned int result;
+
+	asm("uqadd8 %[r], %[a], %[b]" : [r] "=r" (result) : [a] "r" (a),
+		[b] "r" (b));
+
+	return result;
+}
+
+static inline unsigned int uhadd8(unsigned int a, unsigned int b)
+{
+	unsigned int result;
+
+	asm("uhadd8 %[r], %[a], %[b]" : [r] "=r" (result) : [a] "r" (a),
+		[b] "r" (b));
+
+	return result;
+}
+
+/* Bottom half of a, bottom half of b in the top half */
+static inline unsigned int pkhbt(unsigned int a, unsigned int b)
+{
+	unsigned int result;
+
+	asm("pkhbt %[r], %[a], %[b], lsl #16" : [r] "=r" (result)
+		: [a] "r" (a), [b] "r" (b));
+
+	return result;
+}
+
+/* Top half of a, top half of b in the bottom half */
+static inline unsigned int pkhtb(unsigned int a, unsigned int b)
+{
+	unsigned int result;
+
+	asm("pkhtb %[r], %[a], %[b], asr #16" : [r] "=r" (result)
+		: [a] "r" (a), [b] "r" (b));
+
+	return result;
+}
+
+/* Split two pixels into components at the top of each byte, and back */
+#define SPLIT_RB(w)	(((w) & 0xf800f800) | (((w) << 3) & 0x00f800f8))
+#define SPLIT_G(w)	(((w) >> 3) & 0x00fc00fc)
+#define PACK(rb, g)	(((rb) & 0xf800f800) | (((rb) >> 3) & 0x001f001f) | \
+			(((g) << 3) & 0x07e007e0))
+
+/* Two pixels at once. Anything in the top half of a word only affects the
+ * top half of the result, so the same operations do single pixels
+ */
+static inline unsigned int dim2(unsigned int d, unsigned int s)
+{
+	return (s >> 1) & 0x7bef7bef;
+}
+
+static inline unsigned int add2(unsigned int d, unsigned int s)
+{
+	return PACK(uqadd8(SPLIT_RB(d), SPLIT_RB(s)),
+		uqadd8(SPLIT_G(d), SPLIT_G(s)));
+}
+
+static inline unsigned int average2(unsigned int d, unsigned int s)
+{
+	return PACK(uhadd8(SPLIT_RB(d), SPLIT_RB(s)),
+		uhadd8(SPLIT_G(d), SPLIT_G(s)));
+}
+
+/* Blending needs multiplies, which don't split into bytes. One pixel at a
+ * time is spread out over a word (green moved to the top half) so that each
+ * component has five spare bits above it for the products
+ */
+static inline unsigned int blend1(unsigned int d, unsigned int s,
+	unsigned int alpha)
+{
+	d = (d | (d << 16)) & 0x07e0f81f;
+	s = (s | (s << 16)) & 0x07e0f81f;
+
+	d = ((s * alpha + d * (32 - alpha)) >> 5) & 0x07e0f81f;
+
+	return d | (d >> 16);
+}
+
+static inline unsigned int blend2(unsigned int d, unsigned int s,
+	unsigned int alpha)
+{
+	return pkhbt(blend1(d & 0xffff, s & 0xffff, alpha),
+		blend1(d >> 16, s >> 16, alpha));
+}
+
+/* Run OP over count pixels: one pixel to get dest and src word aligned, then
+ * pairs of pixels, then the one left over. If dest and src can't both be
+ * aligned, everything is done a pixel at a time
+ */
+#define RUN(dest, src, count, OP, ...)					\
+	do								\
+	{								\
+		if(((unsigned int)(dest) ^ (unsigned int)(src)) & 2)	\
+		{							\
+			while(count--)					\
+			{						\
+				*dest = OP(*dest, *src, ##__VA_ARGS__);	\
+				dest++;					\
+				src++;					\
+			}						\
+			break;						\
+		}							\
+									\
+		if(((unsigned int)(dest) & 2) && count)			\
+		{							\
+			*dest = OP(*dest, *src, ##__VA_ARGS__);		\
+			dest++;						\
+			src++;						\
+			count--;					\
+		}							\
+									\
+		for(; count >= 2; count -= 2)				\
+		{							\
+			*(unsigned int *)dest = OP(*(unsigned int *)dest, \
+				*(const unsigned int *)src, ##__VA_ARGS__); \
+			dest += 2;					\
+			src += 2;					\
+		}							\
+									\
+		if(count)						\
+			*dest = OP(*dest, *src, ##__VA_ARGS__);		\
+	} while(0)
+
+void rgb565_dim(unsigned short int *dest, const unsigned short int *src,
+	unsigned int count)
+{
+	RUN(dest, src, count, dim2);
+}
+
+void rgb565_add(unsigned short int *dest, const unsigned short int *src,
+	unsigned int count)
+{
+	RUN(dest, src, count, add2);
+}
+
+void rgb565_blend(unsigned short int *dest, const unsigned short int *src,
+	unsigned int count, unsigned int alpha)
+{
+	if(alpha == 0)
+		return;
+
+	if(alpha >= 32)
+	{
+		memmove(dest, src, count * 2);
+		return;
+	}
+
+	/* Half and half is a halving add */
+	if(alpha == 16)
+	{
+		RUN(dest, src, count, average2);
+		return;
+	}
+
+	RUN(dest, src, count, blend2, alpha);
+}
+
+/* Expand two pixels. Each component is at the top of its byte after
+ * splitting, so the top bits just need copying down. Then the halfword packs
+ * put blue and green beside red
+ */
+static inline void expand2(unsigned int *dest, unsigned int w)
+{
+	unsigned int rb = SPLIT_RB(w);
+	unsigned int g = SPLIT_G(w);
+	unsigned int bg, r;
+
+	rb |= (rb >> 5) & 0x07070707;
+	g |= (g >> 6) & 0x03030303;
+
+	bg = (rb & 0x00ff00ff) | (g << 8);
+	r = (rb >> 8) & 0x00ff00ff;
+
+	dest[0] = pkhbt(bg, r);
+	dest[1] = pkhtb(r, bg);
+}
+
+void rgb565_to_rgb888(unsigned int *dest, const unsigned short int *src,
+	unsigned int count)
+{
+	unsigned int pair[2];
+
+	if(((unsigned int)src & 2) && count)
+	{
+		expand2(pair, *src++);
+		*dest++ = pair[0];
+		count--;
+	}
+
+	for(; count >= 2; count -= 2)
+	{
+		expand2(dest, *(const unsigned int *)src);
+		dest += 2;
+		src += 2;
+	}
+
+	if(count)
+	{
+		expand2(pair, *src);
+		*dest = pair[0];
+	}
+}
+
+/* Reduce two pixels: the halfword packs put the blues and greens of both
+ * pixels in one word, and the reds in another
+ */
+static inline unsigned int reduce2(unsigned int p0, unsigned int p1)
+{
+	unsigned int bg = pkhbt(p0, p1);
+	unsigned int r = pkhtb(p1, p0);
+
+	return ((bg >> 3) & 0x001f001f) | ((bg >> 5) & 0x07e007e0) |
+		((r << 8) & 0xf800f800);
+}
+
+void rgb888_to_rgb565(unsigned short int *dest, const unsigned int *src,
+	unsigned int count)
+{
+	if(((unsigned int)dest & 2) && count)
+	{
+		*dest++ = reduce2(*src++, 0);
+		count--;
+	}
+
+	for(; count >= 2; count -= 2)
+	{
+		*(unsigned int *)dest = reduce2(src[0], src[1]);
+		dest += 2;
+		src += 2;
+	}
+
+	if(count)
+		*dest = reduce2(*src, 0);
+}
+
+/* Reference versions */
+
+#define RED(c)		((c) >> 11)
+#define GREEN(c)	(((c) >> 5) & 0x3f)
+#define BLUE(c)		((c) & 0x1f)
+#define RGB(r, g, b)	(((r) << 11) | ((g) << 5) | (b))
+
+void rgb565_dim_ref(unsigned short int *dest, const unsigned short int *src,
+	unsigned int count)
+{
+	while(count--)
+	{
+		*dest++ = RGB(RED(*src) >> 1, GREEN(*src) >> 1, BLUE(*src) >> 1);
+		src++;
+	}
+}
+
+void rgb565_blend_ref(unsigned short int *dest, const unsigned short int *src,
+	unsigned int count, unsigned int alpha)
+{
+	unsigned int d, s;
+
+	if(alpha > 32)
+		alpha = 32;
+
+	while(count--)
+	{
+		d = *dest;
+		s = *src++;
+
+		*dest++ = RGB((RED(s) * alpha + RED(d) * (32 - alpha)) >> 5,
+			(GREEN(s) * alpha + GREEN(d) * (32 - alpha)) >> 5,
+			(BLUE(s) * alpha + BLUE(d) * (32 - alpha)) >> 5);
+	}
+}
+
+void rgb565_add_ref(unsigned short int *dest, const unsigned short int *src,
+	unsigned int count)
+{
+	unsigned int r, g, b;
+
+	while(count--)
+	{
+		r = RED(*dest) + RED(*src);
+		g = GREEN(*dest) + GREEN(*src);
+		b = BLUE(*dest) + BLUE(*src);
+		src++;
+
+		*dest++ = RGB(r > 0x1f ? 0x1f : r, g > 0x3f ? 0x3f : g,
+			b > 0x1f ? 0x1f : b);
+	}
+}
+
+void rgb565_to_rgb888_ref(unsigned int *dest, const unsigned short int *src,
+	unsigned int count)
+{
+	while(count--)
+		*dest++ = gfx_rgb565_to_rgb(*src++);
+}
+
+void rgb888_to_rgb565_ref(unsigned short int *dest, const unsigned int *src,
+	unsigned int count)
+{
+	while(count--)
+		*dest++ = gfx_rgb_to_rgb565(*src++);
+}
@@ -0,0 +1,49 @@
+#ifndef RGB565_H
+#define RGB565_H
+
+/* Colour operations on runs of RGB565 pixels, two pixels at a time using
+ * the ARMv6 SIMD instructions
+ *
+ * dest and src may be the same run. Runs work fastest when dest and src
+ * have the same alignment (both start on a word boundary, or both don't);
+ * otherwise they're done a pixel at a time
+ *
+ * Each function has a _ref version: plain C, one component at a time. They
+ * give identical results, and are there to check the fast versions against
+ */
+
+/* Halve the brightness of count pixels */
+extern void rgb565_dim(unsigned short int *dest, const unsigned short int *src,
+	unsigned int count);
+
+/* Blend count pixels of src over dest. alpha is 0 (dest unchanged) to 32
+ * (src copied), and each component becomes
+ * (src * alpha + dest * (32 - alpha)) / 32, rounded down
+ */
+extern void rgb565_blend(unsigned short int *dest,
+	const unsigned short int *src, unsigned int count, unsigned int alpha);
+
+/* Add src to dest, each component saturating at full brightness */
+extern void rgb565_add(unsigned short int *dest, const unsigned short int *src,
+	unsigned int count);
+
+/* Convert between RGB565 and 0xRRGGBB. Expanding repeats the top bits of
+ * each component into the bottom ones, as gfx_rgb565_to_rgb() does
+ */
+extern void rgb565_to_rgb888(unsigned int *dest, const unsigned short int *src,
+	unsigned int count);
+extern void rgb888_to_rgb565(unsigned short int *dest, const unsigned int *src,
+	unsigned int count);
+
+extern void rgb565_dim_ref(unsigned short int *dest,
+	const unsigned short int *src, unsigned int count);
+extern void rgb565_blend_ref(unsigned short int *dest,
+	const unsigned short int *src, unsigned int count, unsigned int alpha);
+extern void rgb565_add_ref(unsigned short int *dest,
+	const unsigned short int *src, unsigned int count);
+extern void rgb565_to_rgb888_ref(unsigned int *dest,
+	const unsigned short int *src, unsigned int count);
+extern void rgb888_to_rgb565_ref(unsigned short int *dest,
+	const unsigned int *src, unsigned int count);
+
+#endif	/* RGB565_H */
@@ -0,0 +1,169 @@
+#ifndef RING_H
+#define RING_H
+
+/* Lock-free ring buffers
+ *
+ * Both kinds have a power of 2 number of slots. Positions count up for
+ * ever and are masked to find the slot, so a ring is full when the head is
+ * a whole lap ahead of the tail, and no slot is wasted telling full from
+ * empty. The producers' and consumer's positions are in separate cache
+ * lines. Nothing here waits: a put into a full ring, or a get from an
+ * empty one, returns 0 straight away
+ *
+ * spsc_ring - one producer and one consumer, say an interrupt handler and
+ *	a thread. Needs no atomic operations, only barriers, and holds a word
+ *	per slot
+ * mpsc_ring - any number of producers, one consumer. A producer claims a
+ *	position by moving the head on with atomic_cas(), fills in the slot,
+ *	and then publishes it; a producer interrupted part way doesn't hold
+ *	up any other, only the consumer when it gets that far. The entries
+ *	are in the caller's own array, indexed by slot, so they can be any
+ *	size. Being changed with atomic_cas(), it must be in cached memory
+ *	(mem_alloc_cached())
+ */
+
+#include "atomic.h"
+#include "barrier.h"
+#include "memory.h"
+
+struct spsc_ring
+{
+	volatile unsigned int head CACHE_ALIGNED;	/* Next to put */
+	volatile unsigned int tail CACHE_ALIGNED;	/* Next to get */
+	unsigned int mask CACHE_ALIGNED;
+	unsigned int *entries;
+};
+
+/* size entries, which must be a power of 2 */
+static inline void spsc_init(struct spsc_ring *ring, unsigned int *entries,
+	unsigned int size)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->mask = size - 1;
+	ring->entries = entries;
+}
+
+static inline unsigned int spsc_put(struct spsc_ring *ring,
+	unsigned int value)
+{
+	unsigned int head = ring->head;
+
+	if(head - ring->tail > ring->mask)
+		return 0;
+
+	ring->entries[head & ring->mask] = value;
+	/* The entry has to be there before the consumer can see it */
+	dmb();
+	ring->head = head + 1;
+
+	return 1;
+}
+
+static inline unsigned int spsc_get(struct spsc_ring *ring,
+	unsigned int *value)
+{
+	unsigned int tail = ring->tail;
+
+	if(ring->head == tail)
+		return 0;
+
+	dmb();
+	*value = ring->entries[tail & ring->mask];
+	/* Finished with the entry before the producer can reuse it */
+	dmb();
+	ring->tail = tail + 1;
+
+	return 1;
+}
+
+struct mpsc_ring
+{
+	volatile unsigned int head CACHE_ALIGNED;	/* Next to claim */
+	unsigned int tail CACHE_ALIGNED;		/* Next to take */
+	unsigned int mask CACHE_ALIGNED;
+	/* Slot n is free for the producer at position p when its sequence
+	 * is p, and published when it's p + 1
+	 */
+	volatile unsigned int *sequence;
+};
+
+/* sequence has size words, which must be a power of 2 */
+static inline void mpsc_init(struct mpsc_ring *ring,
+	volatile unsigned int *sequence, unsigned int size)
+{
+	unsigned int n;
+
+	for(n=0; n<size; n++)
+		sequence[n] = n;
+
+	ring->head = 0;
+	ring->tail = 0;
+	ring->mask = size - 1;
+	ring->sequence = sequence;
+}
+
+/* Claim a position for the caller to fill in slot (*position & mask) and
+ * then publish. Returns 0 if the ring is full
+ */
+static inline unsigned int mpsc_claim(struct mpsc_ring *ring,
+	unsigned int *position)
+{
+	unsigned int head, sequence;
+
+	while(1)
+	{
+		head = ring->head;
+		sequence = ring->sequence[head & ring->mask];
+
+		/* Not taken yet, from a lap ago */
+		if((int)(sequence - head) < 0)
+			return 0;
+
+		/* Free, and this producer got it first */
+		if(sequence == head &&
+			atomic_cas(&ring->head, head, head + 1) == head)
+			break;
+
+		/* Another producer claimed it first: try the next */
+	}
+
+	*position = head;
+
+	return 1;
+}
+
+static inline void mpsc_publish(struct mpsc_ring *ring, unsigned int position)
+{
+	dmb();
+	ring->sequence[position & ring->mask] = position + 1;
+}
+
+/* If the next position is published, set *slot to its slot and return 1.
+ * Consumer only
+ */
+static inline unsigned int mpsc_peek(struct mpsc_ring *ring,
+	unsigned int *slot)
+{
+	unsigned int tail = ring->tail;
+
+	if(ring->sequence[tail & ring->mask] != tail + 1)
+		return 0;
+
+	dmb();
+	*slot = tail & ring->mask;
+
+	return 1;
+}
+
+/* Free the slot mpsc_peek() returned, for a producer a lap from now */
+static inline void mpsc_release(struct mpsc_ring *ring)
+{
+	unsigned int tail = ring->tail;
+
+	dmb();
+	ring->sequence[tail & ring->mask] = tail + ring->mask + 1;
+	ring->tail = tail + 1;
+}
+
+#endif	/* RING_H */
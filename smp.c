@@ -0,0 +1,236 @@
+/* Multiple cores, on the BCM2836/7
+ *
+ * The ARM local peripherals are described in "Quad-A7 control" (the
+ * BCM2836 ARM-local peripherals document). Each core has four mailboxes:
+ * 32 bit registers where writing to one address sets bits, and writing to
+ * another clears them. A core gets an interrupt whenever one of its
+ * mailboxes with interrupts enabled is non-zero
+ */
+
+#include "smp.h"
+
+#include "barrier.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "soc.h"
+#include "timer.h"
+
+/* Mailbox interrupt control, one per core */
+static volatile unsigned int *localMailboxControl =
+	(unsigned int *) soc_local(0x40000050);
+/* Mailboxes, 4 per core: write to set bits, and read/write to clear */
+static volatile unsigned int *localMailboxSet =
+	(unsigned int *) soc_local(0x40000080);
+static volatile unsigned int *localMailboxClear =
+	(unsigned int *) soc_local(0x400000c0);
+
+#define MAILBOX(core, n)	((core) * 4 + (n))
+
+/* Location of the initial page table in RAM */
+static unsigned int *initpagetable = (unsigned int *) mem_p2v(0x4000);
+
+/* In start.s. smp_boot is in the .init section, so is only writable
+ * through the physical memory mapping
+ */
+extern void _start_secondary(void);
+extern unsigned int smp_boot;
+
+struct smp_boot
+{
+	unsigned int control;
+	unsigned int stack;
+	void (*main)(unsigned int core);
+};
+
+/* Each core's mode stacks, 8K in all: system, IRQ, abort and SVC, as core
+ * 0's are (start.s). Core 0 doesn't use its set
+ */
+#define SMP_STACK_SIZE	0x2000
+
+static unsigned int smp_stacks[SMP_MAX_CORES][SMP_STACK_SIZE / 4]
+	__attribute__((aligned (8)));
+
+struct smp_core smp_cores[SMP_MAX_CORES];
+unsigned int smp_core_count;
+
+static void (*ipi_handlers[IPI_COUNT])(void);
+
+/* How long to wait for a core to start, in microseconds */
+#define SMP_START_TIMEOUT	100000
+
+static inline void set_this(struct smp_core *core)
+{
+	asm volatile("mcr p15, 0, %[core], c13, c0, 4" : : [core] "r" (core));
+}
+
+void smp_ipi_register(unsigned int ipi, void (*handler)(void))
+{
+	if(ipi < IPI_COUNT)
+		ipi_handlers[ipi] = handler;
+}
+
+void smp_send_ipi(unsigned int core, unsigned int ipi)
+{
+	/* Make sure anything the IPI is about has been written first */
+	dsb();
+	localMailboxSet[MAILBOX(core, 0)] = 1<<ipi;
+}
+
+void smp_ipi_irq(void)
+{
+	struct smp_core *this = smp_this();
+	unsigned int pending, bit;
+
+	pending = localMailboxClear[MAILBOX(this->id, 0)];
+	if(!pending)
+		return;
+
+	/* Clear them before handling them, so an IPI sent while the handler
+	 * is running isn't lost
+	 */
+	localMailboxClear[MAILBOX(this->id, 0)] = pending;
+	this->ipis++;
+
+	while(pending)
+	{
+		bit = 31 - __builtin_clz(pending);
+		pending &= ~(1<<bit);
+
+		if(ipi_handlers[bit])
+			ipi_handlers[bit]();
+	}
+}
+
+/* IPI_CALL handler */
+static void ipi_call(void)
+{
+	struct smp_core *this = smp_this();
+	void (*fn)(unsigned int) = this->call;
+
+	if(!fn)
+		return;
+
+	fn(this->call_arg);
+	this->call = 0;
+}
+
+/* Only one core (core 0, for now) may call this at a time for each target
+ * core: the wait and the setting of call aren't atomic
+ */
+void smp_call(unsigned int core, void (*fn)(unsigned int arg),
+	unsigned int arg)
+{
+	struct smp_core *target = &smp_cores[core];
+
+	while(target->call);
+
+	target->call_arg = arg;
+	target->call = fn;
+	smp_send_ipi(core, IPI_CALL);
+}
+
+/* Kernel data isn't cached, so the other core's write is seen straight
+ * away
+ */
+static volatile unsigned int pong;
+
+static void ipi_pong(unsigned int arg)
+{
+	pong = arg;
+}
+
+unsigned int smp_ipi_round_trip(unsigned int core)
+{
+	unsigned int start, cycles;
+
+	if(core >= SMP_MAX_CORES || !smp_cores[core].online ||
+		core == smp_this()->id)
+		return 0;
+
+	pong = 0;
+	start = cycles_read();
+	smp_call(core, ipi_pong, core + 1);
+	while(pong != core + 1);
+	cycles = cycles_read() - start;
+
+	return cycles;
+}
+
+/* Cores 1-3 start here, from _start_secondary (start.s), on their own
+ * stacks and with the MMU on
+ */
+void smp_secondary_main(unsigned int core)
+{
+	struct smp_core *this = &smp_cores[core];
+
+	set_this(this);
+	mem_init_core();
+	cycles_init();
+
+	localMailboxControl[core] = 1;
+	interrupts_init_core();
+
+	this->online = 1;
+
+	while(1)
+		cpu_wait();
+}
+
+void smp_init(void)
+{
+	volatile struct smp_boot *boot =
+		(struct smp_boot *) mem_p2v((unsigned int)&smp_boot);
+	unsigned int core, control, start;
+
+	smp_cores[0].id = 0;
+	smp_cores[0].online = 1;
+	set_this(&smp_cores[0]);
+	smp_core_count = 1;
+
+	/* For timing IPIs, tasks and trace records */
+	cycles_init();
+
+	if(cpu_is_arm11())
+		return;
+
+	smp_ipi_register(IPI_CALL, ipi_call);
+
+	/* The other cores can interrupt this one */
+	localMailboxControl[0] = 1;
+
+	/* The new cores turn on the MMU while running from physical
+	 * addresses, so the first megabyte needs mapping again for now, as
+	 * initsys had it
+	 */
+	initpagetable[0] = 0<<20 | 0x0400 | 2;
+	dsb();
+	asm volatile("mcr p15, 0, %[data], c8, c7, 1" : : [data] "r" (0x00000000));
+
+	asm volatile("mrc p15, 0, %[control], c1, c0, 0" : [control] "=r" (control));
+	boot->control = control;
+	boot->main = smp_secondary_main;
+
+	for(core=1; core<SMP_MAX_CORES; core++)
+	{
+		smp_cores[core].id = core;
+		boot->stack = (unsigned int)&smp_stacks[core][SMP_STACK_SIZE / 4];
+
+		/* smp_boot has to be in memory before the core reads it. The
+		 * SEV wakes the firmware's loop, which waits with WFE
+		 */
+		dsb();
+		localMailboxSet[MAILBOX(core, 3)] = (unsigned int)&_start_secondary;
+		asm volatile("sev");
+
+		start = timer_read();
+		while(!smp_cores[core].online &&
+			timer_read() - start < SMP_START_TIMEOUT);
+
+		if(smp_cores[core].online)
+			smp_core_count++;
+	}
+
+	initpagetable[0] = 0;
+	dsb();
+	asm volatile("mcr p15, 0, %[data], c8, c7, 1" : : [data] "r" (0x00000000));
+}
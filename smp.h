@@ -0,0 +1,97 @@
+#ifndef SMP_H
+#define SMP_H
+
+/* Multiple cores, on the BCM2836/7 (Pi 2 and 3)
+ *
+ * The firmware leaves cores 1-3 waiting for an address in their local
+ * mailbox 3. smp_init() starts each in turn at _start_secondary (start.s),
+ * with its own mode stacks, and it then waits for interrupts in
+ * smp_secondary_main(). On the BCM2835 there's only core 0, and smp_init()
+ * just sets up its per-core data
+ *
+ * Cores interrupt each other with IPIs (inter-processor interrupts), which
+ * go through the target core's local mailbox 0: 32 IPI numbers, one bit
+ * each. Setting a bit is a single write, so any number of cores can send
+ * at once. The GPU interrupts (interrupts.c) only go to core 0
+ */
+
+#define SMP_MAX_CORES	4
+
+struct trace_buffer;
+
+/* IPI numbers */
+#define IPI_CALL	0	/* Run the function passed to smp_call() */
+#define IPI_COUNT	32
+
+/* Per-core data. Each core's TPIDRPRW register (kept by the CPU for the
+ * kernel's own use) points to its own, so smp_this() needs neither the
+ * core number nor a memory access
+ */
+struct smp_core
+{
+	/* cycles_read() at the last IRQ, taken by the first instructions of
+	 * the vector (interrupt_irq_entry(), interrupts.c), for measuring
+	 * interrupt latency
+	 */
+	volatile unsigned int irq_entry;
+	unsigned int id;
+	volatile unsigned int online;
+
+	/* smp_call() function and argument, until it has been run */
+	void (*volatile call)(unsigned int arg);
+	volatile unsigned int call_arg;
+
+	/* Number of IPIs received */
+	volatile unsigned int ipis;
+
+	/* Event trace records (trace.c) */
+	struct trace_buffer *trace;
+};
+
+/* Offset of irq_entry, for the vector's assembler */
+#define SMP_CORE_IRQ_ENTRY	0
+
+extern struct smp_core smp_cores[SMP_MAX_CORES];
+
+/* Number of cores running */
+extern unsigned int smp_core_count;
+
+static inline struct smp_core *smp_this(void)
+{
+	struct smp_core *core;
+
+#ifdef HOST
+	/* No per-core data in the host build */
+	core = 0;
+#else
+	asm("mrc p15, 0, %[core], c13, c0, 4" : [core] "=r" (core));
+#endif
+
+	return core;
+}
+
+/* Start the other cores. Call before interrupts_init(), which needs the
+ * per-core data
+ */
+extern void smp_init(void);
+
+/* Call handler, as an interrupt handler on the receiving core, for IPI
+ * ipi
+ */
+extern void smp_ipi_register(unsigned int ipi, void (*handler)(void));
+
+extern void smp_send_ipi(unsigned int core, unsigned int ipi);
+
+/* Run fn(arg) on another core, from its IPI handler. Returns straight
+ * away, unless the core hasn't yet run the last function it was given
+ */
+extern void smp_call(unsigned int core, void (*fn)(unsigned int arg),
+	unsigned int arg);
+
+/* Time, in cycles, for an IPI to reach another core and be answered */
+extern unsigned int smp_ipi_round_trip(unsigned int core);
+
+/* Deal with any IPIs for this core, from interrupt_irq() */
+extern void smp_ipi_irq(void);
+
+#endif	/* SMP_H */
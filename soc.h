@@ -0,0 +1,95 @@
+#ifndef SOC_H
+#define SOC_H
+
+/* Which Broadcom SoC the kernel is running on
+ *
+ * The same kernel.img runs on the BCM2835 (Pi 1 and Zero: one ARM1176JZF-S),
+ * the BCM2836 (Pi 2: four Cortex-A7s) and the BCM2837 (Pi 3: four
+ * Cortex-A53s, in 32-bit mode). The CPU's main ID register tells them
+ * apart. Reading it is a single coprocessor instruction with no memory
+ * access, so these work before the MMU is on (initsys.c, unlz4.c) and are
+ * cheap enough to use wherever the ARMv6 and ARMv7 CPUs differ: the cycle
+ * counter, whole-cache maintenance and WFI
+ *
+ * The GPU peripherals are the same, but at 0x3f000000 rather than
+ * 0x20000000. initsys maps whichever it is at 0xa0000000, so
+ * mem_p2v(0x20......) reaches them on every SoC. The quad-core SoCs also
+ * have the ARM local peripherals (core timers, mailboxes and interrupt
+ * routing for each core) at 0x40000000, which initsys maps at 0xa1000000
+ * - see soc_local()
+ */
+
+#define SOC_BCM2835	0
+#define SOC_BCM2836	1
+#define SOC_BCM2837	2
+
+/* Primary part numbers, from bits 4-15 of the main ID register */
+#define CPU_PART_ARM1176	0xb76
+#define CPU_PART_CORTEX_A7	0xc07
+#define CPU_PART_CORTEX_A53	0xd03
+
+/* Physical addresses of the peripherals */
+#define SOC_PERIPHERALS_BCM2835	0x20000000
+#define SOC_PERIPHERALS_BCM2836	0x3f000000
+#define SOC_LOCAL_PERIPHERALS	0x40000000
+
+/* Virtual address of a local peripheral register, from its physical
+ * address (quad-core SoCs only)
+ */
+#define soc_local(X)	((X) - SOC_LOCAL_PERIPHERALS + 0xa1000000)
+
+/* Not volatile: the answer never changes, so the compiler is free to read
+ * it once
+ */
+static inline unsigned int cpu_part(void)
+{
+#ifdef HOST
+	/* The host build (host/) passes for a BCM2835 */
+	return CPU_PART_ARM1176;
+#else
+	unsigned int midr;
+
+	asm("mrc p15, 0, %[midr], c0, c0, 0" : [midr] "=r" (midr));
+
+	return (midr >> 4) & 0xfff;
+#endif
+}
+
+/* Is this an ARM11 (ARMv6) rather than an ARMv7 Cortex? Their CP15
+ * operations differ in places
+ */
+static inline unsigned int cpu_is_arm11(void)
+{
+	return (cpu_part() & 0xf00) == 0xb00;
+}
+
+static inline unsigned int soc_type(void)
+{
+	switch(cpu_part())
+	{
+		case CPU_PART_CORTEX_A7: return SOC_BCM2836;
+		case CPU_PART_CORTEX_A53: return SOC_BCM2837;
+		default: return SOC_BCM2835;
+	}
+}
+
+static inline unsigned int soc_peripheral_base(void)
+{
+	return cpu_is_arm11() ? SOC_PERIPHERALS_BCM2835 :
+		SOC_PERIPHERALS_BCM2836;
+}
+
+/* Halt the CPU until an interrupt. ARMv7 dropped the CP15 operation for
+ * this in favour of the WFI instruction
+ */
+static inline void cpu_wait(void)
+{
+#ifndef HOST
+	if(cpu_is_arm11())
+		asm volatile("mcr p15, 0, %[zero], c7, c0, 4" : : [zero] "r" (0));
+	else
+		asm volatile("wfi");
+#endif
+}
+
+#endif	/* SOC_H */
@@ -1,5 +1,55 @@
 /* Set up stacks and jump to C code */
 
+/* Drop from HYP mode to SVC mode, if the CPU is in it. The firmware starts
+ * the Cortex-A7/A53 cores of the BCM2836/7 in HYP mode, where CPS can't
+ * change mode; the only way out is an exception return. The ARM1176 has no
+ * HYP mode. Uses r4 only
+ *
+ * The assembler is told the CPU is an ARM1176 (see the Makefile), so the
+ * virtualisation instructions are written out as words
+ */
+.macro leave_hyp
+	mrs r4, cpsr
+	and r4, r4, #0x1f
+	cmp r4, #0x1a		/* HYP mode */
+	bne 1f
+
+	mrs r4, cpsr
+	bic r4, r4, #0x1f
+	orr r4, r4, #0xd3	/* SVC mode, IRQs and FIQs off */
+	.word 0xe16ef304	/* msr spsr_hyp, r4 */
+	adr r4, 1f
+	.word 0xe12ef304	/* msr elr_hyp, r4 */
+	.word 0xe160006e	/* eret */
+1:
+.endm
+
+/* Have a Cortex-A7 core take part in keeping the cores' data caches
+ * coherent (ACTLR.SMP, bit 6 of the auxiliary control register), which
+ * must be done before it turns on its data cache or MMU. Without it, the
+ * shareable cached memory mem_map() hands out isn't coherent between the
+ * cores. The firmware normally sets it before leaving secure state, and in
+ * non-secure state the bit only changes if it allows it (NSACR.NS_SMP),
+ * so this makes sure rather than relying on that
+ *
+ * The ARM1176's auxiliary control register is different, and is left
+ * alone. The Cortex-A53's equivalent is SMPEN in CPUECTLR, which the
+ * firmware sets and non-secure code can't normally reach. Uses r4 only
+ */
+.macro enable_smp
+	mrc p15, #0, r4, c0, c0, #0	/* Main ID register */
+	lsl r4, r4, #16
+	lsr r4, r4, #20		/* Part number (CPU_PART_*, soc.h) */
+	sub r4, r4, #0xc00
+	cmp r4, #0x007		/* Cortex-A7 */
+	bne 2f
+
+	mrc p15, #0, r4, c1, c0, #1	/* Auxiliary control register */
+	orr r4, r4, #0x40	/* 1<<6, SMP */
+	mcr p15, #0, r4, c1, c0, #1
+2:
+.endm
+
 .global	_start
 
 _start:
@@ -7,27 +57,56 @@ _start:
 	 * them
 	 */
 
+	leave_hyp
+	enable_smp
+
+	/* Turn on the instruction cache and branch prediction as early as
+	 * possible. Neither depends on the MMU: with the MMU off,
+	 * instruction fetches are treated as cacheable, so everything from
+	 * here until main() runs from the I-cache. Invalidate both first, as
+	 * their contents are undefined at reset
+	 * ARM1176JZF-S manual, 3-44 and 3-74
+	 */
+	mov r4, #0
+	mcr p15, #0, r4, c7, c5, #0	/* Invalidate entire I-cache */
+	mcr p15, #0, r4, c7, c5, #6	/* Flush branch target cache */
+
+	mrc p15, #0, r4, c1, c0, #0
+	orr r4, #0x1000		/* 1<<12, I-cache */
+	orr r4, #0x0800		/* 1<<11, branch prediction */
+	orr r4, #0x400000	/* 1<<22, unaligned memory access */
+	mcr p15, #0, r4, c1, c0, #0
+
 	/* kernel.img is loaded at 0x8000
-	 * Below that, 0x4000-0x7fff is the 1MB memory page table, then
-	 * 0x3c00-0x3fff is the kernel data coarse page table (see initsys.c)
+	 * Below that, 0x4000-0x7fff is the 1MB memory page table (see
+	 * initsys.c). The kernel data coarse page tables live after .bss
 	 *
 	 * Stacks go below it, as follows:
 	 *
-	 * 0x2c00 - 0x3c00	User/system stack
+	 * 0x2c00 - 0x4000	User/system stack
 	 * 0x2800 - 0x2c00	IRQ stack
 	 * 0x2400 - 0x2800	Abort stack
 	 * 0x2000 - 0x2400	Supervisor (SWI/SVC) stack
 	 *
 	 * All stacks grow down; decrement then store
 	 *
-	 * Stack addresses are stored in the stack pointers as
-	 * 0x80000000+address, as this means the stack pointer doesn't have
-	 * to change when the MMU is turned on (before the MMU is on, accesses
-	 * to 0x80000000 go to 0x00000000, and so on). Eventually, the stacks
-	 * will be given a proper home
+	 * The stack pointers start as physical addresses, which initsys
+	 * moves into the physical memory window (0x80000000+address) once
+	 * the MMU is on - see init_stacks_high. The BCM2835 ignores the top
+	 * bit of physical addresses, but the BCM2836/7 don't, so the window
+	 * address can't be used from the start. Eventually, the stacks will
+	 * be given a proper home
+	 *
+	 * Cores 1-3 of the BCM2836/7 get their stacks from smp.c instead
+	 * (see _start_secondary)
 	 */
 
-	mov r4, #0x80000000
+	mov r4, #0
+
+	/* No per-core data (smp.h) until smp_init() - the register's reset
+	 * value isn't defined on ARMv7
+	 */
+	mcr p15, #0, r4, c13, c0, #4	/* TPIDRPRW */
 
 	/* SVC stack (for SWIs) at 0x2000 */
 	/* The processor appears to start in this mode, but change to it
@@ -46,15 +125,200 @@ _start:
 
 	/* System stack at 0x2c00 */
 	cps #0x1f		/* Change to system mode */
-	add sp, r4, #0x3c00
+	add sp, r4, #0x4000
 
 	/* Stay in system mode from now on */
 
-	/* Turn on unaligned memory access */
-	mrc p15, #0, r4, c1, c0, #0
-	orr r4, #0x400000	/* 1<22 */
-	mcr p15, #0, r4, c1, c0, #0
-
 	/* Jump to memory map initialisation code */
 	b initsys
 
+
+/* Move each mode's stack pointer into the physical memory window. Called
+ * by initsys, in system mode, once the MMU is on
+ */
+.global init_stacks_high
+
+init_stacks_high:
+	cps #0x13
+	orr sp, sp, #0x80000000
+	cps #0x17
+	orr sp, sp, #0x80000000
+	cps #0x12
+	orr sp, sp, #0x80000000
+	cps #0x1f
+	orr sp, sp, #0x80000000
+	bx lr
+
+
+/* Entry point for cores 1-3 of the BCM2836/7. smp_init() (smp.c) fills in
+ * smp_boot, then puts this address in the core's local mailbox 3, which the
+ * firmware's start-up code is waiting on. Cores are started one at a time,
+ * so they can share smp_boot
+ *
+ * The core starts with the MMU off, running from its physical address. It
+ * turns the MMU on with the initial translation table (initsys.c) for the
+ * whole address space, and core 0's control register (caches and all);
+ * smp_init() maps the first megabyte back in while cores are starting, so
+ * execution carries on here once the MMU is on. Then it sets up its stacks,
+ * in the same layout as core 0's, and calls smp_secondary_main(core number)
+ * at its virtual address. That never returns, and switches to core 0's
+ * translation table 0 (mem_init_core())
+ */
+.global _start_secondary
+
+_start_secondary:
+	leave_hyp
+	enable_smp
+
+	mov r4, #0
+	mcr p15, #0, r4, c7, c5, #0	/* Invalidate entire I-cache */
+	mcr p15, #0, r4, c7, c5, #6	/* Flush branch target cache */
+	mcr p15, #0, r4, c8, c7, #0	/* Invalidate TLB */
+
+	ldr r4, =smp_boot
+	ldmia r4, {r8-r10}
+
+	mov r4, #0x4000
+	mcr p15, #0, r4, c2, c0, #0	/* Translation table 0 */
+	mcr p15, #0, r4, c2, c0, #1	/* Translation table 1 */
+	mov r4, #0
+	mcr p15, #0, r4, c2, c0, #2	/* Table 0 for everything */
+	mov r4, #1
+	mcr p15, #0, r4, c3, c0, #0	/* Domain 0 is a client */
+
+	mov r4, #0
+	mcr p15, #0, r4, c7, c10, #4	/* Data synchronisation barrier */
+	mcr p15, #0, r8, c1, c0, #0	/* Control register */
+	mcr p15, #0, r4, c7, c5, #4	/* Flush prefetch buffer */
+
+	/* Stacks. r9 is the top of this core's 8K */
+	cps #0x13
+	sub sp, r9, #0x1c00
+	cps #0x17
+	sub sp, r9, #0x1800
+	cps #0x12
+	sub sp, r9, #0x1400
+	cps #0x1f
+	mov sp, r9
+
+	mrc p15, #0, r0, c0, c0, #5	/* Multiprocessor affinity */
+	and r0, r0, #3			/* Core number */
+	bx r10
+
+/* Set up by smp_init() through the physical memory window, as this is in
+ * the .init section (read-only at its virtual address)
+ */
+.data
+.global smp_boot
+
+smp_boot:
+	.word 0		/* Control register */
+	.word 0		/* Top of stacks */
+	.word 0		/* smp_secondary_main */
+.text
+
+
+/* Fill memory with a sequence of words, 8 words (32 bytes) at a time
+ * Used by initsys to build page tables and clear .bss while the data cache
+ * is off and every store is a separate bus transaction; a single STM of 8
+ * registers goes out as one burst
+ *
+ * void init_fill(unsigned int *dest, unsigned int count,
+ *			unsigned int value, unsigned int step)
+ *
+ * Writes count words starting at dest (word aligned). The first word is
+ * value, and each subsequent word is step more than the one before it
+ * (step = 0 for a plain fill)
+ */
+.global init_fill
+
+init_fill:
+	push {r4-r11}
+
+	/* Preload 8 registers with consecutive values */
+	mov r4, r2
+	add r5, r4, r3
+	add r6, r5, r3
+	add r7, r6, r3
+	add r8, r7, r3
+	add r9, r8, r3
+	add r10, r9, r3
+	add r11, r10, r3
+	/* r12 = amount to advance each register by after a burst */
+	mov r12, r3, lsl #3
+
+	subs r1, r1, #8
+	bcc 3f
+
+	/* Plain fill - no need to update the registers */
+	cmp r3, #0
+	bne 2f
+1:
+	stmia r0!, {r4-r11}
+	subs r1, r1, #8
+	bcs 1b
+	b 3f
+
+	/* Incrementing fill */
+2:
+	stmia r0!, {r4-r11}
+	add r4, r4, r12
+	add r5, r5, r12
+	add r6, r6, r12
+	add r7, r7, r12
+	add r8, r8, r12
+	add r9, r9, r12
+	add r10, r10, r12
+	add r11, r11, r12
+	subs r1, r1, #8
+	bcs 2b
+
+	/* 0-7 words left over */
+3:
+	adds r1, r1, #8
+	beq 5f
+4:
+	str r4, [r0], #4
+	add r4, r4, r3
+	subs r1, r1, #1
+	bne 4b
+5:
+	pop {r4-r11}
+	bx lr
+
+
+
+/* Copy memory to a higher address, working backwards from the end so that
+ * overlapping areas are handled, 8 words (32 bytes) at a time
+ * Used by unlz4.c to move the compressed kernel out of the way of its
+ * unpacked form
+ *
+ * void init_move_up(void *dest_end, const void *src_end,
+ *			unsigned int length)
+ *
+ * dest_end and src_end are the addresses after the last byte of each area.
+ * Both must be word aligned, and length a multiple of 4
+ */
+.global init_move_up
+
+init_move_up:
+	push {r4-r11}
+
+	subs r2, r2, #32
+	bcc 2f
+1:
+	ldmdb r1!, {r4-r11}
+	stmdb r0!, {r4-r11}
+	subs r2, r2, #32
+	bcs 1b
+2:
+	adds r2, r2, #32
+	beq 4f
+3:
+	ldr r4, [r1, #-4]!
+	str r4, [r0, #-4]!
+	subs r2, r2, #4
+	bne 3b
+4:
+	pop {r4-r11}
+	bx lr
@@ -0,0 +1,285 @@
+/* Kernel statistics (see stats.h) */
+
+#include "stats.h"
+
+#include "framebuffer.h"
+#include "kprintf.h"
+
+static struct stat_counter *counters, **counters_end = &counters;
+static struct stat_histogram *histograms, **histograms_end = &histograms;
+static unsigned int counter_count, histogram_count;
+
+void stat_register_counter(struct stat_counter *counter)
+{
+	unsigned int cpsr = irq_save();
+
+	if(!counter->registered)
+	{
+		counter->registered = 1;
+		counter->next = 0;
+		*counters_end = counter;
+		counters_end = &counter->next;
+		counter_count++;
+	}
+
+	irq_restore(cpsr);
+}
+
+void stat_register_histogram(struct stat_histogram *histogram)
+{
+	unsigned int cpsr = irq_save();
+
+	if(!histogram->registered)
+	{
+		histogram->registered = 1;
+		histogram->next = 0;
+		*histograms_end = histogram;
+		histograms_end = &histogram->next;
+		histogram_count++;
+	}
+
+	irq_restore(cpsr);
+}
+
+void stat_histogram_clear(struct stat_histogram *histogram)
+{
+	unsigned int cpsr = irq_save();
+	unsigned int bucket;
+
+	histogram->count = 0;
+	histogram->min = 0;
+	histogram->max = 0;
+	histogram->total = 0;
+	for(bucket=0; bucket<STAT_BUCKETS; bucket++)
+		histogram->buckets[bucket] = 0;
+
+	irq_restore(cpsr);
+}
+
+/* Highest value in a bucket */
+static unsigned int bucket_top(unsigned int bucket)
+{
+	if(bucket == 0)
+		return 0;
+	if(bucket == 32)
+		return 0xffffffff;
+
+	return (1<<bucket) - 1;
+}
+
+unsigned int stat_percentile(const struct stat_histogram *histogram,
+	unsigned int percent)
+{
+	unsigned int bucket, seen = 0, needed;
+
+	if(histogram->count == 0)
+		return 0;
+
+	/* Rounded up, so that the 99th percentile of 10 values is the
+	 * largest. Done in two halves so it can't overflow
+	 */
+	needed = (histogram->count / 100) * percent +
+		((histogram->count % 100) * percent + 99) / 100;
+
+	for(bucket=0; bucket<STAT_BUCKETS; bucket++)
+	{
+		seen += histogram->buckets[bucket];
+		if(seen >= needed)
+			break;
+	}
+
+	/* Never more than the largest value actually seen */
+	if(bucket >= STAT_BUCKETS || bucket_top(bucket) > histogram->max)
+		return histogram->max;
+
+	return bucket_top(bucket);
+}
+
+/* Divide *value by divisor, one bit at a time, returning the remainder.
+ * Avoids libgcc's 64 bit division; this is only for printing
+ */
+static unsigned int divide64(unsigned long long *value, unsigned int divisor)
+{
+	unsigned long long quotient = 0;
+	unsigned long long remainder = 0;
+	int bit;
+
+	for(bit=63; bit>=0; bit--)
+	{
+		remainder = (remainder << 1) | ((*value >> bit) & 1);
+		if(remainder >= divisor)
+		{
+			remainder -= divisor;
+			quotient |= 1ULL << bit;
+		}
+	}
+
+	*value = quotient;
+
+	return (unsigned int)remainder;
+}
+
+unsigned int stat_average(const struct stat_histogram *histogram)
+{
+	unsigned long long total = histogram->total;
+
+	if(histogram->count == 0)
+		return 0;
+
+	divide64(&total, histogram->count);
+
+	return (unsigned int)total;
+}
+
+/* A 64 bit value in decimal. buffer needs 21 characters */
+static char *format64(char *buffer, unsigned long long value)
+{
+	char *p = buffer + 20;
+
+	*p = 0;
+	do
+		*--p = '0' + divide64(&value, 10);
+	while(value);
+
+	return p;
+}
+
+/* Width of the histogram bars */
+#define STAT_BAR	40
+
+void stat_print_histogram(const struct stat_histogram *histogram)
+{
+	unsigned int bucket, first, last, most = 0, length;
+	char bar[STAT_BAR + 1];
+
+	kprintf("%s: %u values (%s), min %u, average %u, 99%% under %u, "
+		"max %u\n", histogram->name, histogram->count, histogram->units,
+		histogram->min, stat_average(histogram),
+		stat_percentile(histogram, 99), histogram->max);
+
+	if(histogram->count == 0)
+		return;
+
+	/* Only the buckets from the first to the last in use */
+	first = STAT_BUCKETS;
+	last = 0;
+	for(bucket=0; bucket<STAT_BUCKETS; bucket++)
+	{
+		if(!histogram->buckets[bucket])
+			continue;
+
+		if(first == STAT_BUCKETS)
+			first = bucket;
+		last = bucket;
+		if(histogram->buckets[bucket] > most)
+			most = histogram->buckets[bucket];
+	}
+
+	for(bucket=first; bucket<=last; bucket++)
+	{
+		length = (histogram->buckets[bucket] * STAT_BAR + most - 1) /
+			most;
+		bar[length] = 0;
+		while(length)
+			bar[--length] = '#';
+
+		kprintf("  <= %10u %8u %s\n", bucket_top(bucket),
+			histogram->buckets[bucket], bar);
+	}
+}
+
+unsigned int stat_count(void)
+{
+	return counter_count + histogram_count;
+}
+
+unsigned int stat_get(unsigned int index,
+	const struct stat_counter **counter,
+	const struct stat_histogram **histogram)
+{
+	struct stat_counter *c;
+	struct stat_histogram *h;
+
+	for(c=counters; c; c=c->next)
+	{
+		if(index-- == 0)
+		{
+			*counter = c;
+			return STAT_COUNTER;
+		}
+	}
+
+	for(h=histograms; h; h=h->next)
+	{
+		if(index-- == 0)
+		{
+			*histogram = h;
+			return STAT_HISTOGRAM;
+		}
+	}
+
+	return ~0;
+}
+
+/* One line for each counter and histogram, without newlines, into line */
+static void format_stat(char *line, unsigned int size, unsigned int width,
+	const struct stat_counter *counter,
+	const struct stat_histogram *histogram)
+{
+	char number[21];
+
+	if(counter)
+		ksnprintf(line, size, "%-*s %s", width - 12, counter->name,
+			format64(number, counter->value));
+	else
+		ksnprintf(line, size, "%-*s %u/%u/%u", width - 20,
+			histogram->name, histogram->min,
+			stat_average(histogram), histogram->max);
+}
+
+void stats_panel(struct viewport *vp)
+{
+	const struct stat_counter *counter;
+	const struct stat_histogram *histogram;
+	unsigned int index, type;
+	char line[80], out[96];
+
+	viewport_write(vp, "\033[1;1H" COLOUR_PUSH FG_WHITE "Statistics "
+		"(histograms: min/avg/max)" COLOUR_POP "\033[K");
+
+	for(index=0; index<vp->height - 1; index++)
+	{
+		type = stat_get(index, &counter, &histogram);
+		if(type == ~0U)
+			break;
+
+		format_stat(line, sizeof(line) < vp->width + 1 ?
+			sizeof(line) : vp->width + 1, vp->width,
+			type == STAT_COUNTER ? counter : 0,
+			type == STAT_HISTOGRAM ? histogram : 0);
+
+		/* Rows count from 1, and the line is erased after the text in
+		 * case it's got shorter
+		 */
+		ksnprintf(out, sizeof(out), "\033[%u;1H%s\033[K", index + 2,
+			line);
+		viewport_write(vp, out);
+	}
+}
+
+void stats_print(void)
+{
+	const struct stat_counter *counter;
+	const struct stat_histogram *histogram;
+	unsigned int index, type;
+	char line[80];
+
+	for(index=0; (type = stat_get(index, &counter, &histogram)) != ~0U;
+		index++)
+	{
+		format_stat(line, sizeof(line), 40,
+			type == STAT_COUNTER ? counter : 0,
+			type == STAT_HISTOGRAM ? histogram : 0);
+		kprintf("  %s\n", line);
+	}
+}
@@ -0,0 +1,119 @@
+#ifndef STATS_H
+#define STATS_H
+
+/* Kernel statistics
+ *
+ * Subsystems keep named counters (64 bit) and histograms (of values such as
+ * latencies, in power of 2 buckets) and register them here once, so that
+ * everything can be read in one place: on screen (stats_panel(), which
+ * main.c refreshes), over the serial port, or with the SYS_STATS system
+ * call
+ *
+ * An update is a few instructions with IRQs disabled, so they're safe from
+ * interrupt handlers and threads alike. Counters and histograms are only
+ * updated on core 0; the other cores keep their own counts (such as
+ * struct smp_core's ipis)
+ */
+
+#include "interrupts.h"
+
+#define STAT_COUNTER		0
+#define STAT_HISTOGRAM		1
+
+/* Bucket 0 holds values of 0, and bucket n values from 2^(n-1) to
+ * 2^n - 1
+ */
+#define STAT_BUCKETS		33
+
+struct stat_counter
+{
+	const char *name;
+	unsigned long long value;
+	struct stat_counter *next;
+	unsigned int registered;
+};
+
+struct stat_histogram
+{
+	const char *name;
+	const char *units;
+	unsigned int count;
+	unsigned int min, max;
+	unsigned long long total;
+	unsigned int buckets[STAT_BUCKETS];
+	struct stat_histogram *next;
+	unsigned int registered;
+};
+
+#define STAT_COUNTER_INIT(name)			{ name, 0, 0, 0 }
+#define STAT_HISTOGRAM_INIT(name, units)	{ name, units, 0, 0, 0, 0, \
+							{ 0 }, 0, 0 }
+
+/* Add to the list, if not there already */
+extern void stat_register_counter(struct stat_counter *counter);
+extern void stat_register_histogram(struct stat_histogram *histogram);
+
+static inline void stat_add(struct stat_counter *counter, unsigned int n)
+{
+	unsigned int cpsr = irq_save();
+
+	counter->value += n;
+
+	irq_restore(cpsr);
+}
+
+static inline void stat_inc(struct stat_counter *counter)
+{
+	stat_add(counter, 1);
+}
+
+static inline void stat_record(struct stat_histogram *histogram,
+	unsigned int value)
+{
+	unsigned int bucket = value ? 32 - __builtin_clz(value) : 0;
+	unsigned int cpsr = irq_save();
+
+	if(histogram->count == 0 || value < histogram->min)
+		histogram->min = value;
+	if(value > histogram->max)
+		histogram->max = value;
+	histogram->count++;
+	histogram->total += value;
+	histogram->buckets[bucket]++;
+
+	irq_restore(cpsr);
+}
+
+extern void stat_histogram_clear(struct stat_histogram *histogram);
+
+/* Upper bound of the bucket holding the percent'th percentile: at least
+ * percent% of the values recorded were no more than this
+ */
+extern unsigned int stat_percentile(const struct stat_histogram *histogram,
+	unsigned int percent);
+
+/* Mean of the values recorded, or 0 */
+extern unsigned int stat_average(const struct stat_histogram *histogram);
+
+/* Print a histogram's buckets as bars */
+extern void stat_print_histogram(const struct stat_histogram *histogram);
+
+/* Number of counters and histograms registered, and the index'th of them
+ * (counters first). stat_get() returns STAT_COUNTER or STAT_HISTOGRAM, or
+ * ~0 if there isn't one
+ */
+extern unsigned int stat_count(void);
+extern unsigned int stat_get(unsigned int index,
+	const struct stat_counter **counter,
+	const struct stat_histogram **histogram);
+
+/* Write every counter and histogram to a viewport, a line each, from its
+ * top left
+ */
+struct viewport;
+extern void stats_panel(struct viewport *vp);
+
+/* Print every counter and histogram on the console */
+extern void stats_print(void);
+
+#endif	/* STATS_H */
@@ -0,0 +1,142 @@
+/* System calls (see syscall.h) */
+
+#include "syscall.h"
+
+#include "framebuffer.h"
+#include "kprintf.h"
+#include "smp.h"
+#include "soc.h"
+#include "stats.h"
+#include "task.h"
+#include "thread.h"
+#include "timer.h"
+
+/* For putting constants into the entry code */
+#define STRINGIFY_(X)	#X
+#define STRINGIFY(X)	STRINGIFY_(X)
+
+/* Fast call handlers take up to four arguments, hence no prototype */
+typedef unsigned int (*syscall_fast_fn)();
+typedef void (*syscall_frame_fn)(struct thread_frame *frame);
+
+static unsigned int sys_null(void)
+{
+	return 0;
+}
+
+static unsigned int sys_time(void)
+{
+	return timer_read();
+}
+
+static unsigned int sys_write(unsigned int text)
+{
+	console_write((char *)text);
+
+	return 0;
+}
+
+static void sys_info(struct thread_frame *frame)
+{
+	frame->r[0] = soc_type();
+	frame->r[1] = smp_core_count;
+	frame->r[2] = thread_switches();
+	frame->r[3] = task_get_stats()->run;
+}
+
+static void sys_stats(struct thread_frame *frame)
+{
+	const struct stat_counter *counter;
+	const struct stat_histogram *histogram;
+	unsigned int type = stat_get(frame->r[0], &counter, &histogram);
+
+	frame->r[0] = type;
+
+	if(type == STAT_COUNTER)
+	{
+		frame->r[1] = (unsigned int)counter->name;
+		frame->r[2] = (unsigned int)counter->value;
+		frame->r[3] = (unsigned int)(counter->value >> 32);
+	}
+	else if(type == STAT_HISTOGRAM)
+	{
+		frame->r[1] = (unsigned int)histogram->name;
+		frame->r[2] = histogram->count;
+		frame->r[3] = stat_percentile(histogram, 99);
+	}
+}
+
+/* Indexed by call number. Not static, as the entry code uses them */
+const syscall_fast_fn syscall_fast_table[SYSCALL_FAST_COUNT] = {
+	sys_null,		/* SYS_NULL */
+	sys_time,		/* SYS_TIME */
+	sys_write,		/* SYS_WRITE */
+};
+
+const syscall_frame_fn syscall_frame_table[SYSCALL_FRAME_COUNT] = {
+	sys_info,		/* SYS_INFO */
+	sys_stats,		/* SYS_STATS */
+};
+
+/* SWI entry, from the vector (interrupts.c)
+ *
+ * Fast path: the handler preserves r4-r11 itself, and the results are
+ * left in r0-r3, so only r12 and the return address need saving. The SPSR
+ * isn't touched, as nothing here can make another SWI
+ *
+ * Anything else: the return address and SPSR are saved as interrupt_irq_entry()
+ * does, and then the caller's own r0-r12 and lr (the user/system mode
+ * ones), making a struct thread_frame for syscall_full()
+ */
+__attribute__ ((naked)) void interrupt_swi(void)
+{
+	asm volatile("cmp r7, #" STRINGIFY(SYSCALL_FAST_COUNT) "\n"
+		"bhs 1f\n"
+		"push {r12, lr}\n"
+		"ldr r12, =syscall_fast_table\n"
+		"ldr r12, [r12, r7, lsl #2]\n"
+		"blx r12\n"
+		"ldm sp!, {r12, pc}^\n"
+
+		"1:\n"
+		"srsdb sp!, #0x13\n"
+		"sub sp, sp, #56\n"
+		"stmia sp, {r0-r12, lr}^\n"
+		"mov r0, sp\n"
+		"bl syscall_full\n"
+		"ldmia sp, {r0-r12, lr}^\n"
+		/* No banked register access straight after that */
+		"nop\n"
+		"add sp, sp, #56\n"
+		"rfeia sp!\n"
+		".ltorg\n"
+	);
+}
+
+/* The last unknown call, for report_unknown() */
+static volatile unsigned int unknown_number, unknown_address;
+
+static void report_unknown(void *arg)
+{
+	kprintf(COLOUR_PUSH FG_RED "Unknown system call %u at 0x%08X"
+		COLOUR_POP "\n", unknown_number, unknown_address);
+}
+
+/* Full frame calls, from interrupt_swi() */
+void syscall_full(struct thread_frame *frame)
+{
+	unsigned int number = frame->r[7];
+
+	if(number - SYSCALL_FRAME < SYSCALL_FRAME_COUNT)
+	{
+		syscall_frame_table[number - SYSCALL_FRAME](frame);
+		return;
+	}
+
+	/* Reported from a task, not here */
+	unknown_number = number;
+	unknown_address = frame->pc - 4;
+	task_post(report_unknown, 0, TASK_PRIORITY_NORMAL);
+
+	frame->r[0] = SYSCALL_ENOSYS;
+}
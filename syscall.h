@@ -0,0 +1,72 @@
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+/* System calls, through SWI
+ *
+ * The call number goes in r7 and up to four arguments in r0-r3; results
+ * come back in r0-r3. The number in the SWI instruction itself is ignored,
+ * so the handler never has to read the instruction back from memory
+ *
+ * Calls numbered below SYSCALL_FRAME take the fast path: the handler is a
+ * plain C function, called with the arguments as its own, and only what
+ * the procedure call standard doesn't preserve is saved. Calls from
+ * SYSCALL_FRAME up get every register of the caller as a struct
+ * thread_frame, and can change any of them. Unknown numbers return
+ * SYSCALL_ENOSYS
+ *
+ * Handlers run in SVC mode, on its small stack, with IRQs disabled
+ */
+
+/* Fast calls */
+#define SYS_NULL	0	/* Does nothing; returns 0 */
+#define SYS_TIME	1	/* Returns timer_read() */
+#define SYS_WRITE	2	/* console_write(r0) */
+#define SYSCALL_FAST_COUNT	3
+
+/* Full frame calls */
+#define SYSCALL_FRAME	0x100
+#define SYS_INFO	(SYSCALL_FRAME + 0)	/* r0: SoC, r1: cores, r2: context
+						 * switches, r3: tasks run */
+/* Statistic number r0 (stats.h). r0: STAT_COUNTER, STAT_HISTOGRAM or ~0
+ * past the last; r1: name; r2, r3: a counter's value (low and high words),
+ * or a histogram's count and 99th percentile
+ */
+#define SYS_STATS	(SYSCALL_FRAME + 1)
+#define SYSCALL_FRAME_COUNT	2
+
+#define SYSCALL_ENOSYS	0xffffffff
+
+/* Make system call number with arguments a-d, returning r0 and (if results
+ * isn't 0) r0-r3 in results[0-3]
+ */
+static inline unsigned int syscall4(unsigned int number, unsigned int a,
+	unsigned int b, unsigned int c, unsigned int d, unsigned int *results)
+{
+	register unsigned int r0 asm("r0") = a;
+	register unsigned int r1 asm("r1") = b;
+	register unsigned int r2 asm("r2") = c;
+	register unsigned int r3 asm("r3") = d;
+	register unsigned int r7 asm("r7") = number;
+
+	asm volatile("swi #0"
+		: "+r" (r0), "+r" (r1), "+r" (r2), "+r" (r3)
+		: "r" (r7)
+		: "memory");
+
+	if(results)
+	{
+		results[0] = r0;
+		results[1] = r1;
+		results[2] = r2;
+		results[3] = r3;
+	}
+
+	return r0;
+}
+
+static inline unsigned int syscall(unsigned int number, unsigned int a)
+{
+	return syscall4(number, a, 0, 0, 0, 0);
+}
+
+#endif	/* SYSCALL_H */
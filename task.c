@@ -0,0 +1,345 @@
+/* Run-to-completion tasks
+ *
+ * Each priority's queue is an mpsc_ring (ring.h): any number of posters,
+ * and task_run_pending() taking them in order. A thread preempted part
+ * way through posting, or an interrupt handler posting in the middle of
+ * another post, doesn't hold up any other poster
+ *
+ * Timer tasks are a list in order of when they're due, with system timer
+ * compare channel TIMER_TASKS set for the first. Its interrupt only wakes
+ * task_run(), which posts the timer tasks that are due
+ */
+
+#include "task.h"
+
+#include "atomic.h"
+#include "interrupts.h"
+#include "kprintf.h"
+#include "memory.h"
+#include "ring.h"
+#include "stats.h"
+#include "thread.h"
+#include "timer.h"
+#include "trace.h"
+
+struct task_entry
+{
+	void (*fn)(void *arg);
+	void *arg;
+	unsigned int posted;		/* cycles_read() */
+};
+
+struct task_queue
+{
+	struct mpsc_ring ring;
+	volatile unsigned int sequence[TASK_QUEUE_SIZE];
+	struct task_entry entries[TASK_QUEUE_SIZE];
+};
+
+/* In cached memory, for the atomic operations, from task_init(). Until
+ * then, no tasks can be posted, and the statistics stay at 0
+ */
+static struct task_queue *queues;
+static struct task_stats no_stats;
+static struct task_stats *stats = &no_stats;
+
+static struct stat_histogram stat_latency =
+	STAT_HISTOGRAM_INIT("Task latency", "cycles");
+
+/* In order of when they're due */
+static struct task_timer *timers;
+
+/* task_run(), when there's nothing to do */
+static struct wait_queue idle = WAIT_QUEUE_INIT;
+
+/* Shortest time ahead to set the timer for (as in thread.c) */
+#define TASK_TIMER_MIN	10
+
+unsigned int task_post(void (*fn)(void *arg), void *arg,
+	unsigned int priority)
+{
+	struct task_queue *queue;
+	struct task_entry *entry;
+	unsigned int position;
+
+	if(!queues)
+		return 0;
+
+	if(priority >= TASK_PRIORITIES)
+		priority = TASK_PRIORITY_LOW;
+	queue = &queues[priority];
+
+	if(!mpsc_claim(&queue->ring, &position))
+	{
+		atomic_add(&stats->dropped, 1);
+		return 0;
+	}
+
+	entry = &queue->entries[position & (TASK_QUEUE_SIZE - 1)];
+	entry->fn = fn;
+	entry->arg = arg;
+	entry->posted = cycles_read();
+	mpsc_publish(&queue->ring, position);
+
+	atomic_add(&stats->posted, 1);
+	thread_wake_one(&idle);
+
+	return 1;
+}
+
+/* Take the next ready task from a queue, if there is one, and run it */
+static unsigned int run_one(struct task_queue *queue)
+{
+	struct task_entry *entry;
+	void (*fn)(void *arg);
+	void *arg;
+	unsigned int slot, latency;
+
+	if(!mpsc_peek(&queue->ring, &slot))
+		return 0;
+
+	entry = &queue->entries[slot];
+	fn = entry->fn;
+	arg = entry->arg;
+	latency = cycles_read() - entry->posted;
+	mpsc_release(&queue->ring);
+
+	if(stats->run == 0 || latency < stats->latency_min)
+		stats->latency_min = latency;
+	if(latency > stats->latency_max)
+		stats->latency_max = latency;
+	stats->latency_avg += ((int)latency - (int)stats->latency_avg) / 16;
+	stats->run++;
+	stat_record(&stat_latency, latency);
+
+	trace(TRACE_TASK, (unsigned int)fn, latency);
+	fn(arg);
+
+	return 1;
+}
+
+/* Set the timer for the first timer task. Call with IRQs disabled */
+static void set_timer(void)
+{
+	unsigned int now;
+
+	if(!timers)
+		return;
+
+	now = timer_read();
+	if((int)(timers->when - now) < TASK_TIMER_MIN)
+		timer_compare(TIMER_TASKS, now + TASK_TIMER_MIN);
+	else
+		timer_compare(TIMER_TASKS, timers->when);
+}
+
+/* Take a timer out of the list. Call with IRQs disabled */
+static void timer_remove(struct task_timer *timer)
+{
+	struct task_timer **p;
+
+	if(!timer->active)
+		return;
+
+	for(p=&timers; *p; p=&(*p)->next)
+	{
+		if(*p == timer)
+		{
+			*p = timer->next;
+			break;
+		}
+	}
+
+	timer->active = 0;
+}
+
+/* Put a timer into the list, after any due at the same time. Call with
+ * IRQs disabled
+ */
+static void timer_insert(struct task_timer *timer)
+{
+	struct task_timer **p;
+
+	for(p=&timers; *p && (int)((*p)->when - timer->when) <= 0;
+		p=&(*p)->next);
+	timer->next = *p;
+	*p = timer;
+	timer->active = 1;
+
+	set_timer();
+}
+
+void task_timer_start(struct task_timer *timer,
+	void (*fn)(void *arg), void *arg, unsigned int priority,
+	unsigned int delay, unsigned int period)
+{
+	unsigned int cpsr = irq_save();
+
+	timer_remove(timer);
+
+	timer->fn = fn;
+	timer->arg = arg;
+	timer->priority = priority;
+	timer->when = timer_read() + delay;
+	timer->period = period;
+	timer_insert(timer);
+
+	irq_restore(cpsr);
+}
+
+void task_timer_stop(struct task_timer *timer)
+{
+	unsigned int cpsr = irq_save();
+
+	timer_remove(timer);
+
+	irq_restore(cpsr);
+}
+
+/* Post the timer tasks that are due. A periodic timer that has fallen
+ * behind skips the periods it missed rather than posting them all at once
+ */
+static void timers_post(void)
+{
+	struct task_timer *timer;
+	unsigned int cpsr = irq_save();
+	unsigned int now = timer_read();
+
+	while((timer = timers) && (int)(now - timer->when) >= 0)
+	{
+		timer_remove(timer);
+
+		/* If it can't be posted, try again next time round */
+		if(!task_post(timer->fn, timer->arg, timer->priority))
+		{
+			timer_insert(timer);
+			break;
+		}
+
+		if(timer->period)
+		{
+			timer->when += timer->period;
+			if((int)(now - timer->when) >= 0)
+				timer->when = now + timer->period;
+			timer_insert(timer);
+		}
+	}
+
+	irq_restore(cpsr);
+}
+
+static void timer_irq(void)
+{
+	timer_compare_clear(TIMER_TASKS);
+	thread_wake_one(&idle);
+}
+
+unsigned int task_run_pending(void)
+{
+	unsigned int priority, count = 0;
+
+	if(!queues)
+		return 0;
+
+	timers_post();
+
+	/* Back to the highest priority queue after every task, in case that
+	 * task posted something more urgent
+	 */
+	priority = 0;
+	while(priority < TASK_PRIORITIES)
+	{
+		if(run_one(&queues[priority]))
+		{
+			count++;
+			priority = 0;
+		}
+		else
+			priority++;
+	}
+
+	return count;
+}
+
+/* Is anything ready to run? Call with IRQs disabled */
+static unsigned int task_ready(void)
+{
+	unsigned int priority, slot;
+
+	if(!queues)
+		return 0;
+
+	if(timers && (int)(timer_read() - timers->when) >= 0)
+		return 1;
+
+	for(priority=0; priority<TASK_PRIORITIES; priority++)
+		if(mpsc_peek(&queues[priority].ring, &slot))
+			return 1;
+
+	return 0;
+}
+
+void task_wait(void)
+{
+	/* Checked with IRQs disabled, so that a post from an interrupt
+	 * handler can't come between the check and the wait. Without
+	 * threads, WFI wakes up for an interrupt even while they're disabled
+	 */
+	unsigned int cpsr = irq_save();
+
+	if(!task_ready())
+	{
+		if(thread_current())
+			thread_wait(&idle);
+		else
+			cpu_wait();
+	}
+
+	irq_restore(cpsr);
+}
+
+void task_run(void)
+{
+	while(1)
+	{
+		task_run_pending();
+		task_wait();
+	}
+}
+
+const struct task_stats *task_get_stats(void)
+{
+	return stats;
+}
+
+void task_print_stats(void)
+{
+	kprintf("Tasks: %u posted, %u dropped, %u run; latency %u-%u cycles, "
+		"average %u\n", stats->posted, stats->dropped, stats->run,
+		stats->latency_min, stats->latency_max, stats->latency_avg);
+}
+
+void task_init(void)
+{
+	unsigned int priority;
+
+	struct task_stats *cached_stats;
+
+	queues = mem_alloc_cached(TASK_PRIORITIES * sizeof(struct task_queue));
+	cached_stats = mem_alloc_cached(sizeof(struct task_stats));
+	if(!queues || !cached_stats)
+	{
+		queues = 0;
+		return;
+	}
+	stats = cached_stats;
+
+	for(priority=0; priority<TASK_PRIORITIES; priority++)
+		mpsc_init(&queues[priority].ring, queues[priority].sequence,
+			TASK_QUEUE_SIZE);
+
+	stat_register_histogram(&stat_latency);
+
+	timer_compare_clear(TIMER_TASKS);
+	interrupt_register(IRQ_SYSTIMER(TIMER_TASKS), timer_irq);
+}
@@ -0,0 +1,82 @@
+#ifndef TASK_H
+#define TASK_H
+
+/* Run-to-completion tasks
+ *
+ * A task is a function call queued to run later, in task_run() - which is
+ * main_endloop()'s thread - rather than where it was posted. Interrupt
+ * handlers post their slow work (printing, say) so that they can return
+ * in microseconds. Posting never waits and takes no lock, so it's safe
+ * from handlers and threads alike; it only fails if the queue is full
+ *
+ * There's a queue for each priority, and tasks run in priority order, each
+ * to completion: tasks never preempt each other. Timer tasks are posted
+ * when they fall due, once or periodically. When nothing is left to run,
+ * task_run() waits, and the CPU halts in the idle thread until the next
+ * post or timer
+ *
+ * Only core 0 may post tasks
+ */
+
+/* Priorities: lower numbers run first */
+#define TASK_PRIORITY_HIGH	0
+#define TASK_PRIORITY_NORMAL	1
+#define TASK_PRIORITY_LOW	2
+#define TASK_PRIORITIES		3
+
+/* Tasks each queue can hold. Must be a power of 2 */
+#define TASK_QUEUE_SIZE		32
+
+struct task_timer
+{
+	void (*fn)(void *arg);
+	void *arg;
+	unsigned int priority;
+	unsigned int when;		/* timer_read() time it's due */
+	unsigned int period;		/* 0 for once only */
+	unsigned int active;
+	struct task_timer *next;
+};
+
+/* Latencies are from posting to the task starting, in CPU cycles */
+struct task_stats
+{
+	volatile unsigned int posted;
+	volatile unsigned int dropped;	/* Queue was full */
+	unsigned int run;
+	unsigned int latency_min;
+	unsigned int latency_max;
+	unsigned int latency_avg;	/* Moving average, over about 16 */
+};
+
+extern void task_init(void);
+
+/* Queue fn(arg). Returns 0 if the queue for priority is full */
+extern unsigned int task_post(void (*fn)(void *arg), void *arg,
+	unsigned int priority);
+
+/* Post fn(arg) in delay microseconds, and then every period microseconds
+ * if period isn't 0. Restarts the timer if it's already running
+ */
+extern void task_timer_start(struct task_timer *timer,
+	void (*fn)(void *arg), void *arg, unsigned int priority,
+	unsigned int delay, unsigned int period);
+extern void task_timer_stop(struct task_timer *timer);
+
+/* Run everything that's ready, including anything posted meanwhile.
+ * Returns the number of tasks run
+ */
+extern unsigned int task_run_pending(void);
+
+/* Wait until a task is ready to run (at once, if one already is). The CPU
+ * halts in the idle thread meanwhile
+ */
+extern void task_wait(void);
+
+/* Run tasks for ever, waiting whenever there are none */
+extern void task_run(void) __attribute__((noreturn));
+
+extern const struct task_stats *task_get_stats(void);
+extern void task_print_stats(void);
+
+#endif	/* TASK_H */
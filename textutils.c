@@ -1,5 +1,7 @@
 #include "textutils.h"
 
+#include "fastdiv.h"
+
 /* Convert an unsigned value to hex (without the trailing "0x")
  * size = size in bytes (only 1, 2 or 4 permitted)
  */
@@ -30,6 +32,77 @@ char *tohex(unsigned int value, unsigned int size)
 	return buffer;
 }
 
+/* Write the hex digits of value backwards from end (exclusive), returning
+ * a pointer to the first digit. At least mindigits digits are written (up
+ * to 8), with leading zeroes if necessary. upper = 0 for a-f, 1 for A-F
+ */
+char *hexdigits(char *end, unsigned int value, unsigned int mindigits,
+	unsigned int upper)
+{
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+
+	if(mindigits > 8)
+		mindigits = 8;
+
+	do
+	{
+		*--end = digits[value & 15];
+		value = value >> 4;
+		if(mindigits)
+			mindigits--;
+	} while(value || mindigits);
+
+	return end;
+}
+
+/* Pairs of decimal digits, "00" to "99". Converting two digits at a time
+ * halves the number of divisions
+ */
+static const char digitpairs[200] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/* Write the decimal digits of value backwards from end (exclusive),
+ * returning a pointer to the first digit. Writes at most 10 characters
+ *
+ * Division by 100 is done by reciprocal multiplication (see fastdiv.h)
+ * rather than calling libgcc
+ */
+char *decdigits(char *end, unsigned int value)
+{
+	unsigned int q, r;
+
+	while(value >= 100)
+	{
+		q = udiv100(value);
+		r = (value - q * 100) * 2;
+		value = q;
+
+		*--end = digitpairs[r + 1];
+		*--end = digitpairs[r];
+	}
+
+	if(value >= 10)
+	{
+		*--end = digitpairs[value * 2 + 1];
+		*--end = digitpairs[value * 2];
+	}
+	else
+	{
+		*--end = '0' + value;
+	}
+
+	return end;
+}
+
 /* Convert unsigned value to decimal
  * leading = 0 - no leading spaces/zeroes
  * leading >0 - number of leading zeroes
@@ -39,10 +112,9 @@ char *todec(unsigned int value, int leading)
 {
 	/* Biggest number is 4294967295 (10 digits) */
 	static char buffer[11];
-	static char leadchar;
 
-	unsigned int offset = 10;
-	unsigned char ch;
+	char *start;
+	char leadchar;
 
 	if(leading <0)
 	{
@@ -57,24 +129,12 @@ char *todec(unsigned int value, int leading)
 	if(leading>10)
 		return "error";
 
-	buffer[offset] = 0;
-
-	while(value || (offset == 10))
-	{
-		offset--;
-		leading--;
-		ch = 48 + (value % 10);
-		buffer[offset] = ch;
+	buffer[10] = 0;
 
-		value = value/10;
-	}
+	start = decdigits(&buffer[10], value);
 
-	while(leading>0)
-	{
-		offset--;
-		leading--;
-		buffer[offset] = leadchar;
-	}
+	while(start > &buffer[10 - leading])
+		*--start = leadchar;
 
-	return &buffer[offset];
+	return start;
 }
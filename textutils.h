@@ -5,4 +5,13 @@
 extern char *tohex(unsigned int value, unsigned int size);
 extern char *todec(unsigned int value, int leading);
 
+/* Reentrant versions of the above. Both write digits backwards from end
+ * (exclusive) and return a pointer to the first one
+ * decdigits writes up to 10 characters; hexdigits up to 8, padding to at
+ * least mindigits with zeroes
+ */
+extern char *decdigits(char *end, unsigned int value);
+extern char *hexdigits(char *end, unsigned int value, unsigned int mindigits,
+	unsigned int upper);
+
 #endif	/* TEXTUTILS_H */
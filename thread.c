@@ -0,0 +1,447 @@
+/* Kernel threads
+ *
+ * The run queue is a list per priority, plus a bitmap of the priorities
+ * with anything in them, so finding the next thread to run is one CLZ
+ * however many threads there are. Sleeping threads are kept in order of
+ * wake-up time, and system timer compare channel TIMER_THREADS is set for
+ * whichever comes first: the end of the running thread's time slice, or
+ * the next wake-up
+ *
+ * Everything here is changed with IRQs disabled, which is enough while only
+ * core 0 runs threads
+ */
+
+#include "thread.h"
+
+#include "interrupts.h"
+#include "memory.h"
+#include "soc.h"
+#include "timer.h"
+#include "trace.h"
+
+static struct thread threads[THREAD_MAX];
+static struct thread *current, *idle_thread;
+
+static struct thread *run_head[THREAD_PRIORITIES];
+static struct thread *run_tail[THREAD_PRIORITIES];
+static unsigned int run_mask;
+
+/* In order of wake-up time */
+static struct thread *sleepers;
+
+/* Why the scheduler needs to run: a thread of higher priority than the
+ * running one is ready, or the running one has had its turn (end of time
+ * slice, or yielded) and others of the same priority may go. A running
+ * thread that blocks always gives way
+ */
+#define SWITCH_PREEMPT	1
+#define SWITCH_TURN	2
+static unsigned int need_switch;
+
+static unsigned int slice_end;
+static unsigned int switch_count;
+
+/* thread_preempt_off() nesting. Only the running thread changes it */
+static unsigned int preempt_off;
+
+/* Stacks for threads 1 onwards. Thread 0 ("main") keeps the stack it
+ * started on
+ */
+static unsigned int stacks;
+
+/* Shortest time ahead to set the timer for, so that it can't have gone
+ * past before it's set
+ */
+#define THREAD_TIMER_MIN	10
+
+static void set_timer(void)
+{
+	unsigned int next = slice_end;
+	unsigned int now = timer_read();
+
+	if(sleepers && (int)(sleepers->wake - next) < 0)
+		next = sleepers->wake;
+
+	if((int)(next - now) < THREAD_TIMER_MIN)
+		next = now + THREAD_TIMER_MIN;
+
+	timer_compare(TIMER_THREADS, next);
+}
+
+static void run_add(struct thread *t)
+{
+	t->state = THREAD_READY;
+	t->next = 0;
+
+	if(run_tail[t->priority])
+		run_tail[t->priority]->next = t;
+	else
+		run_head[t->priority] = t;
+	run_tail[t->priority] = t;
+	run_mask |= 1<<t->priority;
+
+	if(current && t->priority > current->priority)
+		need_switch |= SWITCH_PREEMPT;
+}
+
+/* Highest priority ready thread. There's always one, as the idle thread
+ * never blocks
+ */
+static struct thread *run_take(void)
+{
+	unsigned int priority = 31 - __builtin_clz(run_mask);
+	struct thread *t = run_head[priority];
+
+	run_head[priority] = t->next;
+	if(!t->next)
+	{
+		run_tail[priority] = 0;
+		run_mask &= ~(1<<priority);
+	}
+
+	return t;
+}
+
+unsigned int thread_switch(unsigned int frame)
+{
+	struct thread *prev = current, *next;
+	unsigned int top, reason = need_switch;
+
+	/* Interrupts come before thread_init(), or without it if it failed */
+	if(!current)
+		return frame;
+
+	/* A thread that's blocked (or exited) always gives way, whether or
+	 * not anything else asked for a switch
+	 */
+	if(!reason && prev->state == THREAD_RUNNING)
+		return frame;
+
+	need_switch = 0;
+
+	/* Keep running the current thread unless something of higher
+	 * priority is ready, or one of the same priority and it's had its
+	 * turn
+	 */
+	if(prev->state == THREAD_RUNNING)
+	{
+		/* Leave need_switch set for thread_preempt_on() */
+		if(preempt_off)
+		{
+			need_switch = reason;
+			return frame;
+		}
+
+		if(!run_mask)
+			return frame;
+
+		top = 31 - __builtin_clz(run_mask);
+		if(top < prev->priority ||
+			(top == prev->priority && !(reason & SWITCH_TURN)))
+			return frame;
+
+		run_add(prev);
+	}
+
+	prev->sp = frame;
+	if(prev->state == THREAD_DEAD)
+		prev->state = THREAD_FREE;
+
+	next = run_take();
+	next->state = THREAD_RUNNING;
+	next->switches++;
+	current = next;
+
+	if(next != prev)
+	{
+		switch_count++;
+		trace(TRACE_THREAD_SWITCH, (unsigned int)prev, (unsigned int)next);
+
+		/* An exclusive load in one thread mustn't be paired with a
+		 * store in another
+		 */
+		asm volatile("clrex");
+	}
+
+	slice_end = timer_read() + THREAD_SLICE;
+	set_timer();
+
+	return next->sp;
+}
+
+/* Run the scheduler from a thread: save the thread's registers in a frame
+ * as interrupt_irq_entry() (interrupts.c) does, with the caller as the
+ * return address, and go back to whichever frame thread_switch() picks.
+ * reason is added to need_switch
+ */
+__attribute__ ((naked)) static void reschedule(unsigned int reason)
+{
+	asm volatile("sub sp, sp, #8\n"
+		"push {r0-r12, lr}\n"
+		"str lr, [sp, #56]\n"		/* pc */
+		"mrs r1, cpsr\n"
+		"str r1, [sp, #60]\n"		/* cpsr */
+		"cpsid i\n"
+		"mov r1, r0\n"
+		"mov r0, sp\n"
+		"bl reschedule_switch\n"
+		"mov sp, r0\n"
+		"pop {r0-r12, lr}\n"
+		"rfeia sp!\n"
+	);
+}
+
+/* Called by reschedule(), with IRQs disabled */
+unsigned int reschedule_switch(unsigned int frame, unsigned int reason)
+{
+	need_switch |= reason;
+
+	return thread_switch(frame);
+}
+
+/* Switch now if a higher priority thread has been made ready, unless this
+ * is an interrupt handler (which switches on the way out) or IRQs are
+ * disabled
+ */
+static void preempt(void)
+{
+	if(need_switch && !irq_disabled())
+		reschedule(0);
+}
+
+void thread_preempt_off(void)
+{
+	preempt_off++;
+}
+
+void thread_preempt_on(void)
+{
+	if(--preempt_off == 0)
+		preempt();
+}
+
+void thread_yield(void)
+{
+	if(current)
+		reschedule(SWITCH_TURN);
+}
+
+struct thread *thread_current(void)
+{
+	return current;
+}
+
+struct thread *thread_idle(void)
+{
+	return idle_thread;
+}
+
+unsigned int thread_switches(void)
+{
+	return switch_count;
+}
+
+void thread_exit(void)
+{
+	irq_save();
+	current->state = THREAD_DEAD;
+	reschedule(0);
+
+	/* Never gets here */
+	while(1);
+}
+
+/* Where new threads start. fn and arg are in the registers of the frame
+ * thread_create() built
+ */
+static void thread_start(void *arg, void (*fn)(void *arg))
+{
+	fn(arg);
+	thread_exit();
+}
+
+struct thread *thread_create(const char *name, void (*fn)(void *arg),
+	void *arg, unsigned int priority)
+{
+	struct thread *t = 0;
+	struct thread_frame *frame;
+	unsigned int n, cpsr;
+
+	if(!stacks)
+		return 0;
+
+	if(priority >= THREAD_PRIORITIES)
+		priority = THREAD_PRIORITIES - 1;
+
+	cpsr = irq_save();
+
+	for(n=1; n<THREAD_MAX; n++)
+	{
+		if(threads[n].state == THREAD_FREE)
+		{
+			t = &threads[n];
+			break;
+		}
+	}
+
+	if(!t)
+	{
+		irq_restore(cpsr);
+		return 0;
+	}
+
+	/* A frame at the top of the stack which "returns" to thread_start(),
+	 * in system mode with IRQs enabled
+	 */
+	frame = (struct thread_frame *)(stacks + (n + 1) * THREAD_STACK_SIZE) - 1;
+	frame->r[0] = (unsigned int)arg;
+	frame->r[1] = (unsigned int)fn;
+	frame->lr = 0;
+	frame->pc = (unsigned int)thread_start;
+	frame->cpsr = 0x1f;
+
+	t->sp = (unsigned int)frame;
+	t->priority = priority;
+	t->name = name;
+	t->switches = 0;
+	run_add(t);
+
+	irq_restore(cpsr);
+	preempt();
+
+	return t;
+}
+
+void thread_sleep(unsigned int microseconds)
+{
+	struct thread **p;
+	unsigned int cpsr, start;
+
+	/* Before thread_init(), there's nothing else to run */
+	if(!current)
+	{
+		start = timer_read();
+		while(timer_read() - start < microseconds);
+		return;
+	}
+
+	cpsr = irq_save();
+
+	current->wake = timer_read() + microseconds;
+	current->state = THREAD_SLEEPING;
+
+	for(p=&sleepers; *p && (int)((*p)->wake - current->wake) <= 0;
+		p=&(*p)->next);
+	current->next = *p;
+	*p = current;
+
+	set_timer();
+	reschedule(0);
+
+	irq_restore(cpsr);
+}
+
+void thread_wait(struct wait_queue *queue)
+{
+	current->state = THREAD_WAITING;
+	current->next = 0;
+
+	if(queue->tail)
+		queue->tail->next = current;
+	else
+		queue->head = current;
+	queue->tail = current;
+
+	reschedule(0);
+}
+
+unsigned int thread_wake_one(struct wait_queue *queue)
+{
+	struct thread *t;
+	unsigned int cpsr = irq_save();
+
+	t = queue->head;
+	if(t)
+	{
+		queue->head = t->next;
+		if(!queue->head)
+			queue->tail = 0;
+		run_add(t);
+	}
+
+	irq_restore(cpsr);
+	preempt();
+
+	return t != 0;
+}
+
+unsigned int thread_wake_all(struct wait_queue *queue)
+{
+	struct thread *t;
+	unsigned int cpsr = irq_save();
+	unsigned int count = 0;
+
+	while((t = queue->head))
+	{
+		queue->head = t->next;
+		run_add(t);
+		count++;
+	}
+	queue->tail = 0;
+
+	irq_restore(cpsr);
+	preempt();
+
+	return count;
+}
+
+/* End of a time slice, or time for a sleeping thread to wake up */
+static void thread_timer_irq(void)
+{
+	unsigned int now = timer_read();
+	struct thread *t;
+
+	timer_compare_clear(TIMER_THREADS);
+
+	while(sleepers && (int)(now - sleepers->wake) >= 0)
+	{
+		t = sleepers;
+		sleepers = t->next;
+		run_add(t);
+	}
+
+	if((int)(now - slice_end) >= 0)
+	{
+		need_switch |= SWITCH_TURN;
+		/* If nothing else is ready, the thread gets another slice */
+		slice_end = now + THREAD_SLICE;
+	}
+
+	set_timer();
+}
+
+static void idle(void *arg)
+{
+	while(1)
+		cpu_wait();
+}
+
+void thread_init(void)
+{
+	stacks = (unsigned int)mem_alloc(THREAD_MAX * THREAD_STACK_SIZE,
+		MEM_CACHED);
+	if(!stacks)
+		return;
+
+	current = &threads[0];
+	current->state = THREAD_RUNNING;
+	current->priority = THREAD_PRIORITY_NORMAL;
+	current->name = "main";
+	slice_end = timer_read() + THREAD_SLICE;
+
+	timer_compare_clear(TIMER_THREADS);
+	set_timer();
+	interrupt_register(IRQ_SYSTIMER(TIMER_THREADS), thread_timer_irq);
+
+	idle_thread = thread_create("idle", idle, 0, THREAD_PRIORITY_IDLE);
+}
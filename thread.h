@@ -0,0 +1,121 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+/* Kernel threads, with priorities and preemption
+ *
+ * Threads run in system mode on core 0, each on its own stack. The highest
+ * priority thread that's ready always runs; threads of the same priority
+ * take turns, THREAD_SLICE microseconds at a time. The scheduler runs on
+ * the way out of every interrupt (interrupt_irq(), in interrupts.c), which
+ * saves all of a thread's registers on its stack as a struct thread_frame,
+ * so switching thread is just returning to a different frame. Yielding
+ * builds the same frame (thread_yield(), here)
+ *
+ * thread_init() turns whatever called it into the "main" thread, and
+ * starts an idle thread which waits for interrupts whenever nothing else
+ * can run
+ *
+ * Threads can't be created from interrupt handlers, but handlers can wake
+ * them (thread_wake_one/all()); the switch happens when the handler
+ * returns
+ */
+
+#define THREAD_MAX		16
+#define THREAD_STACK_SIZE	0x2000
+
+/* Priorities: higher runs first */
+#define THREAD_PRIORITIES	32
+#define THREAD_PRIORITY_IDLE	0
+#define THREAD_PRIORITY_NORMAL	16
+#define THREAD_PRIORITY_HIGH	24
+
+/* Time slice, in microseconds */
+#define THREAD_SLICE		10000
+
+/* Thread states */
+#define THREAD_FREE		0
+#define THREAD_READY		1	/* In the run queue */
+#define THREAD_RUNNING		2
+#define THREAD_SLEEPING		3	/* thread_sleep() */
+#define THREAD_WAITING		4	/* In a wait queue */
+#define THREAD_DEAD		5	/* Exited; freed when switched away */
+
+/* Registers saved when a thread is interrupted or yields, from the lowest
+ * address
+ */
+struct thread_frame
+{
+	unsigned int r[13];
+	unsigned int lr;
+	unsigned int pc;
+	unsigned int cpsr;
+};
+
+struct thread
+{
+	unsigned int sp;		/* Saved frame, when not running */
+	unsigned int state;
+	unsigned int priority;
+	unsigned int wake;		/* timer_read() time, when sleeping */
+	struct thread *next;		/* In a run/wait queue or sleep list */
+	const char *name;
+	unsigned int switches;		/* Times switched to */
+};
+
+/* Threads waiting for something, in the order they started waiting */
+struct wait_queue
+{
+	struct thread *head, *tail;
+};
+
+#define WAIT_QUEUE_INIT	{ 0, 0 }
+
+extern void thread_init(void);
+
+/* Start fn(arg) in a new thread. If fn returns, the thread exits. Returns 0
+ * if there are already THREAD_MAX threads
+ */
+extern struct thread *thread_create(const char *name, void (*fn)(void *arg),
+	void *arg, unsigned int priority);
+
+extern struct thread *thread_current(void);
+
+/* The idle thread, which runs whenever nothing else can */
+extern struct thread *thread_idle(void);
+
+/* Keep the current thread running, though interrupts still are handled,
+ * until the matching thread_preempt_on(). Nests. For short sections that
+ * mustn't be interleaved with another thread, but are too long to hold up
+ * interrupts for (or use irq_save(), in interrupts.h). The thread mustn't
+ * block in between
+ */
+extern void thread_preempt_off(void);
+extern void thread_preempt_on(void);
+
+/* Let any other ready thread of the same or higher priority run */
+extern void thread_yield(void);
+
+/* Wait for at least microseconds */
+extern void thread_sleep(unsigned int microseconds);
+
+extern void thread_exit(void) __attribute__((noreturn));
+
+/* Wait in a wait queue until woken. Call with IRQs disabled, having checked
+ * whatever is being waited for, so that a wake-up from an interrupt handler
+ * can't be missed in between. IRQs are still disabled on return
+ */
+extern void thread_wait(struct wait_queue *queue);
+
+/* Wake the first, or every, thread in a wait queue. Returns the number
+ * woken
+ */
+extern unsigned int thread_wake_one(struct wait_queue *queue);
+extern unsigned int thread_wake_all(struct wait_queue *queue);
+
+/* From interrupt_irq(): the frame to return to */
+extern unsigned int thread_switch(unsigned int frame);
+
+/* Total context switches */
+extern unsigned int thread_switches(void);
+
+#endif	/* THREAD_H */
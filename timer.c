@@ -0,0 +1,46 @@
+#include "timer.h"
+#include "memory.h"
+
+/* System timer - BCM2835 peripherals guide, p.172
+ * Free-running 64 bit counter, incremented at 1MHz
+ */
+static volatile unsigned int *timerCS = (unsigned int *) mem_p2v(0x20003000);
+static volatile unsigned int *timerCLO = (unsigned int *) mem_p2v(0x20003004);
+/* Compare registers C0-C3 */
+static volatile unsigned int *timerC = (unsigned int *) mem_p2v(0x2000300c);
+
+unsigned int timer_read(void)
+{
+	return *timerCLO;
+}
+
+void timer_compare(unsigned int channel, unsigned int time)
+{
+	timerC[channel] = time;
+}
+
+/* Writing 1 to a channel's match bit clears it */
+void timer_compare_clear(unsigned int channel)
+{
+	*timerCS = 1<<channel;
+}
+
+/* Enable the cycle counter in the performance monitor control register,
+ * counting every cycle (no divider), and reset it to 0
+ * ARM1176JZF-S manual, 3-133
+ *
+ * On ARMv7, the control register (PMCR) has the same bits, but the cycle
+ * counter also has to be enabled on its own (bit 31 of PMCNTENSET)
+ */
+void cycles_init(void)
+{
+	if(cpu_is_arm11())
+	{
+		asm volatile("mcr p15, 0, %[pmnc], c15, c12, 0"
+			: : [pmnc] "r" (0x5));
+		return;
+	}
+
+	asm volatile("mcr p15, 0, %[pmcr], c9, c12, 0" : : [pmcr] "r" (0x5));
+	asm volatile("mcr p15, 0, %[set], c9, c12, 1" : : [set] "r" (1<<31));
+}
@@ -0,0 +1,48 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "soc.h"
+
+/* Read the free-running 1MHz system timer (lower 32 bits). Counts
+ * microseconds since the SoC came out of reset
+ */
+extern unsigned int timer_read(void);
+
+/* System timer compare channels. An interrupt (IRQ_SYSTIMER(channel)) is
+ * raised when the low 32 bits of the counter equal the channel's compare
+ * value, and stays raised until cleared. The GPU uses channels 0 and 2
+ */
+#define TIMER_THREADS	1	/* Thread time slices (thread.c) */
+#define TIMER_TASKS	3	/* Timer tasks (task.c) */
+
+extern void timer_compare(unsigned int channel, unsigned int time);
+extern void timer_compare_clear(unsigned int channel);
+
+/* Start the CPU cycle counter from 0. Each core has its own */
+extern void cycles_init(void);
+
+/* Read the CPU cycle counter. Inline, so that timing something doesn't
+ * include the cost of a function call
+ * ARM1176JZF-S manual, 3-137. ARMv7 moved it to the standard performance
+ * monitor registers (PMCCNTR)
+ */
+static inline unsigned int cycles_read(void)
+{
+	unsigned int count;
+
+#ifdef HOST
+	/* The host CPU's time stamp counter */
+	count = (unsigned int)__builtin_ia32_rdtsc();
+#else
+	if(cpu_is_arm11())
+		asm volatile("mrc p15, 0, %[count], c15, c12, 1"
+			: [count] "=r" (count));
+	else
+		asm volatile("mrc p15, 0, %[count], c9, c13, 0"
+			: [count] "=r" (count));
+#endif
+
+	return count;
+}
+
+#endif	/* TIMER_H */
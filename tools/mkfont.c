@@ -0,0 +1,308 @@
+/* Make a console font table (see font.h) from a BDF font
+ *
+ * mkfont [-2] name font.bdf >font_name.c
+ *
+ * The font's bounding box (FONTBOUNDINGBOX) is the character cell, so any
+ * spacing between characters should be part of it. Characters 0-255 are
+ * used; anything else in the font is ignored. -2 doubles the size, with
+ * the SAA5050's character rounding to smooth the diagonals
+ *
+ * This runs on the build machine, not the Pi
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CHARS	256
+/* Largest cell, after doubling. The width is limited by the glyph rows
+ * being words
+ */
+#define MAX_WIDTH	32
+#define MAX_HEIGHT	64
+
+static const char *program;
+static const char *filename;
+static unsigned int line_number;
+
+/* Glyph rows, bit (width-1) leftmost */
+static unsigned int glyphs[MAX_CHARS][MAX_HEIGHT];
+static unsigned int present[MAX_CHARS];
+
+static unsigned int width, height;
+
+static void fail(const char *message)
+{
+	fprintf(stderr, "%s: %s:%u: %s\n", program, filename, line_number,
+		message);
+	exit(1);
+}
+
+static unsigned int pixel(const unsigned int *rows, int x, int y)
+{
+	if(x < 0 || y < 0 || x >= (int)width || y >= (int)height)
+		return 0;
+
+	return (rows[y] >> (width - 1 - x)) & 1;
+}
+
+static void set(unsigned int *rows, unsigned int w, int x, int y)
+{
+	rows[y] |= 1u << (w - 1 - x);
+}
+
+/* Double the size of a glyph. Where two pixels touch only at the corners,
+ * the SAA5050 fills in half a pixel either side of the corner, which turns
+ * steps into smooth diagonals
+ */
+static void double_glyph(unsigned int *rows)
+{
+	unsigned int result[MAX_HEIGHT];
+	int x, y;
+
+	memset(result, 0, sizeof(result));
+
+	for(y=0; y<(int)height; y++)
+	{
+		for(x=0; x<(int)width; x++)
+		{
+			if(!pixel(rows, x, y))
+				continue;
+
+			set(result, width * 2, x * 2, y * 2);
+			set(result, width * 2, x * 2 + 1, y * 2);
+			set(result, width * 2, x * 2, y * 2 + 1);
+			set(result, width * 2, x * 2 + 1, y * 2 + 1);
+
+			/* Down and right */
+			if(pixel(rows, x + 1, y + 1) && !pixel(rows, x + 1, y) &&
+				!pixel(rows, x, y + 1))
+			{
+				set(result, width * 2, x * 2 + 2, y * 2 + 1);
+				set(result, width * 2, x * 2 + 1, y * 2 + 2);
+			}
+
+			/* Down and left */
+			if(pixel(rows, x - 1, y + 1) && !pixel(rows, x - 1, y) &&
+				!pixel(rows, x, y + 1))
+			{
+				set(result, width * 2, x * 2 - 1, y * 2 + 1);
+				set(result, width * 2, x * 2, y * 2 + 2);
+			}
+		}
+	}
+
+	memcpy(rows, result, sizeof(result));
+}
+
+/* Shift s for fastdiv() (see fastdiv.h) by d, which gives exact results for
+ * every screen coordinate
+ */
+static unsigned int div_shift(unsigned int d)
+{
+	unsigned long long magic;
+	unsigned int s, x;
+
+	for(s=0; s<32; s++)
+	{
+		magic = (0x100000000ULL << s) / d + 1;
+		if(magic > 0xffffffffULL)
+			continue;
+
+		for(x=0; x<65536; x++)
+			if(((x * magic) >> 32 >> s) != x / d)
+				break;
+
+		if(x == 65536)
+			return s;
+	}
+
+	fprintf(stderr, "%s: no fastdiv shift for %u\n", program, d);
+	exit(1);
+}
+
+static void div_magic(unsigned int d, unsigned int *magic,
+	unsigned int *shift)
+{
+	*shift = div_shift(d);
+	*magic = (unsigned int)((0x100000000ULL << *shift) / d + 1);
+}
+
+int main(int argc, char *argv[])
+{
+	char line[256];
+	FILE *f;
+	int scale = 1;
+	int box_x = 0, box_y = 0, ascent = -1;
+	int bbx_w = 0, bbx_h = 0, bbx_x = 0, bbx_y = 0;
+	int encoding = -1, default_char = 32, row = -1;
+	unsigned int bits, ch, first, last, missing, col, y;
+	unsigned int magic_x, shift_x, magic_y, shift_y;
+	const char *name;
+
+	program = argv[0];
+
+	if(argc > 1 && strcmp(argv[1], "-2") == 0)
+	{
+		scale = 2;
+		argc--;
+		argv++;
+	}
+
+	if(argc != 3)
+	{
+		fprintf(stderr, "Usage: %s [-2] name font.bdf\n", program);
+		return 1;
+	}
+
+	name = argv[1];
+	filename = argv[2];
+
+	f = fopen(filename, "r");
+	if(!f)
+	{
+		perror(filename);
+		return 1;
+	}
+
+	while(fgets(line, sizeof(line), f))
+	{
+		line_number++;
+
+		/* Bitmap rows, until ENDCHAR */
+		if(row >= 0)
+		{
+			if(strncmp(line, "ENDCHAR", 7) == 0)
+			{
+				row = -1;
+				continue;
+			}
+
+			if(row >= bbx_h)
+				fail("too many bitmap rows");
+
+			bits = strtoul(line, 0, 16);
+			/* Bytes are padded on the right */
+			bits >>= ((bbx_w + 7) / 8) * 8 - bbx_w;
+
+			for(col=0; col<(unsigned int)bbx_w; col++)
+			{
+				if(!(bits & (1u << (bbx_w - 1 - col))))
+					continue;
+
+				/* Position in the cell, from the top left */
+				y = ascent - 1 - (bbx_y + bbx_h - 1 - row);
+				if(bbx_x - box_x + col >= width || y >= height)
+					fail("glyph outside the bounding box");
+
+				set(glyphs[encoding], width,
+					bbx_x - box_x + col, y);
+			}
+
+			row++;
+			continue;
+		}
+
+		if(sscanf(line, "FONTBOUNDINGBOX %u %u %d %d", &width, &height,
+			&box_x, &box_y) == 4)
+		{
+			if(width * scale > MAX_WIDTH ||
+				height * scale > MAX_HEIGHT)
+				fail("font too big");
+		}
+		else if(sscanf(line, "FONT_ASCENT %d", &ascent) == 1)
+			;
+		else if(sscanf(line, "DEFAULT_CHAR %d", &default_char) == 1)
+			;
+		else if(sscanf(line, "ENCODING %d", &encoding) == 1)
+			;
+		else if(sscanf(line, "BBX %d %d %d %d", &bbx_w, &bbx_h, &bbx_x,
+			&bbx_y) == 4)
+			;
+		else if(strncmp(line, "BITMAP", 6) == 0)
+		{
+			if(width == 0)
+				fail("BITMAP before FONTBOUNDINGBOX");
+
+			if(ascent < 0)
+				ascent = height + box_y;
+
+			/* Skip characters which don't fit in 8 bits */
+			if(encoding < 0 || encoding >= MAX_CHARS)
+			{
+				while(fgets(line, sizeof(line), f))
+				{
+					line_number++;
+					if(strncmp(line, "ENDCHAR", 7) == 0)
+						break;
+				}
+				continue;
+			}
+
+			present[encoding] = 1;
+			row = 0;
+		}
+	}
+
+	fclose(f);
+
+	for(first=0; first<MAX_CHARS && !present[first]; first++);
+	for(last=MAX_CHARS-1; last>first && !present[last]; last--);
+
+	if(first == MAX_CHARS)
+		fail("no characters");
+
+	if(default_char < (int)first || default_char > (int)last ||
+		!present[default_char])
+		default_char = first;
+	missing = default_char - first;
+
+	if(scale == 2)
+	{
+		for(ch=first; ch<=last; ch++)
+			double_glyph(glyphs[ch]);
+
+		width *= 2;
+		height *= 2;
+	}
+
+	div_magic(width, &magic_x, &shift_x);
+	div_magic(height, &magic_y, &shift_y);
+
+	printf("/* %s font, %ux%u\n *\n * Generated from %s by mkfont%s - "
+		"don't edit\n */\n\n", name, width, height, filename,
+		scale == 2 ? " -2" : "");
+	printf("#include \"font.h\"\n\n");
+	printf("static const unsigned int glyphs[%u][%u] "
+		"__attribute__((aligned (32))) = {\n", last - first + 1,
+		height);
+
+	for(ch=first; ch<=last; ch++)
+	{
+		if(!present[ch])
+			memcpy(glyphs[ch], glyphs[default_char],
+				sizeof(glyphs[ch]));
+
+		if(ch >= 32 && ch < 127 && ch != '*' && ch != '/')
+			printf("\t/* 0x%02x '%c' */\n", ch, ch);
+		else
+			printf("\t/* 0x%02x */\n", ch);
+
+		printf("\t{");
+		for(y=0; y<height; y++)
+			printf("%s0x%0*x%s", y % 8 ? " " : "\n\t\t",
+				(width + 3) / 4, glyphs[ch][y],
+				y < height - 1 ? "," : "");
+		printf("\n\t}%s\n", ch < last ? "," : "");
+	}
+
+	printf("};\n\n");
+	printf("const struct font font_%s = {\n", name);
+	printf("\t\"%s\", %u, %u, %u, %u, %u, glyphs[0],\n", name, width,
+		height, first, last - first + 1, missing);
+	printf("\t0x%08x, %u, 0x%08x, %u\n", magic_x, shift_x, magic_y,
+		shift_y);
+	printf("};\n");
+
+	return 0;
+}
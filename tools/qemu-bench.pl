@@ -0,0 +1,158 @@
+#!/usr/bin/perl
+#
+# Boot a kernel in qemu and collect the timings it sends to the serial port
+# ("make qemu-bench")
+#
+# Usage: qemu-bench.pl qemu machine timeout output.json kernel.img
+#
+# The kernel sends these lines, among its console output:
+#	BOOT stage time		When each stage of booting finished, in
+#				microseconds since reset (main.c). "ready"
+#				is the last
+#	BENCH value units name	A benchmark result (benchmark.c, with
+#				BENCHMARK=1)
+#	MEM memory size read write copy chase
+#				A row of the memory benchmark
+#	EXPECT type		The next abort of that type is deliberate
+#	ABORT type address fault
+#				An abort (interrupts.c)
+#
+# The results go in output.json, and everything from the serial port in
+# the same name ending .log. Fails if the kernel hasn't reached "ready"
+# within timeout seconds, qemu stops first, or there's an abort which
+# wasn't expected
+
+use strict;
+use warnings;
+
+die "Usage: $0 qemu machine timeout output.json kernel.img\n"
+	unless @ARGV == 5;
+my ($qemu, $machine, $timeout, $output, $kernel) = @ARGV;
+
+(my $logname = $output) =~ s/(\.json)?$/.log/;
+open(my $log, '>', $logname) or die "Can't write $logname: $!\n";
+
+my @command = ($qemu, '-M', $machine, '-kernel', $kernel,
+	'-serial', 'stdio', '-display', 'none', '-monitor', 'none');
+my $pid = open(my $serial, '-|', @command)
+	or die "Can't run $qemu: $!\n";
+
+my (@boot, @bench, @memory, %expected);
+my $status = "qemu stopped before the kernel was ready";
+
+eval {
+	local $SIG{ALRM} = sub { die "timeout\n" };
+	alarm $timeout;
+
+	while(my $line = <$serial>)
+	{
+		print $log $line;
+		$line =~ s/\r?\n$//;
+
+		# Console text without a newline may come first on the line
+		if($line =~ /BOOT (\S+) (\d+)$/)
+		{
+			push @boot, [$1, $2];
+			if($1 eq 'ready')
+			{
+				$status = 'ok';
+				last;
+			}
+		}
+		elsif($line =~ /BENCH (\d+) (\S+) (.*)$/)
+		{
+			push @bench, { name => $3, value => $1, units => $2 };
+		}
+		elsif($line =~ /MEM (\S+) (\d+) (\d+) (\d+) (\d+) (\d+)$/)
+		{
+			push @memory, { memory => $1, size => $2, read => $3,
+				write => $4, copy => $5, chase => $6 };
+		}
+		elsif($line =~ /EXPECT (\S+)$/)
+		{
+			$expected{$1}++;
+		}
+		elsif($line =~ /ABORT (\S+) (.*)$/)
+		{
+			if($expected{$1})
+			{
+				$expected{$1}--;
+				next;
+			}
+
+			$status = "unexpected $1 abort ($2)";
+			last;
+		}
+	}
+
+	alarm 0;
+};
+if($@)
+{
+	die $@ unless $@ eq "timeout\n";
+	$status = "timed out after ${timeout}s (hung?)";
+}
+
+kill 'TERM', $pid;
+close($serial);
+close($log);
+
+# JSON string, escaped
+sub json_string
+{
+	my ($string) = @_;
+
+	$string =~ s/(["\\])/\\$1/g;
+	$string =~ s/([\x00-\x1f])/sprintf("\\u%04x", ord($1))/ge;
+
+	return "\"$string\"";
+}
+
+# One JSON object per line, keys in the order given
+sub json_object
+{
+	my ($object, @keys) = @_;
+
+	return "{ " . join(", ", map {
+		json_string($_) . ": " . ($object->{$_} =~ /^\d+$/ ?
+			$object->{$_} : json_string($object->{$_}))
+	} @keys) . " }";
+}
+
+my $commit = `git rev-parse --short HEAD 2>/dev/null` || '';
+chomp $commit;
+
+open(my $json, '>', $output) or die "Can't write $output: $!\n";
+print $json "{\n";
+print $json "  \"commit\": ", json_string($commit), ",\n";
+print $json "  \"machine\": ", json_string($machine), ",\n";
+print $json "  \"status\": ", json_string($status), ",\n";
+print $json "  \"boot\": [\n", join(",\n", map {
+	"    " . json_object({ stage => $_->[0], time => $_->[1] },
+		qw(stage time))
+} @boot), "\n  ],\n";
+print $json "  \"benchmarks\": [\n", join(",\n", map {
+	"    " . json_object($_, qw(name value units))
+} @bench), "\n  ],\n";
+print $json "  \"memory\": [\n", join(",\n", map {
+	"    " . json_object($_, qw(memory size read write copy chase))
+} @memory), "\n  ]\n";
+print $json "}\n";
+close($json);
+
+# Boot stages as time taken since the one before
+my $last;
+foreach my $stage (@boot)
+{
+	printf("%-12s %10uus\n", $stage->[0],
+		defined($last) ? $stage->[1] - $last : $stage->[1]);
+	$last = $stage->[1];
+}
+printf("%u benchmark results, %u memory rows; written to %s\n",
+	scalar(@bench), scalar(@memory), $output);
+
+if($status ne 'ok')
+{
+	print STDERR "qemu-bench: $status (see $logname)\n";
+	exit 1;
+}
@@ -0,0 +1,106 @@
+/* Event tracing (see trace.h) */
+
+#include "trace.h"
+
+#include "framebuffer.h"
+#include "kprintf.h"
+#include "memory.h"
+#include "uart.h"
+
+static const char *event_names[TRACE_EVENTS] = {
+	"?",
+	"IRQ entry",
+	"IRQ exit",
+	"Mailbox write",
+	"Mailbox read",
+	"Console flush",
+	"Data abort",
+	"Prefetch abort",
+	"Thread switch",
+	"Task",
+};
+
+/* Lines trace_stream() sends before waiting for the serial port to catch
+ * up. Well within its transmit buffer
+ */
+#define TRACE_STREAM_BATCH	32
+
+void trace_init(void)
+{
+	unsigned int core;
+
+	for(core=0; core<SMP_MAX_CORES; core++)
+		if(smp_cores[core].online)
+			smp_cores[core].trace =
+				mem_alloc_cached(sizeof(struct trace_buffer));
+}
+
+void trace_dump(unsigned int count)
+{
+	struct smp_core *core = smp_this();
+	struct trace_buffer *buffer;
+	struct trace_record *record, *last;
+	unsigned int position;
+
+	if(!core || !(buffer = core->trace) || buffer->next == 0)
+		return;
+
+	if(count > buffer->next)
+		count = buffer->next;
+	if(count > TRACE_RECORDS)
+		count = TRACE_RECORDS;
+
+	last = &buffer->records[(buffer->next - 1) & (TRACE_RECORDS - 1)];
+
+	kprintf(COLOUR_PUSH FG_CYAN "Last %u trace records, core %u (cycles "
+		"before the last):\n", count, core->id);
+
+	for(position=buffer->next-count; position!=buffer->next; position++)
+	{
+		record = &buffer->records[position & (TRACE_RECORDS - 1)];
+
+		kprintf("  %10u  %-15s 0x%08X 0x%08X\n",
+			last->time - record->time,
+			record->event < TRACE_EVENTS ?
+				event_names[record->event] : "?",
+			record->a, record->b);
+	}
+
+	kprintf(COLOUR_POP);
+}
+
+void trace_stream(void)
+{
+	struct trace_buffer *buffer;
+	struct trace_record *record;
+	unsigned int core, position, first, sent = 0;
+	char line[64];
+
+	for(core=0; core<SMP_MAX_CORES; core++)
+	{
+		buffer = smp_cores[core].trace;
+		if(!buffer)
+			continue;
+
+		/* Taking a copy of next means records written meanwhile
+		 * aren't sent
+		 */
+		position = buffer->next;
+		first = position > TRACE_RECORDS ? position - TRACE_RECORDS : 0;
+
+		for(; first!=position; first++)
+		{
+			record = &buffer->records[first & (TRACE_RECORDS - 1)];
+
+			ksnprintf(line, sizeof(line), "TRACE %u %08x %x %08x "
+				"%08x\n", core, record->time, record->event,
+				record->a, record->b);
+
+			if(++sent % TRACE_STREAM_BATCH == 0)
+				while(!uart_tx_idle());
+			uart_write(line);
+		}
+	}
+
+	uart_write("TRACE END\n");
+}
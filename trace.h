@@ -0,0 +1,89 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Event tracing
+ *
+ * A tracepoint writes a 16 byte record - cycle count, event and two
+ * arguments - into its core's ring of the last TRACE_RECORDS, which costs
+ * a handful of stores and nothing else: no formatting, and no output. The
+ * abort handlers print the last few records, and trace_stream() sends the
+ * lot over the serial port for working through afterwards
+ *
+ * Times are each core's cycle counter, which the benchmarks reset
+ */
+
+#include "interrupts.h"
+#include "smp.h"
+#include "timer.h"
+
+/* Records kept per core. Must be a power of 2 */
+#define TRACE_RECORDS	256
+
+/* Records printed by the abort handlers */
+#define TRACE_DUMP_ABORT	16
+
+/* Events, and their arguments */
+#define TRACE_IRQ_ENTRY		1	/* Interrupted pc, frame */
+#define TRACE_IRQ_EXIT		2	/* Resumed pc, frame */
+#define TRACE_MAILBOX_WRITE	3	/* Channel, data */
+#define TRACE_MAILBOX_READ	4	/* Channel, data (0xffffffff on
+					 * timeout) */
+#define TRACE_CONSOLE_FLUSH	5	/* Rectangles, microseconds */
+#define TRACE_DATA_ABORT	6	/* Instruction, fault address */
+#define TRACE_PREFETCH_ABORT	7	/* Instruction */
+#define TRACE_THREAD_SWITCH	8	/* From thread, to thread */
+#define TRACE_TASK		9	/* Function, latency in cycles */
+#define TRACE_EVENTS		10
+
+struct trace_record
+{
+	unsigned int time;		/* cycles_read() */
+	unsigned int event;
+	unsigned int a, b;
+};
+
+struct trace_buffer
+{
+	unsigned int next;		/* Position of the next record */
+	struct trace_record records[TRACE_RECORDS];
+};
+
+/* Give each core that's running a buffer. Until then, tracepoints do
+ * nothing
+ */
+extern void trace_init(void);
+
+static inline void trace(unsigned int event, unsigned int a, unsigned int b)
+{
+	struct smp_core *core = smp_this();
+	struct trace_buffer *buffer;
+	struct trace_record *record;
+	unsigned int cpsr;
+
+	/* Nothing before smp_init() and trace_init() */
+	if(!core || !(buffer = core->trace))
+		return;
+
+	/* An interrupt handler's records go after this one's, rather than
+	 * into the same slot
+	 */
+	cpsr = irq_save();
+	record = &buffer->records[buffer->next++ & (TRACE_RECORDS - 1)];
+	irq_restore(cpsr);
+
+	record->time = cycles_read();
+	record->event = event;
+	record->a = a;
+	record->b = b;
+}
+
+/* Print this core's last count records on the console */
+extern void trace_dump(unsigned int count);
+
+/* Send every core's records over the serial port, oldest first, a line
+ * each: "TRACE core time event a b", in hex. Waits for the serial port, so
+ * call it with IRQs enabled
+ */
+extern void trace_stream(void);
+
+#endif	/* TRACE_H */
@@ -0,0 +1,303 @@
+/* PL011 UART (UART0) console output
+ *
+ * Everything written to the console is also sent out of the UART, on GPIO
+ * 14 (TXD) and 15 (RXD) at 115200 baud, 8N1. Under qemu
+ * (-M raspi0/raspi1ap -serial stdio), this appears on the terminal.
+ *
+ * Output and input both go through ring buffers serviced by the UART
+ * interrupt, so writers never wait for the transmit FIFO to empty. If the
+ * transmit ring is full, characters are dropped and counted rather than
+ * holding up the caller
+ */
+
+#include "uart.h"
+
+#include "barrier.h"
+#include "interrupts.h"
+#include "kprintf.h"
+#include "mailbox.h"
+#include "memory.h"
+
+/* PL011 registers - BCM2835 peripherals guide, p.177 */
+static volatile unsigned int *uartDR = (unsigned int *) mem_p2v(0x20201000);
+static volatile unsigned int *uartRSRECR = (unsigned int *) mem_p2v(0x20201004);
+static volatile unsigned int *uartFR = (unsigned int *) mem_p2v(0x20201018);
+static volatile unsigned int *uartIBRD = (unsigned int *) mem_p2v(0x20201024);
+static volatile unsigned int *uartFBRD = (unsigned int *) mem_p2v(0x20201028);
+static volatile unsigned int *uartLCRH = (unsigned int *) mem_p2v(0x2020102c);
+static volatile unsigned int *uartCR = (unsigned int *) mem_p2v(0x20201030);
+static volatile unsigned int *uartIFLS = (unsigned int *) mem_p2v(0x20201034);
+static volatile unsigned int *uartIMSC = (unsigned int *) mem_p2v(0x20201038);
+static volatile unsigned int *uartMIS = (unsigned int *) mem_p2v(0x20201040);
+static volatile unsigned int *uartICR = (unsigned int *) mem_p2v(0x20201044);
+
+/* GPIO registers used to hand pins 14/15 to the UART */
+static volatile unsigned int *gpioGPFSEL1 = (unsigned int *) mem_p2v(0x20200004);
+static volatile unsigned int *gpioGPPUD = (unsigned int *) mem_p2v(0x20200094);
+static volatile unsigned int *gpioPUDCLK0 = (unsigned int *) mem_p2v(0x20200098);
+
+/* Flag register bits */
+#define FR_BUSY		(1<<3)
+#define FR_RXFE		(1<<4)	/* Receive FIFO empty */
+#define FR_TXFF		(1<<5)	/* Transmit FIFO full */
+
+/* Interrupt bits (IMSC/MIS/ICR) */
+#define INT_RX		(1<<4)	/* Receive FIFO level */
+#define INT_TX		(1<<5)	/* Transmit FIFO level */
+#define INT_RT		(1<<6)	/* Receive timeout */
+#define INT_OE		(1<<10)	/* Receive overrun */
+
+/* Data register error bits */
+#define DR_OE		(1<<11)
+
+#define UART_BAUD	115200
+
+/* Used if the firmware won't say what the UART clock is. Older firmware
+ * runs it at 3MHz (newer at 48MHz)
+ */
+#define UART_DEFAULT_CLOCK	3000000
+
+/* Ring buffers. Sizes must be powers of 2. head is where the next byte is
+ * added, tail where the next one is taken from; head == tail when empty
+ */
+#define TX_RING_SIZE	4096
+#define RX_RING_SIZE	256
+
+static volatile unsigned char tx_ring[TX_RING_SIZE];
+static volatile unsigned int tx_head, tx_tail;
+static volatile unsigned char rx_ring[RX_RING_SIZE];
+static volatile unsigned int rx_head, rx_tail;
+
+static struct uart_stats stats;
+
+/* Set once the UART is ready; console output before then isn't sent */
+static unsigned int uart_ready = 0;
+
+/* Move as much of the transmit ring into the FIFO as will fit. If anything
+ * is left, enable the transmit interrupt to come back for it
+ * Called with IRQs disabled
+ */
+static void tx_fill_fifo(void)
+{
+	unsigned int tail = tx_tail;
+
+	while(tail != tx_head && !(*uartFR & FR_TXFF))
+	{
+		*uartDR = tx_ring[tail];
+		tail = (tail + 1) & (TX_RING_SIZE - 1);
+	}
+
+	tx_tail = tail;
+
+	if(tail == tx_head)
+		*uartIMSC &= ~INT_TX;
+	else
+		*uartIMSC |= INT_TX;
+}
+
+/* UART interrupt: empty the receive FIFO, top up the transmit FIFO */
+static void uart_irq(void)
+{
+	unsigned int status = *uartMIS;
+	unsigned int data, head;
+
+	dmb();
+
+	if(status & (INT_RX | INT_RT | INT_OE))
+	{
+		head = rx_head;
+
+		while(!(*uartFR & FR_RXFE))
+		{
+			data = *uartDR;
+
+			if(data & DR_OE)
+				stats.rx_overruns++;
+
+			if(((head + 1) & (RX_RING_SIZE - 1)) == rx_tail)
+			{
+				stats.rx_dropped++;
+				continue;
+			}
+
+			rx_ring[head] = data & 0xff;
+			head = (head + 1) & (RX_RING_SIZE - 1);
+			stats.rx_bytes++;
+		}
+
+		rx_head = head;
+
+		/* Clear the error flags */
+		*uartRSRECR = 0;
+	}
+
+	if(status & INT_TX)
+		tx_fill_fifo();
+
+	*uartICR = status;
+
+	dmb();
+}
+
+/* Ask VideoCore for the UART's clock rate (tag 0x30002, clock id 2) */
+static unsigned int uart_clock(void)
+{
+	volatile unsigned int mailbuffer[8] __attribute__((aligned (16)));
+
+	mailbuffer[0] = 8 * 4;		// Total size
+	mailbuffer[1] = 0;		// Request
+	mailbuffer[2] = 0x30002;	// Get clock rate
+	mailbuffer[3] = 8;		// Buffer size
+	mailbuffer[4] = 4;		// Request size
+	mailbuffer[5] = 2;		// Clock id (UART)
+	mailbuffer[6] = 0;		// Space for rate
+	mailbuffer[7] = 0;		// End tag
+
+	writemailbox(8, mem_v2p((unsigned int)mailbuffer));
+	readmailbox(8);
+
+	if(mailbuffer[1] != 0x80000000 || mailbuffer[6] == 0)
+		return UART_DEFAULT_CLOCK;
+
+	return mailbuffer[6];
+}
+
+void uart_init(void)
+{
+	unsigned int var, divider;
+
+	/* Disable the UART while it is set up */
+	*uartCR = 0;
+
+	/* GPIO 14 and 15 to alternate function 0 (TXD0/RXD0), no
+	 * pull-up/down
+	 */
+	var = *gpioGPFSEL1;
+	var &= ~((7<<12) | (7<<15));
+	var |= (4<<12) | (4<<15);
+	*gpioGPFSEL1 = var;
+
+	*gpioGPPUD = 0;
+	for(var=0; var<150; var++)
+		asm volatile("mov r0, r0");	/* No-op */
+	*gpioPUDCLK0 = (1<<14) | (1<<15);
+	for(var=0; var<150; var++)
+		asm volatile("mov r0, r0");
+	*gpioPUDCLK0 = 0;
+
+	/* Baud rate divider = clock / (16 * baud), as a 16.6 fixed point
+	 * number (rounded)
+	 */
+	divider = (uart_clock() * 4 + UART_BAUD / 2) / UART_BAUD;
+	*uartIBRD = divider >> 6;
+	*uartFBRD = divider & 63;
+
+	/* 8 bits, no parity, 1 stop bit, FIFOs enabled */
+	*uartLCRH = (3<<5) | (1<<4);
+
+	/* Interrupt when the transmit FIFO drops to 1/8 full, or the receive
+	 * FIFO reaches 1/2 full. The receive timeout interrupt picks up
+	 * anything less
+	 */
+	*uartIFLS = (2<<3) | 0;
+
+	*uartICR = 0x7ff;
+	*uartIMSC = INT_RX | INT_RT | INT_OE;
+
+	interrupt_register(IRQ_UART, uart_irq);
+
+	/* Enable UART, transmit and receive */
+	*uartCR = (1<<0) | (1<<8) | (1<<9);
+
+	uart_ready = 1;
+}
+
+/* Queue one character. Returns 0 if the ring is full */
+static inline unsigned int tx_put(unsigned char ch)
+{
+	unsigned int head = tx_head;
+	unsigned int next = (head + 1) & (TX_RING_SIZE - 1);
+
+	if(next == tx_tail)
+	{
+		stats.tx_dropped++;
+		return 0;
+	}
+
+	tx_ring[head] = ch;
+	tx_head = next;
+	stats.tx_bytes++;
+
+	return 1;
+}
+
+void uart_write(char *text)
+{
+	unsigned int cpsr;
+	unsigned char ch;
+
+	if(!uart_ready)
+		return;
+
+	/* Console output can come from interrupt handlers as well, and the
+	 * interrupt handler also takes from the ring, so keep IRQs off while
+	 * the ring is being changed
+	 */
+	cpsr = irq_save();
+
+	while((ch = (unsigned char)*text++))
+	{
+		/* Newlines need a carriage return for most terminals. The
+		 * console's colour control codes mean nothing to a terminal
+		 */
+		if(ch == '\n')
+		{
+			if(!tx_put('\r'))
+				break;
+		}
+		else if(ch < 32)
+		{
+			continue;
+		}
+
+		if(!tx_put(ch))
+			break;
+	}
+
+	/* Start sending. Anything which doesn't fit in the FIFO is sent by
+	 * the interrupt handler
+	 */
+	tx_fill_fifo();
+	irq_restore(cpsr);
+}
+
+int uart_getc(void)
+{
+	unsigned int tail = rx_tail;
+	int ch;
+
+	if(tail == rx_head)
+		return -1;
+
+	ch = rx_ring[tail];
+	rx_tail = (tail + 1) & (RX_RING_SIZE - 1);
+
+	return ch;
+}
+
+unsigned int uart_tx_idle(void)
+{
+	return tx_head == tx_tail && !(*uartFR & FR_BUSY);
+}
+
+const struct uart_stats *uart_get_stats(void)
+{
+	return &stats;
+}
+
+void uart_print_stats(void)
+{
+	kprintf("UART: %u bytes sent, %u dropped; %u received, %u dropped, "
+		"%u FIFO overruns\n", stats.tx_bytes, stats.tx_dropped,
+		stats.rx_bytes, stats.rx_dropped, stats.rx_overruns);
+}
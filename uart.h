@@ -0,0 +1,31 @@
+#ifndef UART_H
+#define UART_H
+
+/* Counters kept by the UART driver */
+struct uart_stats
+{
+	unsigned int tx_bytes;		/* Bytes queued for sending */
+	unsigned int tx_dropped;	/* Lost because the ring was full */
+	unsigned int rx_bytes;		/* Bytes received */
+	unsigned int rx_dropped;	/* Lost because the ring was full */
+	unsigned int rx_overruns;	/* Receive FIFO overruns */
+};
+
+extern void uart_init(void);
+
+/* Queue null-terminated text for sending. Console colour control codes are
+ * left out, and newlines become CR LF. Never waits; if the buffer is full,
+ * the rest of the text is dropped
+ */
+extern void uart_write(char *text);
+
+/* Next received character, or -1 if there isn't one */
+extern int uart_getc(void);
+
+/* Non-zero once everything queued has been sent */
+extern unsigned int uart_tx_idle(void);
+
+extern const struct uart_stats *uart_get_stats(void);
+extern void uart_print_stats(void);
+
+#endif	/* UART_H */
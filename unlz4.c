@@ -0,0 +1,234 @@
+/* Compressed kernel support
+ *
+ * "make kernel-lz4.img" builds a kernel.img where everything after initsys
+ * (the high kernel: .text, .rodata and .data) is compressed with LZ4. The
+ * firmware loads it at 0x8000 as usual; initsys calls unlz4_kernel() before
+ * setting up the page tables, and the high kernel is unpacked to the address
+ * it would have been loaded at had it not been compressed.
+ *
+ * This file is linked into the .init section alongside start.s and initsys.c
+ * and runs with the MMU off, so it must not call anything in the high kernel
+ * (including libgcc)
+ *
+ * A compressed image looks like this:
+ *
+ *	File offset	Load address
+ *	0x00000000	0x00008000	start.o/initsys.o/unlz4.o
+ *	0x00001000	0x00009000	Header (struct unlz4_header)
+ *	0x0000100c	0x0000900c	LZ4 legacy format stream
+ *
+ * The legacy format is a 4 byte magic number, followed by blocks of up to
+ * 8MB of uncompressed data. Each block is a 4 byte little-endian compressed
+ * size followed by an LZ4 compressed block. See
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ */
+
+#include "soc.h"
+
+/* System timer counter, lower 32 bits (1MHz), from the peripheral base.
+ * Physical address - the MMU isn't on yet
+ */
+#define timerCLO	((volatile unsigned int *) \
+				(soc_peripheral_base() + 0x3004))
+
+/* Header placed in front of the compressed data by the Makefile */
+struct unlz4_header
+{
+	unsigned int magic;		/* UNLZ4_MAGIC */
+	unsigned int packed_size;	/* Size of LZ4 stream, in bytes */
+	unsigned int unpacked_size;	/* Size of high kernel, in bytes */
+};
+
+/* "PiZ" + version 1 */
+#define UNLZ4_MAGIC		0x015a6950
+/* Magic number at the start of an LZ4 legacy stream */
+#define LZ4_LEGACY_MAGIC	0x184c2102
+
+/* Start-up timings, read by main() to report how long the kernel took to
+ * load and unpack. Times are system timer ticks (microseconds since the
+ * SoC came out of reset). If the kernel isn't compressed, boot_unpack_end
+ * is the same as boot_entry_time and the sizes are 0
+ *
+ * Initialised so that they aren't common symbols, which would go in the
+ * kernel's .bss rather than .init with the rest of unlz4.o
+ */
+unsigned int boot_entry_time = 0;
+unsigned int boot_unpack_end = 0;
+unsigned int boot_packed_size = 0;
+unsigned int boot_unpacked_size = 0;
+
+/* Start of the high kernel in physical memory, from linkscript */
+extern unsigned int _highkernelload;
+
+/* Copy memory upwards in 8-word bursts, in start.s */
+extern void init_move_up(void *dest_end, const void *src_end,
+			unsigned int length);
+
+/* Decompress one LZ4 block of length bytes from src to dest. Returns the
+ * address after the last byte written
+ *
+ * Each sequence is a token byte (literal length in the top 4 bits, match
+ * length - 4 in the bottom 4 bits, 15 meaning more length bytes follow),
+ * the literals, then a 2 byte offset back into the output for the match.
+ * The last sequence in a block has literals only.
+ *
+ * Unaligned access is turned on (start.s), so literals and non-overlapping
+ * matches are copied a word at a time. Copies never write past the end of
+ * the data being copied: with an in-place decompress, the compressed data
+ * is only just ahead of the output
+ *
+ * Not allowed to become a call to memcpy(), which isn't in .init
+ */
+__attribute__((optimize("no-tree-loop-distribute-patterns")))
+static unsigned char *unlz4_block(unsigned char *dest,
+	const unsigned char *src, unsigned int length)
+{
+	const unsigned char *end = src + length;
+	const unsigned char *match;
+	unsigned int token, len, offset;
+
+	while(src < end)
+	{
+		token = *src++;
+
+		/* Literal run */
+		len = token >> 4;
+		if(len == 15)
+		{
+			do
+			{
+				offset = *src++;
+				len += offset;
+			} while(offset == 255);
+		}
+
+		while(len >= 4)
+		{
+			*(unsigned int *)dest = *(unsigned int *)src;
+			dest += 4;
+			src += 4;
+			len -= 4;
+		}
+		while(len--)
+			*dest++ = *src++;
+
+		/* Last sequence has no match */
+		if(src >= end)
+			break;
+
+		offset = src[0] | (src[1] << 8);
+		src += 2;
+		match = dest - offset;
+
+		len = (token & 15) + 4;
+		if((token & 15) == 15)
+		{
+			do
+			{
+				token = *src++;
+				len += token;
+			} while(token == 255);
+		}
+
+		/* A match within 4 bytes of the output overlaps itself, and
+		 * has to be copied a byte at a time to repeat correctly
+		 */
+		if(offset >= 4)
+		{
+			while(len >= 4)
+			{
+				*(unsigned int *)dest = *(unsigned int *)match;
+				dest += 4;
+				match += 4;
+				len -= 4;
+			}
+		}
+		while(len--)
+			*dest++ = *match++;
+	}
+
+	return dest;
+}
+
+/* Unpack the high kernel, if it is compressed
+ *
+ * Must not be inlined into initsys(), which is naked and has no stack
+ * frame for this function's variables
+ */
+__attribute__((noinline)) void unlz4_kernel(void)
+{
+	struct unlz4_header *header = (struct unlz4_header *) &_highkernelload;
+	unsigned char *dest = (unsigned char *) &_highkernelload;
+	unsigned char *src, *src_end;
+	unsigned int packed, unpacked, margin, block, copy;
+
+	boot_entry_time = *timerCLO;
+	boot_unpack_end = boot_entry_time;
+	boot_packed_size = 0;
+	boot_unpacked_size = 0;
+
+	if(header->magic != UNLZ4_MAGIC)
+		return;
+
+	packed = header->packed_size;
+	unpacked = header->unpacked_size;
+
+	/* Decompress in place. The compressed data is moved up so that it
+	 * ends a little way past the end of the unpacked kernel, then
+	 * unpacked from the start of the high kernel. The output can never
+	 * catch up with input that hasn't been read yet, as long as there is
+	 * a small margin (1/256th of the compressed size plus some slack for
+	 * the block headers - see LZ4_DECOMPRESS_INPLACE_MARGIN in lz4.h).
+	 * Memory after the unpacked kernel is .bss, which is cleared after
+	 * this returns.
+	 */
+	margin = (packed >> 8) + 64 + 4 * ((unpacked >> 23) + 1);
+	src = (unsigned char *)(((unsigned int)dest + unpacked + margin
+		- packed) & ~31);
+
+	/* Moved as whole words. The header is word aligned, so this may
+	 * read up to 3 bytes past the end of the compressed data
+	 */
+	copy = (packed + 3) & ~3;
+
+	/* If the data is already far enough ahead of the output, leave it
+	 * where it is
+	 */
+	if(src > (unsigned char *)(header + 1))
+		init_move_up(src + copy, (unsigned char *)(header + 1) + copy,
+			copy);
+	else
+		src = (unsigned char *)(header + 1);
+
+	src_end = src + packed;
+
+	if(*(unsigned int *)src == LZ4_LEGACY_MAGIC)
+	{
+		src += 4;
+
+		while(src < src_end)
+		{
+			block = *(unsigned int *)src;
+			src += 4;
+
+			/* A second magic number would start a new stream;
+			 * the Makefile never produces one
+			 */
+			if(block == LZ4_LEGACY_MAGIC)
+				continue;
+
+			dest = unlz4_block(dest, src, block);
+			src += block;
+		}
+	}
+
+	/* The instruction cache was turned on in start.s, and the kernel
+	 * code has just been written underneath it
+	 */
+	asm volatile("mcr p15, 0, %[zero], c7, c5, 0" : : [zero] "r" (0));
+	asm volatile("mcr p15, 0, %[zero], c7, c5, 6" : : [zero] "r" (0));
+
+	boot_packed_size = packed;
+	boot_unpacked_size = unpacked;
+	boot_unpack_end = *timerCLO;
+}